@@ -0,0 +1,637 @@
+#include <string.h>
+#include <immintrin.h>
+#include "argon2i_kernel.h"
+#include "blake2b.h"
+
+// Argon2 constants (RFC 9106)
+#define ARGON2_VERSION 0x13
+#define ARGON2_TYPE_I 1
+#define ARGON2_SYNC_POINTS 4
+#define ARGON2_PREHASH_DIGEST_LENGTH 64
+#define ARGON2_PREHASH_SEED_LENGTH 72
+
+typedef void (*fill_block_fn)(const argon2_block_t* prev, const argon2_block_t* ref, argon2_block_t* next, int with_xor);
+
+// --- Portable Kernel ---
+
+static inline uint64_t rotr64(uint64_t w, unsigned c) {
+    return (w >> c) | (w << (64 - c));
+}
+
+// BlaMka: the multiplication-hardened addition used by Argon2 in place of BLAKE2b's a + b
+static inline uint64_t fblamka(uint64_t x, uint64_t y) {
+    const uint64_t m = 0xFFFFFFFFULL;
+    return x + y + 2 * ((x & m) * (y & m));
+}
+
+#define G(a, b, c, d)              \
+    do {                           \
+        a = fblamka(a, b);         \
+        d = rotr64(d ^ a, 32);     \
+        c = fblamka(c, d);         \
+        b = rotr64(b ^ c, 24);     \
+        a = fblamka(a, b);         \
+        d = rotr64(d ^ a, 16);     \
+        c = fblamka(c, d);         \
+        b = rotr64(b ^ c, 63);     \
+    } while (0)
+
+#define BLAKE2_ROUND_NOMSG(v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11, v12, v13, v14, v15) \
+    do {                                  \
+        G(v0, v4, v8, v12);               \
+        G(v1, v5, v9, v13);               \
+        G(v2, v6, v10, v14);              \
+        G(v3, v7, v11, v15);              \
+        G(v0, v5, v10, v15);              \
+        G(v1, v6, v11, v12);              \
+        G(v2, v7, v8, v13);               \
+        G(v3, v4, v9, v14);               \
+    } while (0)
+
+static void fill_block_portable(const argon2_block_t* prev, const argon2_block_t* ref, argon2_block_t* next, int with_xor) {
+    argon2_block_t R, tmp;
+    for (int i = 0; i < ARGON2_QWORDS_IN_BLOCK; i++) {
+        R.v[i] = ref->v[i] ^ prev->v[i];
+        tmp.v[i] = with_xor ? R.v[i] ^ next->v[i] : R.v[i];
+    }
+
+    // Rows: each group of 16 consecutive words
+    for (int i = 0; i < 8; i++) {
+        uint64_t* v = R.v + 16 * i;
+        BLAKE2_ROUND_NOMSG(v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7],
+            v[8], v[9], v[10], v[11], v[12], v[13], v[14], v[15]);
+    }
+
+    // Columns: word pairs 2i, 2i+1 taken from each of the 8 rows
+    for (int i = 0; i < 8; i++) {
+        uint64_t* v = R.v + 2 * i;
+        BLAKE2_ROUND_NOMSG(v[0], v[1], v[16], v[17], v[32], v[33], v[48], v[49],
+            v[64], v[65], v[80], v[81], v[96], v[97], v[112], v[113]);
+    }
+
+    for (int i = 0; i < ARGON2_QWORDS_IN_BLOCK; i++) {
+        next->v[i] = tmp.v[i] ^ R.v[i];
+    }
+}
+
+#undef BLAKE2_ROUND_NOMSG
+#undef G
+
+// --- SSE2 Kernel ---
+//
+// Each 16-word round input is held as eight 128-bit registers A0 A1 B0 B1 C0 C1 D0 D1,
+// so the four column G functions of a round run two at a time.
+
+__attribute__((target("sse2")))
+static inline __m128i fblamka_sse2(__m128i x, __m128i y) {
+    __m128i z = _mm_mul_epu32(x, y);
+    return _mm_add_epi64(_mm_add_epi64(x, y), _mm_add_epi64(z, z));
+}
+
+#define SSE2_ROTR(x, n) _mm_xor_si128(_mm_srli_epi64((x), (n)), _mm_slli_epi64((x), 64 - (n)))
+#define SSE2_ROTR32(x) _mm_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+#define SSE2_ROTR63(x) _mm_xor_si128(_mm_srli_epi64((x), 63), _mm_add_epi64((x), (x)))
+
+#define G_SSE2(a, b, c, d)                             \
+    do {                                               \
+        a = fblamka_sse2(a, b);                        \
+        d = SSE2_ROTR32(_mm_xor_si128(d, a));          \
+        c = fblamka_sse2(c, d);                        \
+        b = SSE2_ROTR(_mm_xor_si128(b, c), 24);        \
+        a = fblamka_sse2(a, b);                        \
+        d = SSE2_ROTR(_mm_xor_si128(d, a), 16);        \
+        c = fblamka_sse2(c, d);                        \
+        b = SSE2_ROTR63(_mm_xor_si128(b, c));          \
+    } while (0)
+
+// Round over s[base + k * stride] for k = 0..7
+__attribute__((target("sse2")))
+static inline void blake2_round_sse2(__m128i* s, int base, int stride) {
+    __m128i A0 = s[base + 0 * stride], A1 = s[base + 1 * stride];
+    __m128i B0 = s[base + 2 * stride], B1 = s[base + 3 * stride];
+    __m128i C0 = s[base + 4 * stride], C1 = s[base + 5 * stride];
+    __m128i D0 = s[base + 6 * stride], D1 = s[base + 7 * stride];
+    __m128i t0, t1;
+
+    G_SSE2(A0, B0, C0, D0);
+    G_SSE2(A1, B1, C1, D1);
+
+    // Diagonalize: B = (5,6)(7,4), C = (10,11)(8,9), D = (15,12)(13,14)
+    t0 = D0;
+    t1 = B0;
+    D0 = C0; C0 = C1; C1 = D0;
+    D0 = _mm_unpackhi_epi64(D1, _mm_unpacklo_epi64(t0, t0));
+    D1 = _mm_unpackhi_epi64(t0, _mm_unpacklo_epi64(D1, D1));
+    B0 = _mm_unpackhi_epi64(B0, _mm_unpacklo_epi64(B1, B1));
+    B1 = _mm_unpackhi_epi64(B1, _mm_unpacklo_epi64(t1, t1));
+
+    G_SSE2(A0, B0, C0, D0);
+    G_SSE2(A1, B1, C1, D1);
+
+    // Undiagonalize
+    t0 = B0;
+    t1 = D0;
+    D0 = C0; C0 = C1; C1 = D0;
+    B0 = _mm_unpackhi_epi64(B1, _mm_unpacklo_epi64(t0, t0));
+    B1 = _mm_unpackhi_epi64(t0, _mm_unpacklo_epi64(B1, B1));
+    D0 = _mm_unpackhi_epi64(t1, _mm_unpacklo_epi64(D1, D1));
+    D1 = _mm_unpackhi_epi64(D1, _mm_unpacklo_epi64(t1, t1));
+
+    s[base + 0 * stride] = A0; s[base + 1 * stride] = A1;
+    s[base + 2 * stride] = B0; s[base + 3 * stride] = B1;
+    s[base + 4 * stride] = C0; s[base + 5 * stride] = C1;
+    s[base + 6 * stride] = D0; s[base + 7 * stride] = D1;
+}
+
+__attribute__((target("sse2")))
+static void fill_block_sse2(const argon2_block_t* prev, const argon2_block_t* ref, argon2_block_t* next, int with_xor) {
+    __m128i R[64], T[64];
+    const __m128i* p = (const __m128i*)prev->v;
+    const __m128i* r = (const __m128i*)ref->v;
+    __m128i* n = (__m128i*)next->v;
+
+    for (int i = 0; i < 64; i++) {
+        R[i] = _mm_xor_si128(_mm_load_si128(r + i), _mm_load_si128(p + i));
+        T[i] = with_xor ? _mm_xor_si128(R[i], _mm_load_si128(n + i)) : R[i];
+    }
+    for (int i = 0; i < 8; i++) blake2_round_sse2(R, 8 * i, 1); // rows
+    for (int i = 0; i < 8; i++) blake2_round_sse2(R, i, 8);     // columns
+    for (int i = 0; i < 64; i++) {
+        _mm_store_si128(n + i, _mm_xor_si128(T[i], R[i]));
+    }
+}
+
+#undef G_SSE2
+
+// --- AVX2 Kernel ---
+//
+// A round input is four 256-bit registers A B C D holding words 0-3, 4-7, 8-11, 12-15,
+// so all four column G functions run at once and diagonalization is a lane permute.
+
+__attribute__((target("avx2")))
+static inline __m256i fblamka_avx2(__m256i x, __m256i y) {
+    __m256i z = _mm256_mul_epu32(x, y);
+    return _mm256_add_epi64(_mm256_add_epi64(x, y), _mm256_add_epi64(z, z));
+}
+
+#define AVX2_ROTR32(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+#define AVX2_ROTR24(x) _mm256_shuffle_epi8((x), _mm256_setr_epi8( \
+    3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,           \
+    3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10))
+#define AVX2_ROTR16(x) _mm256_shuffle_epi8((x), _mm256_setr_epi8( \
+    2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,           \
+    2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9))
+#define AVX2_ROTR63(x) _mm256_xor_si256(_mm256_srli_epi64((x), 63), _mm256_add_epi64((x), (x)))
+
+#define G_AVX2(a, b, c, d)                               \
+    do {                                                 \
+        a = fblamka_avx2(a, b);                          \
+        d = AVX2_ROTR32(_mm256_xor_si256(d, a));         \
+        c = fblamka_avx2(c, d);                          \
+        b = AVX2_ROTR24(_mm256_xor_si256(b, c));         \
+        a = fblamka_avx2(a, b);                          \
+        d = AVX2_ROTR16(_mm256_xor_si256(d, a));         \
+        c = fblamka_avx2(c, d);                          \
+        b = AVX2_ROTR63(_mm256_xor_si256(b, c));         \
+    } while (0)
+
+__attribute__((target("avx2")))
+static inline void blake2_round_avx2(__m256i* A, __m256i* B, __m256i* C, __m256i* D) {
+    __m256i a = *A, b = *B, c = *C, d = *D;
+    G_AVX2(a, b, c, d);
+    b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0, 3, 2, 1));
+    c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2, 1, 0, 3));
+    G_AVX2(a, b, c, d);
+    b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2, 1, 0, 3));
+    c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0, 3, 2, 1));
+    *A = a; *B = b; *C = c; *D = d;
+}
+
+// Two 128-bit word pairs from different rows form one column-round register
+__attribute__((target("avx2")))
+static inline __m256i load_pairs_avx2(const uint64_t* lo, const uint64_t* hi) {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i*)lo)),
+        _mm_load_si128((const __m128i*)hi), 1);
+}
+
+__attribute__((target("avx2")))
+static inline void store_pairs_avx2(uint64_t* lo, uint64_t* hi, __m256i x) {
+    _mm_store_si128((__m128i*)lo, _mm256_castsi256_si128(x));
+    _mm_store_si128((__m128i*)hi, _mm256_extracti128_si256(x, 1));
+}
+
+__attribute__((target("avx2")))
+static void fill_block_avx2(const argon2_block_t* prev, const argon2_block_t* ref, argon2_block_t* next, int with_xor) {
+    argon2_block_t R;
+    __m256i T[32];
+    const __m256i* p = (const __m256i*)prev->v;
+    const __m256i* r = (const __m256i*)ref->v;
+    __m256i* n = (__m256i*)next->v;
+    __m256i* Rv = (__m256i*)R.v;
+
+    for (int i = 0; i < 32; i++) {
+        Rv[i] = _mm256_xor_si256(_mm256_load_si256(r + i), _mm256_load_si256(p + i));
+        T[i] = with_xor ? _mm256_xor_si256(Rv[i], _mm256_load_si256(n + i)) : Rv[i];
+    }
+
+    for (int i = 0; i < 8; i++) {
+        blake2_round_avx2(&Rv[4 * i], &Rv[4 * i + 1], &Rv[4 * i + 2], &Rv[4 * i + 3]);
+    }
+
+    for (int i = 0; i < 8; i++) {
+        uint64_t* v = R.v + 2 * i;
+        __m256i a = load_pairs_avx2(v + 0, v + 16);
+        __m256i b = load_pairs_avx2(v + 32, v + 48);
+        __m256i c = load_pairs_avx2(v + 64, v + 80);
+        __m256i d = load_pairs_avx2(v + 96, v + 112);
+        blake2_round_avx2(&a, &b, &c, &d);
+        store_pairs_avx2(v + 0, v + 16, a);
+        store_pairs_avx2(v + 32, v + 48, b);
+        store_pairs_avx2(v + 64, v + 80, c);
+        store_pairs_avx2(v + 96, v + 112, d);
+    }
+
+    for (int i = 0; i < 32; i++) {
+        _mm256_store_si256(n + i, _mm256_xor_si256(T[i], Rv[i]));
+    }
+}
+
+#undef G_AVX2
+
+// --- AVX-512 Kernel ---
+//
+// Same layout as AVX2, with two independent rounds (rows r and r+1, or column groups
+// i and i+1) packed into the two 256-bit halves of each register.
+
+__attribute__((target("avx512f")))
+static inline __m512i fblamka_avx512(__m512i x, __m512i y) {
+    __m512i z = _mm512_mul_epu32(x, y);
+    return _mm512_add_epi64(_mm512_add_epi64(x, y), _mm512_add_epi64(z, z));
+}
+
+#define G_AVX512(a, b, c, d)                                   \
+    do {                                                       \
+        a = fblamka_avx512(a, b);                              \
+        d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 32);      \
+        c = fblamka_avx512(c, d);                              \
+        b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 24);      \
+        a = fblamka_avx512(a, b);                              \
+        d = _mm512_ror_epi64(_mm512_xor_si512(d, a), 16);      \
+        c = fblamka_avx512(c, d);                              \
+        b = _mm512_ror_epi64(_mm512_xor_si512(b, c), 63);      \
+    } while (0)
+
+__attribute__((target("avx512f")))
+static inline void blake2_round_avx512(__m512i* A, __m512i* B, __m512i* C, __m512i* D) {
+    __m512i a = *A, b = *B, c = *C, d = *D;
+    G_AVX512(a, b, c, d);
+    b = _mm512_permutex_epi64(b, _MM_SHUFFLE(0, 3, 2, 1));
+    c = _mm512_permutex_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm512_permutex_epi64(d, _MM_SHUFFLE(2, 1, 0, 3));
+    G_AVX512(a, b, c, d);
+    b = _mm512_permutex_epi64(b, _MM_SHUFFLE(2, 1, 0, 3));
+    c = _mm512_permutex_epi64(c, _MM_SHUFFLE(1, 0, 3, 2));
+    d = _mm512_permutex_epi64(d, _MM_SHUFFLE(0, 3, 2, 1));
+    *A = a; *B = b; *C = c; *D = d;
+}
+
+// Words 4k..4k+3 of two consecutive rows, one row per 256-bit half
+__attribute__((target("avx512f")))
+static inline __m512i load_rows_avx512(const uint64_t* row) {
+    return _mm512_inserti64x4(_mm512_castsi256_si512(_mm256_load_si256((const __m256i*)row)),
+        _mm256_load_si256((const __m256i*)(row + 16)), 1);
+}
+
+__attribute__((target("avx512f")))
+static inline void store_rows_avx512(uint64_t* row, __m512i x) {
+    _mm256_store_si256((__m256i*)row, _mm512_castsi512_si256(x));
+    _mm256_store_si256((__m256i*)(row + 16), _mm512_extracti64x4_epi64(x, 1));
+}
+
+// Column groups i and i+1 of two consecutive rows: (r0 pair i, r1 pair i | r0 pair i+1, r1 pair i+1).
+// The interleave permutation is its own inverse, so the same index serves loads and stores.
+__attribute__((target("avx512f")))
+static inline __m512i load_cols_avx512(const uint64_t* row, __m512i idx) {
+    return _mm512_permutexvar_epi64(idx, load_rows_avx512(row));
+}
+
+__attribute__((target("avx512f")))
+static inline void store_cols_avx512(uint64_t* row, __m512i idx, __m512i x) {
+    store_rows_avx512(row, _mm512_permutexvar_epi64(idx, x));
+}
+
+__attribute__((target("avx512f")))
+static void fill_block_avx512(const argon2_block_t* prev, const argon2_block_t* ref, argon2_block_t* next, int with_xor) {
+    argon2_block_t R;
+    __m512i T[16];
+    const __m512i* p = (const __m512i*)prev->v;
+    const __m512i* r = (const __m512i*)ref->v;
+    __m512i* n = (__m512i*)next->v;
+    __m512i* Rv = (__m512i*)R.v;
+
+    for (int i = 0; i < 16; i++) {
+        Rv[i] = _mm512_xor_si512(_mm512_load_si512(r + i), _mm512_load_si512(p + i));
+        T[i] = with_xor ? _mm512_xor_si512(Rv[i], _mm512_load_si512(n + i)) : Rv[i];
+    }
+
+    for (int i = 0; i < 8; i += 2) {
+        uint64_t* v = R.v + 16 * i;
+        __m512i a = load_rows_avx512(v + 0);
+        __m512i b = load_rows_avx512(v + 4);
+        __m512i c = load_rows_avx512(v + 8);
+        __m512i d = load_rows_avx512(v + 12);
+        blake2_round_avx512(&a, &b, &c, &d);
+        store_rows_avx512(v + 0, a);
+        store_rows_avx512(v + 4, b);
+        store_rows_avx512(v + 8, c);
+        store_rows_avx512(v + 12, d);
+    }
+
+    const __m512i idx = _mm512_setr_epi64(0, 1, 4, 5, 2, 3, 6, 7);
+    for (int i = 0; i < 8; i += 2) {
+        uint64_t* v = R.v + 2 * i;
+        __m512i a = load_cols_avx512(v + 0, idx);
+        __m512i b = load_cols_avx512(v + 32, idx);
+        __m512i c = load_cols_avx512(v + 64, idx);
+        __m512i d = load_cols_avx512(v + 96, idx);
+        blake2_round_avx512(&a, &b, &c, &d);
+        store_cols_avx512(v + 0, idx, a);
+        store_cols_avx512(v + 32, idx, b);
+        store_cols_avx512(v + 64, idx, c);
+        store_cols_avx512(v + 96, idx, d);
+    }
+
+    for (int i = 0; i < 16; i++) {
+        _mm512_store_si512(n + i, _mm512_xor_si512(T[i], Rv[i]));
+    }
+}
+
+#undef G_AVX512
+
+// --- Kernel Selection ---
+
+static const char* kernel_names[ARGON2_KERNEL_COUNT] = {
+    "libargon2", "portable", "sse2", "avx2", "avx512"
+};
+
+static const fill_block_fn kernel_fill_block[ARGON2_KERNEL_COUNT] = {
+    NULL, fill_block_portable, fill_block_sse2, fill_block_avx2, fill_block_avx512
+};
+
+static argon2_kernel_t active_kernel = ARGON2_KERNEL_LIBARGON2;
+
+int argon2_kernel_supported(argon2_kernel_t kernel) {
+    __builtin_cpu_init();
+    switch (kernel) {
+        case ARGON2_KERNEL_LIBARGON2:
+        case ARGON2_KERNEL_PORTABLE:
+            return 1;
+        case ARGON2_KERNEL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case ARGON2_KERNEL_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case ARGON2_KERNEL_AVX512:
+            return __builtin_cpu_supports("avx512f");
+        default:
+            return 0;
+    }
+}
+
+argon2_kernel_t argon2_kernel_detect(void) {
+    for (int k = ARGON2_KERNEL_COUNT - 1; k > ARGON2_KERNEL_PORTABLE; k--) {
+        if (argon2_kernel_supported((argon2_kernel_t)k)) return (argon2_kernel_t)k;
+    }
+    return ARGON2_KERNEL_PORTABLE;
+}
+
+int argon2_kernel_select(argon2_kernel_t kernel) {
+    if (kernel < 0 || kernel >= ARGON2_KERNEL_COUNT || !argon2_kernel_supported(kernel)) return 0;
+    active_kernel = kernel;
+    return 1;
+}
+
+argon2_kernel_t argon2_kernel_active(void) {
+    return active_kernel;
+}
+
+const char* argon2_kernel_name(argon2_kernel_t kernel) {
+    if (kernel < 0 || kernel >= ARGON2_KERNEL_COUNT) return "unknown";
+    return kernel_names[kernel];
+}
+
+int argon2_kernel_parse(const char* name, argon2_kernel_t* kernel) {
+    if (strcmp(name, "auto") == 0) {
+        *kernel = argon2_kernel_detect();
+        return 1;
+    }
+    for (int k = 0; k < ARGON2_KERNEL_COUNT; k++) {
+        if (strcmp(name, kernel_names[k]) == 0) {
+            *kernel = (argon2_kernel_t)k;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// --- Argon2i (p = 1) ---
+
+// The calling thread's cancellation check, see argon2_kernel_set_cancel
+static __thread argon2_cancel_fn cancel_check = NULL;
+static __thread void* cancel_arg = NULL;
+
+void argon2_kernel_set_cancel(argon2_cancel_fn cancel, void* arg) {
+    cancel_check = cancel;
+    cancel_arg = arg;
+}
+
+int argon2_kernel_cancelled(void) {
+    return cancel_check && cancel_check(cancel_arg);
+}
+
+static inline void store32_le(uint8_t* dst, uint32_t w) {
+    dst[0] = (uint8_t)w;
+    dst[1] = (uint8_t)(w >> 8);
+    dst[2] = (uint8_t)(w >> 16);
+    dst[3] = (uint8_t)(w >> 24);
+}
+
+static uint32_t memory_blocks_for(uint32_t m_cost) {
+    uint32_t blocks = m_cost;
+    if (blocks < 2 * ARGON2_SYNC_POINTS) blocks = 2 * ARGON2_SYNC_POINTS;
+    return blocks - blocks % ARGON2_SYNC_POINTS;
+}
+
+size_t argon2i_kernel_memory_size(uint32_t m_cost) {
+    return (size_t)memory_blocks_for(m_cost) * ARGON2_BLOCK_SIZE;
+}
+
+// Maps a pseudo-random value to a reference block index (the "index_alpha" of the spec)
+static inline uint32_t index_alpha(uint32_t pass, uint32_t slice, uint32_t index,
+    uint32_t segment_length, uint32_t lane_length, uint32_t pseudo_rand) {
+    uint64_t reference_area_size;
+    if (pass == 0) {
+        reference_area_size = (uint64_t)slice * segment_length + index - 1;
+    } else {
+        reference_area_size = (uint64_t)lane_length - segment_length + index - 1;
+    }
+
+    uint64_t relative_position = pseudo_rand;
+    relative_position = relative_position * relative_position >> 32;
+    relative_position = reference_area_size - 1 - (reference_area_size * relative_position >> 32);
+
+    uint64_t start_position = 0;
+    if (pass != 0 && slice != ARGON2_SYNC_POINTS - 1) {
+        start_position = (uint64_t)(slice + 1) * segment_length;
+    }
+    return (uint32_t)((start_position + relative_position) % lane_length);
+}
+
+static inline void next_addresses(fill_block_fn fill_block, argon2_block_t* address_block,
+    argon2_block_t* input_block, const argon2_block_t* zero_block) {
+    input_block->v[6]++;
+    fill_block(zero_block, input_block, address_block, 0);
+    fill_block(zero_block, address_block, address_block, 0);
+}
+
+static inline void prefetch_block(const argon2_block_t* block) {
+    for (int offset = 0; offset < ARGON2_BLOCK_SIZE; offset += 64) {
+        __builtin_prefetch((const char*)block + offset, 0, 0);
+    }
+}
+
+// Per-instance state while several hashes are filled in lockstep
+typedef struct {
+    argon2_block_t address_block;
+    argon2_block_t input_block;
+    argon2_block_t* memory;
+} fill_state_t;
+
+// Fills one segment of every instance. All instances share the same geometry, so
+// they advance block by block together: while one instance's compression runs, the
+// reference blocks of the next step (known in advance, since Argon2i addressing does
+// not depend on the data) are already being prefetched for all of them.
+static void fill_segment_interleaved(fill_block_fn fill_block, fill_state_t* states, int count,
+    uint32_t pass, uint32_t slice, uint32_t passes, uint32_t memory_blocks, uint32_t segment_length) {
+    argon2_block_t zero_block;
+    const uint32_t lane_length = memory_blocks;
+    memset(&zero_block, 0, sizeof(zero_block));
+
+    uint32_t starting_index = (pass == 0 && slice == 0) ? 2 : 0; // The first two blocks come from H0
+    for (int k = 0; k < count; k++) {
+        argon2_block_t* input_block = &states[k].input_block;
+        memset(input_block, 0, sizeof(*input_block));
+        input_block->v[0] = pass;
+        input_block->v[1] = 0; // lane
+        input_block->v[2] = slice;
+        input_block->v[3] = memory_blocks;
+        input_block->v[4] = passes;
+        input_block->v[5] = ARGON2_TYPE_I;
+        if (starting_index == 2) {
+            next_addresses(fill_block, &states[k].address_block, input_block, &zero_block);
+        }
+    }
+
+    uint32_t curr_offset = slice * segment_length + starting_index;
+    uint32_t prev_offset = (curr_offset % lane_length == 0) ? curr_offset + lane_length - 1 : curr_offset - 1;
+
+    for (uint32_t i = starting_index; i < segment_length; i++, curr_offset++, prev_offset++) {
+        if (curr_offset % lane_length == 1) prev_offset = curr_offset - 1;
+
+        uint32_t slot = i % ARGON2_QWORDS_IN_BLOCK;
+        if (slot == 0) {
+            for (int k = 0; k < count; k++) {
+                next_addresses(fill_block, &states[k].address_block, &states[k].input_block, &zero_block);
+            }
+        }
+
+        uint32_t ref_index[ARGON2_MAX_INTERLEAVE];
+        for (int k = 0; k < count; k++) {
+            ref_index[k] = index_alpha(pass, slice, i, segment_length, lane_length,
+                (uint32_t)states[k].address_block.v[slot]);
+        }
+
+        if (i + 1 < segment_length && slot + 1 < ARGON2_QWORDS_IN_BLOCK) {
+            for (int k = 0; k < count; k++) {
+                uint32_t next_ref = index_alpha(pass, slice, i + 1, segment_length, lane_length,
+                    (uint32_t)states[k].address_block.v[slot + 1]);
+                prefetch_block(&states[k].memory[next_ref]);
+            }
+        }
+
+        for (int k = 0; k < count; k++) {
+            argon2_block_t* memory = states[k].memory;
+            fill_block(&memory[prev_offset], &memory[ref_index[k]], &memory[curr_offset], pass != 0);
+        }
+    }
+}
+
+int argon2i_kernel_hash_interleaved(uint32_t t_cost, uint32_t m_cost, size_t outlen,
+    const argon2i_input_t* inputs, int count) {
+    fill_block_fn fill_block = kernel_fill_block[active_kernel];
+    if (!fill_block || t_cost < 1 || outlen < 4 || count < 1 || count > ARGON2_MAX_INTERLEAVE) return 0;
+
+    const uint32_t memory_blocks = memory_blocks_for(m_cost);
+    const uint32_t segment_length = memory_blocks / ARGON2_SYNC_POINTS;
+    fill_state_t states[ARGON2_MAX_INTERLEAVE];
+
+    for (int k = 0; k < count; k++) {
+        const argon2i_input_t* in = &inputs[k];
+        if (!in->memory) return 0;
+        states[k].memory = (argon2_block_t*)in->memory;
+
+        // H0 over the parameters and inputs
+        uint8_t seed[ARGON2_PREHASH_SEED_LENGTH];
+        uint8_t le[4];
+        blake2b_state S;
+        blake2b_init(&S, ARGON2_PREHASH_DIGEST_LENGTH);
+        store32_le(le, 1);                     blake2b_update(&S, le, 4); // lanes
+        store32_le(le, (uint32_t)outlen);      blake2b_update(&S, le, 4);
+        store32_le(le, m_cost);                blake2b_update(&S, le, 4);
+        store32_le(le, t_cost);                blake2b_update(&S, le, 4);
+        store32_le(le, ARGON2_VERSION);        blake2b_update(&S, le, 4);
+        store32_le(le, ARGON2_TYPE_I);         blake2b_update(&S, le, 4);
+        store32_le(le, (uint32_t)in->pwdlen);  blake2b_update(&S, le, 4);
+        blake2b_update(&S, in->pwd, in->pwdlen);
+        store32_le(le, (uint32_t)in->saltlen); blake2b_update(&S, le, 4);
+        blake2b_update(&S, in->salt, in->saltlen);
+        store32_le(le, 0);                     blake2b_update(&S, le, 4); // secret
+        store32_le(le, 0);                     blake2b_update(&S, le, 4); // associated data
+        blake2b_final(&S, seed);
+
+        // First two blocks of the lane
+        store32_le(seed + ARGON2_PREHASH_DIGEST_LENGTH + 4, 0);
+        store32_le(seed + ARGON2_PREHASH_DIGEST_LENGTH, 0);
+        blake2b_long(states[k].memory[0].v, ARGON2_BLOCK_SIZE, seed, sizeof(seed));
+        store32_le(seed + ARGON2_PREHASH_DIGEST_LENGTH, 1);
+        blake2b_long(states[k].memory[1].v, ARGON2_BLOCK_SIZE, seed, sizeof(seed));
+    }
+
+    for (uint32_t pass = 0; pass < t_cost; pass++) {
+        for (uint32_t slice = 0; slice < ARGON2_SYNC_POINTS; slice++) {
+            if (argon2_kernel_cancelled()) return ARGON2_KERNEL_CANCELLED;
+            fill_segment_interleaved(fill_block, states, count, pass, slice, t_cost, memory_blocks, segment_length);
+        }
+    }
+
+    // With a single lane the final block is simply the last block of that lane
+    for (int k = 0; k < count; k++) {
+        blake2b_long(inputs[k].out, outlen, states[k].memory[memory_blocks - 1].v, ARGON2_BLOCK_SIZE);
+    }
+    return 1;
+}
+
+int argon2i_kernel_hash(uint32_t t_cost, uint32_t m_cost,
+    const void* pwd, size_t pwdlen, const void* salt, size_t saltlen,
+    uint8_t* out, size_t outlen, uint8_t* memory) {
+    argon2i_input_t input = {
+        .pwd = pwd,
+        .pwdlen = pwdlen,
+        .salt = salt,
+        .saltlen = saltlen,
+        .out = out,
+        .memory = memory,
+    };
+    return argon2i_kernel_hash_interleaved(t_cost, m_cost, outlen, &input, 1);
+}
@@ -0,0 +1,134 @@
+#ifndef ARGON2I_KERNEL_H
+#define ARGON2I_KERNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Argon2 memory is organised in 1 KiB blocks of 128 little-endian 64-bit words
+#define ARGON2_BLOCK_SIZE 1024
+#define ARGON2_QWORDS_IN_BLOCK (ARGON2_BLOCK_SIZE / 8)
+
+typedef struct {
+    uint64_t v[ARGON2_QWORDS_IN_BLOCK];
+} __attribute__((aligned(64))) argon2_block_t;
+
+// Maximum number of independent hashes filled in lockstep by one thread
+#define ARGON2_MAX_INTERLEAVE 4
+
+// One hash of an interleaved batch
+typedef struct {
+    const void* pwd;
+    size_t pwdlen;
+    const void* salt;
+    size_t saltlen;
+    uint8_t* out;
+    uint8_t* memory;
+} argon2i_input_t;
+
+// Implementations of the Argon2i compression function G
+typedef enum {
+    ARGON2_KERNEL_LIBARGON2 = 0, // The system libargon2 through argon2_ctx
+    ARGON2_KERNEL_PORTABLE,      // Built-in, plain C
+    ARGON2_KERNEL_SSE2,          // Built-in, 128-bit vectors
+    ARGON2_KERNEL_AVX2,          // Built-in, 256-bit vectors
+    ARGON2_KERNEL_AVX512,        // Built-in, 512-bit vectors
+    ARGON2_KERNEL_COUNT
+} argon2_kernel_t;
+
+/**
+ * @brief Returns the fastest built-in kernel the running CPU supports (checked via cpuid).
+ */
+argon2_kernel_t argon2_kernel_detect(void);
+
+/**
+ * @brief Returns 1 if the running CPU can execute `kernel`.
+ */
+int argon2_kernel_supported(argon2_kernel_t kernel);
+
+/**
+ * @brief Selects the kernel used by all subsequent hashes. Call before starting worker threads.
+ *
+ * @return 1 on success, 0 if the CPU does not support the kernel.
+ */
+int argon2_kernel_select(argon2_kernel_t kernel);
+
+/**
+ * @brief Returns the currently selected kernel.
+ */
+argon2_kernel_t argon2_kernel_active(void);
+
+/**
+ * @brief Returns the short name of a kernel ("libargon2", "portable", "sse2", "avx2", "avx512").
+ */
+const char* argon2_kernel_name(argon2_kernel_t kernel);
+
+/**
+ * @brief Parses a kernel name. "auto" resolves to `argon2_kernel_detect()`.
+ *
+ * @return 1 on success, 0 if the name is unknown.
+ */
+int argon2_kernel_parse(const char* name, argon2_kernel_t* kernel);
+
+// Returned by the hash functions when the fill was abandoned
+#define ARGON2_KERNEL_CANCELLED -1
+
+// Asked between two segments of a fill; a nonzero answer abandons the hash
+typedef int (*argon2_cancel_fn)(void* arg);
+
+/**
+ * @brief Sets the cancellation check of the calling thread, NULL for none.
+ *
+ * The built-in kernels call it before each of the 4 segments of every pass, so a hash that
+ * is no longer wanted stops within a quarter of a pass instead of running to the end.
+ */
+void argon2_kernel_set_cancel(argon2_cancel_fn cancel, void* arg);
+
+/**
+ * @brief Returns 1 if the calling thread's cancellation check asks to stop.
+ */
+int argon2_kernel_cancelled(void);
+
+/**
+ * @brief Returns the number of bytes of block memory an Argon2i (p=1) hash with `m_cost` needs.
+ */
+size_t argon2i_kernel_memory_size(uint32_t m_cost);
+
+/**
+ * @brief Computes a raw Argon2i v1.3 hash with parallelism 1 using the selected built-in kernel.
+ *
+ * The result is byte-identical to libargon2's `argon2i_hash_raw` for the same inputs.
+ *
+ * @param t_cost Number of passes.
+ * @param m_cost Memory cost in KiB.
+ * @param pwd The password.
+ * @param pwdlen Length of the password.
+ * @param salt The salt.
+ * @param saltlen Length of the salt.
+ * @param out Output buffer for the tag.
+ * @param outlen Length of the tag.
+ * @param memory At least `argon2i_kernel_memory_size(m_cost)` bytes of 64-byte aligned scratch memory.
+ * @return 1 on success, 0 on failure, ARGON2_KERNEL_CANCELLED if the cancellation check stopped it.
+ */
+int argon2i_kernel_hash(uint32_t t_cost, uint32_t m_cost,
+    const void* pwd, size_t pwdlen, const void* salt, size_t saltlen,
+    uint8_t* out, size_t outlen, uint8_t* memory);
+
+/**
+ * @brief Computes up to ARGON2_MAX_INTERLEAVE independent Argon2i hashes in lockstep.
+ *
+ * The instances advance through the fill block by block together, so the memory latency
+ * of one is hidden behind the compression of the others. Each input needs its own
+ * `memory` of `argon2i_kernel_memory_size(m_cost)` bytes; every output is identical to
+ * what `argon2i_kernel_hash` would produce for that input alone.
+ *
+ * @param t_cost Number of passes.
+ * @param m_cost Memory cost in KiB.
+ * @param outlen Length of each tag.
+ * @param inputs The hashes to compute.
+ * @param count Number of entries in `inputs` (1..ARGON2_MAX_INTERLEAVE).
+ * @return 1 on success, 0 on failure, ARGON2_KERNEL_CANCELLED if the cancellation check stopped it.
+ */
+int argon2i_kernel_hash_interleaved(uint32_t t_cost, uint32_t m_cost, size_t outlen,
+    const argon2i_input_t* inputs, int count);
+
+#endif // ARGON2I_KERNEL_H
@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "autotune.h"
+
+void autotune_init(autotune_t* tuner, int workers, int active) {
+    memset(tuner, 0, sizeof(*tuner));
+    tuner->workers = workers;
+    tuner->active = active < 1 ? 1 : active > workers ? workers : active;
+    tuner->phase = AUTOTUNE_MEASURING;
+}
+
+void autotune_set_workers(autotune_t* tuner, int workers) {
+    autotune_init(tuner, workers, tuner->active);
+}
+
+static const char* workers_word(int workers) {
+    return workers == 1 ? "worker" : "workers";
+}
+
+static int holding(autotune_t* tuner, int workers) {
+    tuner->phase = AUTOTUNE_HOLDING;
+    tuner->active = workers;
+    tuner->held_s = 0;
+    return workers;
+}
+
+// Tries the next setting up from the base, or down from it when it is already the highest
+static int start_probe(autotune_t* tuner) {
+    tuner->phase = AUTOTUNE_PROBING;
+    tuner->turned = false;
+    tuner->direction = tuner->base < tuner->workers ? 1 : -1;
+    if (tuner->base + tuner->direction < 1) {
+        return holding(tuner, tuner->base); // A single worker: nothing to compare with
+    }
+    tuner->active = tuner->base + tuner->direction;
+    return tuner->active;
+}
+
+int autotune_update(autotune_t* tuner, double rate, double window_s, char* note, size_t note_len) {
+    int measured = tuner->active;
+    note[0] = '\0';
+
+    switch (tuner->phase) {
+    case AUTOTUNE_MEASURING:
+        tuner->base = measured;
+        tuner->base_rate = rate;
+        start_probe(tuner);
+        break;
+
+    case AUTOTUNE_PROBING:
+        if (rate > tuner->base_rate * (1 + AUTOTUNE_MIN_GAIN)) {
+            // Better: keep going the same way
+            tuner->base = measured;
+            tuner->base_rate = rate;
+            tuner->turned = true;
+            int next = measured + tuner->direction;
+            if (next < 1 || next > tuner->workers) {
+                holding(tuner, measured);
+            } else {
+                tuner->active = next;
+            }
+        } else if (!tuner->turned && tuner->base - tuner->direction >= 1
+            && tuner->base - tuner->direction <= tuner->workers) {
+            // Not better on the first step: try the other way
+            tuner->turned = true;
+            tuner->direction = -tuner->direction;
+            tuner->active = tuner->base + tuner->direction;
+        } else {
+            holding(tuner, tuner->base);
+        }
+        break;
+
+    case AUTOTUNE_HOLDING:
+        tuner->held_s += window_s;
+        if (rate < tuner->base_rate * (1 - AUTOTUNE_DRIFT)) {
+            snprintf(note, note_len, "%d %s: %.1f H/s, down from %.1f H/s, probing again",
+                measured, workers_word(measured), rate, tuner->base_rate);
+        } else if (tuner->held_s >= AUTOTUNE_REPROBE_S) {
+            snprintf(note, note_len, "%d %s: %.1f H/s after %.0f s, probing again", measured, workers_word(measured),
+                rate, tuner->held_s);
+        } else {
+            return tuner->active;
+        }
+        tuner->base = measured;
+        tuner->base_rate = rate;
+        start_probe(tuner);
+        if (tuner->phase == AUTOTUNE_PROBING) {
+            size_t len = strlen(note);
+            snprintf(note + len, note_len - len, " with %d", tuner->active);
+        }
+        return tuner->active;
+    }
+
+    if (tuner->phase == AUTOTUNE_HOLDING) {
+        snprintf(note, note_len, "%d %s: %.1f H/s, keeping %d (%.1f H/s)", measured, workers_word(measured), rate,
+            tuner->active, tuner->base_rate);
+    } else {
+        snprintf(note, note_len, "%d %s: %.1f H/s, trying %d", measured, workers_word(measured), rate, tuner->active);
+    }
+    return tuner->active;
+}
+
+int autotune_load(const char* path, int* workers, double* rate) {
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    char line[128];
+    int found = 0;
+    *rate = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "threads=%d", workers) == 1) {
+            found = *workers > 0;
+        } else {
+            sscanf(line, "rate=%lf", rate);
+        }
+    }
+    fclose(file);
+    return found;
+}
+
+int autotune_save(const char* path, int workers, double rate) {
+    char temp[4096];
+    if (snprintf(temp, sizeof(temp), "%s.tmp", path) >= (int)sizeof(temp)) return 0;
+    FILE* file = fopen(temp, "w");
+    if (!file) return 0;
+    fprintf(file, "# Written by c_miner --autotune: the best worker count it found and its hash rate\n");
+    fprintf(file, "threads=%d\nrate=%.1f\n", workers, rate);
+    if (fclose(file) != 0 || rename(temp, path) != 0) {
+        remove(temp);
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,73 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Adaptive concurrency: Argon2 is bound by memory bandwidth, so past some number of workers
+// more of them lower the total hash rate, and where that happens moves with whatever else
+// runs on the host. The controller hill-climbs the number of running workers on the hash
+// rate measured over fixed windows, holds the best setting and probes again now and then.
+
+// Length of one measurement window
+#define AUTOTUNE_WINDOW_MS 10000
+// Time a new setting runs before its window starts, so the workers get up to speed
+#define AUTOTUNE_SETTLE_MS 2000
+// A step must gain this share of hash rate to count as better, so noise does not walk the setting
+#define AUTOTUNE_MIN_GAIN 0.02
+// A held setting is probed again after this long...
+#define AUTOTUNE_REPROBE_S 600
+// ...or as soon as its hash rate falls this share below what it had when it was chosen
+#define AUTOTUNE_DRIFT 0.10
+
+typedef enum {
+    AUTOTUNE_MEASURING, // Measuring the setting a climb starts from
+    AUTOTUNE_PROBING,   // Comparing a neighbouring setting with the best one so far
+    AUTOTUNE_HOLDING,   // At the best setting found
+} autotune_phase_t;
+
+typedef struct {
+    int workers;        // Most workers the controller may run
+    int active;         // Workers it runs now
+    autotune_phase_t phase;
+    int base;           // Best setting of the current climb
+    double base_rate;   // Its hash rate
+    int direction;      // +1 or -1, the step being probed
+    bool turned;        // The climb has settled on a direction, or tried both
+    double held_s;      // Time spent at the held setting
+} autotune_t;
+
+/**
+ * @brief Starts a climb from `active` of at most `workers` workers.
+ */
+void autotune_init(autotune_t* tuner, int workers, int active);
+
+/**
+ * @brief Changes the most workers the controller may run and starts a new climb.
+ */
+void autotune_set_workers(autotune_t* tuner, int workers);
+
+/**
+ * @brief Takes the hash rate of a window measured at `tuner->active` workers and picks the next setting.
+ *
+ * @param note Receives a one-line description of the decision, or an empty string if
+ *        nothing changed.
+ * @return The number of workers to run for the next window.
+ */
+int autotune_update(autotune_t* tuner, double rate, double window_s, char* note, size_t note_len);
+
+/**
+ * @brief Reads the setting saved by `autotune_save`.
+ *
+ * @return 1 on success, 0 if the file is missing or holds no setting.
+ */
+int autotune_load(const char* path, int* workers, double* rate);
+
+/**
+ * @brief Saves a setting, replacing the file in one step.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+int autotune_save(const char* path, int workers, double rate);
+
+#endif // AUTOTUNE_H
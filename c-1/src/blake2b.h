@@ -0,0 +1,47 @@
+#ifndef BLAKE2B_H
+#define BLAKE2B_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define BLAKE2B_BLOCKBYTES 128
+#define BLAKE2B_OUTBYTES 64
+
+// Incremental BLAKE2b state (unkeyed, sequential mode only)
+typedef struct {
+    uint64_t h[8];
+    uint64_t t[2];
+    uint8_t buf[BLAKE2B_BLOCKBYTES];
+    size_t buflen;
+    size_t outlen;
+} blake2b_state;
+
+/**
+ * @brief Initializes an unkeyed BLAKE2b state producing `outlen` bytes (1..64).
+ */
+void blake2b_init(blake2b_state* S, size_t outlen);
+
+/**
+ * @brief Absorbs `inlen` bytes of input.
+ */
+void blake2b_update(blake2b_state* S, const void* in, size_t inlen);
+
+/**
+ * @brief Finishes the hash and writes `S->outlen` bytes to `out`.
+ */
+void blake2b_final(blake2b_state* S, void* out);
+
+/**
+ * @brief One-shot BLAKE2b of `in` with an `outlen`-byte digest.
+ */
+void blake2b(void* out, size_t outlen, const void* in, size_t inlen);
+
+/**
+ * @brief The variable-length hash H' from the Argon2 specification.
+ *
+ * Produces `outlen` bytes from `in`, chaining 64-byte BLAKE2b digests when
+ * `outlen` exceeds a single digest.
+ */
+void blake2b_long(void* out, size_t outlen, const void* in, size_t inlen);
+
+#endif // BLAKE2B_H
@@ -1,9 +1,11 @@
+#define _GNU_SOURCE // For RUSAGE_THREAD and SCHED_IDLE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <sys/syscall.h>
+#include <sys/resource.h>
 #include <curl/curl.h>
 #include <gmp.h>
 #include <stdatomic.h>
@@ -12,41 +14,156 @@
 #include <stdint.h>
 #include <getopt.h>
 #include <ctype.h>
+#include <semaphore.h>
+#include <math.h>
+#include <signal.h>
+#include <limits.h>
+#include <sched.h>
+#include <errno.h>
 #include "miner_core.h"
+#include "argon2i_kernel.h"
+#include "net.h"
+#include "json.h"
+#include "queue.h"
+#include "nodes.h"
+#include "metrics.h"
+#include "profile.h"
+#include "topology.h"
+#include "pressure.h"
+#include "autotune.h"
+#include "control.h"
+#include "nonces.h"
+#include "trace.h"
 
 // --- Global State ---
-atomic_bool block_found = ATOMIC_VAR_INIT(false);
-atomic_long total_hashes = ATOMIC_VAR_INIT(0);
-atomic_int total_submits = ATOMIC_VAR_INIT(0);
-atomic_int total_accepted = ATOMIC_VAR_INIT(0);
-atomic_int total_rejected = ATOMIC_VAR_INIT(0);
-atomic_int total_dropped = ATOMIC_VAR_INIT(0);
+// Solutions submitted, accepted and rejected are only counted by the submitter thread,
+// jobs dropped without a solution only under `job_mutex`, and solutions lost before they
+// reached the submitter only under `console_mutex`
+padded_counter_t total_submits;
+padded_counter_t total_accepted;
+padded_counter_t total_rejected;
+padded_counter_t total_dropped;
+padded_counter_t total_lost;
 pthread_mutex_t console_mutex = PTHREAD_MUTEX_INITIALIZER;
-solution_t* found_solution = NULL; // Will hold the solution
-pthread_mutex_t solution_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Found solutions travel from the workers to the submitter thread through this queue
+mpsc_queue_t solution_queue;
+sem_t solution_ready; // Posted once per queued solution
+// The job epoch the last solution was found for; one solution per job is enough
+atomic_uint_fast64_t solution_epoch = ATOMIC_VAR_INIT(0);
+// Time from finding a solution to the first node answering its submission
+net_latency_t ack_latency = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+// Set by anyone who prints between two reports, so the stats table starts over below it
+atomic_bool report_interrupted = ATOMIC_VAR_INIT(false);
+
+// The latest job published by the dispatcher thread. Workers only read `job_epoch`
+// between hashes; the job itself is copied under `job_mutex` when it changes.
+atomic_uint_fast64_t job_epoch = ATOMIC_VAR_INIT(0);
+pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+// Time from a job being published to a worker hashing it
+net_latency_t switch_latency = { .mutex = PTHREAD_MUTEX_INITIALIZER };
+// Makes the workers return after their current batch
+atomic_bool workers_stop = ATOMIC_VAR_INIT(false);
+// Set by signal handlers and acted on by the main loop
+atomic_bool exit_requested = ATOMIC_VAR_INIT(false);
+atomic_bool profile_dump_requested = ATOMIC_VAR_INIT(false);
+// Workers whose thread_id is above `worker_limit` (set through the control socket) or
+// `workers_active` (set by the background mode controller or the autotuner) park on `park_cond` between
+// batches until they may run again
+atomic_int worker_limit = ATOMIC_VAR_INIT(INT_MAX);
+atomic_int workers_active = ATOMIC_VAR_INIT(INT_MAX);
+pthread_mutex_t park_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t park_cond = PTHREAD_COND_INITIALIZER;
 
 
 // --- Data Structures ---
 
-// To hold the JSON response from the node
-struct memory {
-    char *response;
-    size_t size;
-};
+// A unit of work: the block being mined on top of, as last seen on the node
+typedef struct {
+    uint64_t epoch;
+    long height;
+    long block_date;
+    char block_id[128];
+    mpz_t difficulty;
+    long first_elapsed; // No hit can beat the target before this many seconds
+    struct timespec published; // CLOCK_MONOTONIC time the dispatcher published it
+    int source; // Index of the node it was seen on
+} mining_job_t;
+
+mining_job_t current_job;
+
+// To configure the work-dispatcher thread
+typedef struct {
+    node_pool_t* pool;
+    int poll_interval_ms;
+    net_client_t* client;
+} dispatcher_config_t;
 
+// To configure the node health-check thread
+typedef struct {
+    node_pool_t* pool;
+    bool discover_peers;
+} health_config_t;
+
+// Most nodes a solution is broadcast to
+#define SUBMIT_MAX_NODES 8
+
+// To configure the submitter thread
+typedef struct {
+    const char* address;
+    char* nodes[SUBMIT_MAX_NODES + 1];
+    net_client_t* clients[SUBMIT_MAX_NODES + 1]; // One persistent connection per node
+    int node_count;
+    // The node being mined against also gets each solution, even if it was discovered;
+    // it takes the spare slot at the end of `nodes` when it is not one of them.
+    node_pool_t* pool;
+    char selected[256];
+} submitter_config_t;
 
 thread_stats_t* mining_stats = NULL;
+// Workers started so far. `mining_stats` has room for --max-threads of them, and the
+// control socket may start the rest while the miner runs.
+atomic_int workers_started = ATOMIC_VAR_INIT(0);
+
+// `--threads auto`: one worker per physical core, see topology_auto_threads
+#define THREADS_AUTO -1
+// No --worker-id or --instance: derived from the host, or the first one free on it. Out of
+// the range of any number a user would type, so that a negative one is rejected.
+#define NONCE_AUTO INT_MIN
+
+// CPUs the workers are pinned to (worker i runs on worker_cpus[i % worker_cpu_count]);
+// empty when the scheduler places them
+int* worker_cpus = NULL;
+int worker_cpu_count = 0;
+
+// This process's part of the nonce space, see nonces.h
+uint32_t nonce_worker_id = 0;
+uint32_t nonce_instance = 0;
+// Set by --dup-check: samples every worker's hashes to count duplicate work
+dup_sampler_t* dup_sampler = NULL;
+// Set by --trace: one event ring for the submitter (index 0) and one per worker slot
+trace_ring_t* trace_rings = NULL;
+
+// Allocates zeroed stats for `count` workers, each on its own cache line
+static thread_stats_t* thread_stats_alloc(int count) {
+    thread_stats_t* stats = aligned_alloc(CACHE_LINE_SIZE, sizeof(thread_stats_t) * count);
+    if (stats) memset(stats, 0, sizeof(thread_stats_t) * count);
+    return stats;
+}
 
-// To pass data to each mining thread
+// To pass data to each mining thread. Workers live for the whole process and take
+// their jobs from `current_job`.
 typedef struct {
     int thread_id;
     char* address;
-    char* node;
-    long height;
-    long block_date;
-    mpz_t difficulty;
-    int cpu_usage;
+    atomic_int cpu_usage;
+    bool background; // Runs at SCHED_IDLE priority
     thread_stats_t* stats;
+    argon2_arena_t* arena;
+    atomic_int lanes; // Candidates hashed together per iteration
+    phase_profile_t* profile; // Phase timings, recorded while profiling is on
+    uint64_t nonce_base; // Start of the worker's nonce stream; the counter restarts there for every job
+    trace_ring_t* trace; // Event ring, NULL unless tracing
 } thread_data_t;
 
 
@@ -72,8 +189,43 @@ void trim(char *str) {
     if (str != start) memmove(str, start, strlen(start) + 1);
 }
 
-// Parses miner.conf and sets the config variables
-void parse_config(const char* filename, char** node, char** address, int* num_threads, int* cpu_usage, int* report_interval) {
+// Settings from miner.conf and the command line, which overrides it
+typedef struct {
+    char* node;
+    char* address;
+    int num_threads;
+    int cpu_usage;
+    int report_interval;
+    int lanes;
+    int poll_interval_ms;
+    char* kernel_name;
+    char* submit_nodes;
+    bool discover;
+    bool flat_log;
+    int metrics_port;
+    bool profile;
+    char* affinity;
+    char* hugepages;
+    bool background;
+    int max_threads;
+    char* control_path;
+    int worker_id; // NONCE_AUTO: derived from the host
+    int instance;  // NONCE_AUTO: the first one free on this host
+    bool dup_check;
+    bool autotune;
+    char* autotune_state;
+    char* trace_path;
+    int trace_size; // MiB per trace file
+    // Command line only
+    bool benchmark;
+    double bench_duration;
+    uint64_t bench_hashes;
+    char* bench_threads;
+    char* bench_json;
+} miner_options_t;
+
+// Parses miner.conf into `options`
+void parse_config(const char* filename, miner_options_t* options) {
     FILE* file = fopen(filename, "r");
     if (!file) {
         return; // File not found, do nothing
@@ -101,15 +253,53 @@ void parse_config(const char* filename, char** node, char** address, int* num_th
         if (*value == '\0') continue; // Skip empty values
 
         if (strcmp(key, "node") == 0) {
-            *node = strdup(value);
+            options->node = strdup(value);
         } else if (strcmp(key, "address") == 0) {
-            *address = strdup(value);
+            options->address = strdup(value);
         } else if (strcmp(key, "threads") == 0) {
-            *num_threads = atoi(value);
+            options->num_threads = strcmp(value, "auto") == 0 ? THREADS_AUTO : atoi(value);
         } else if (strcmp(key, "cpu") == 0) {
-            *cpu_usage = atoi(value);
+            options->cpu_usage = atoi(value);
         } else if (strcmp(key, "report-interval") == 0) {
-            *report_interval = atoi(value);
+            options->report_interval = atoi(value);
+        } else if (strcmp(key, "kernel") == 0) {
+            options->kernel_name = strdup(value);
+        } else if (strcmp(key, "lanes") == 0) {
+            options->lanes = atoi(value);
+        } else if (strcmp(key, "poll-interval") == 0) {
+            options->poll_interval_ms = atoi(value);
+        } else if (strcmp(key, "submit-nodes") == 0) {
+            options->submit_nodes = strdup(value);
+        } else if (strcmp(key, "discover-peers") == 0) {
+            options->discover = atoi(value) != 0;
+        } else if (strcmp(key, "metrics-port") == 0) {
+            options->metrics_port = atoi(value);
+        } else if (strcmp(key, "profile") == 0) {
+            options->profile = atoi(value) != 0;
+        } else if (strcmp(key, "affinity") == 0) {
+            options->affinity = strdup(value);
+        } else if (strcmp(key, "hugepages") == 0) {
+            options->hugepages = strdup(value);
+        } else if (strcmp(key, "background") == 0) {
+            options->background = atoi(value) != 0;
+        } else if (strcmp(key, "max-threads") == 0) {
+            options->max_threads = atoi(value);
+        } else if (strcmp(key, "control") == 0) {
+            options->control_path = strdup(value);
+        } else if (strcmp(key, "worker-id") == 0) {
+            options->worker_id = atoi(value);
+        } else if (strcmp(key, "instance") == 0) {
+            options->instance = atoi(value);
+        } else if (strcmp(key, "dup-check") == 0) {
+            options->dup_check = atoi(value) != 0;
+        } else if (strcmp(key, "autotune") == 0) {
+            options->autotune = atoi(value) != 0;
+        } else if (strcmp(key, "autotune-state") == 0) {
+            options->autotune_state = strdup(value);
+        } else if (strcmp(key, "trace") == 0) {
+            options->trace_path = strdup(value);
+        } else if (strcmp(key, "trace-size") == 0) {
+            options->trace_size = atoi(value);
         }
     }
     fclose(file);
@@ -118,275 +308,1649 @@ void parse_config(const char* filename, char** node, char** address, int* num_th
 
 // --- Networking (libcurl) ---
 
-// Callback function to write curl response to our memory struct
-static size_t write_callback(void *data, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;
-    struct memory *mem = (struct memory *)userp;
+#define JSON_MAX_TOKENS 256
 
-    char *ptr = realloc(mem->response, mem->size + realsize + 1);
-    if (ptr == NULL) return 0; // out of memory
+// Tokenizes a node response and returns the index of its "data" object (or the root
+// object for nodes that answer without an envelope), -1 if it is not valid JSON.
+static int parse_node_response(const net_client_t* client, json_token_t* tokens, int* count) {
+    *count = json_parse(client->response, client->response_size, tokens, JSON_MAX_TOKENS);
+    if (*count <= 0 || tokens[0].type != JSON_OBJECT) return -1;
+    int data = json_object_get(client->response, tokens, *count, 0, "data");
+    return (data >= 0 && tokens[data].type == JSON_OBJECT) ? data : 0;
+}
 
-    mem->response = ptr;
-    memcpy(&(mem->response[mem->size]), data, realsize);
-    mem->size += realsize;
-    mem->response[mem->size] = 0;
+// Parses a `mine.php?q=info` response held by `client`
+static int parse_mining_info(const net_client_t* client, long* height, mpz_t difficulty, long* date, char* block_id, size_t block_id_len) {
+    json_token_t tokens[JSON_MAX_TOKENS];
+    int count;
+    int data = parse_node_response(client, tokens, &count);
+    const char* js = client->response;
+    int height_tok = json_object_get(js, tokens, count, data, "height");
+    int difficulty_tok = json_object_get(js, tokens, count, data, "difficulty");
+    int date_tok = json_object_get(js, tokens, count, data, "date");
+
+    long node_height;
+    char difficulty_str[128];
+    if (data < 0 || height_tok < 0 || difficulty_tok < 0 || date_tok < 0
+        || !json_token_long(js, &tokens[height_tok], &node_height)
+        || !json_token_long(js, &tokens[date_tok], date)
+        || !json_token_copy(js, &tokens[difficulty_tok], difficulty_str, sizeof(difficulty_str))
+        || mpz_set_str(difficulty, difficulty_str, 10) != 0) {
+        return 0;
+    }
+    *height = node_height + 1;
 
-    return realsize;
+    // The id of the current tip; older nodes may not report it
+    int block_tok = json_object_get(js, tokens, count, data, "block");
+    if (block_tok < 0 || !json_token_copy(js, &tokens[block_tok], block_id, block_id_len)) {
+        block_id[0] = '\0';
+    }
+    return 1;
 }
 
-// Super basic JSON parser to extract values. Not robust, but avoids a library dependency.
-char* json_extract(const char* json, const char* key) {
-    char* key_ptr = strstr(json, key);
-    if (!key_ptr) return NULL;
+int get_mining_info(net_client_t* client, const char* node, long* height, mpz_t difficulty, long* date, char* block_id, size_t block_id_len) {
+    char url[320];
+    snprintf(url, sizeof(url), "%s/mine.php?q=info", node);
 
-    char* colon_ptr = strchr(key_ptr, ':');
-    if (!colon_ptr) return NULL;
+    if (!net_get(client, url, 10L)) { // 10 second timeout
+        fprintf(stderr, "Request to %s failed: %s\n", url, client->error);
+        return 0;
+    }
+    if (!parse_mining_info(client, height, difficulty, date, block_id, block_id_len)) {
+        fprintf(stderr, "Error: Could not parse mining info from %s.\n", node);
+        return 0;
+    }
+    return 1;
+}
 
-    char* start_ptr = colon_ptr + 1;
-    while (*start_ptr == ' ' || *start_ptr == '"') start_ptr++;
+// Adds the generator peers a node knows about to the pool, like miner-4.php does.
+// Returns the number of peers added.
+int discover_peers(net_client_t* client, const char* node, node_pool_t* pool) {
+    char url[320];
+    snprintf(url, sizeof(url), "%s/api.php?q=getPeers", node);
+    if (!net_get(client, url, 10L)) {
+        fprintf(stderr, "Could not fetch the peer list from %s: %s\n", node, client->error);
+        return 0;
+    }
 
-    char* end_ptr = start_ptr;
-    while (*end_ptr != '"' && *end_ptr != ',' && *end_ptr != '}') end_ptr++;
+    json_token_t tokens[JSON_MAX_TOKENS];
+    int count = json_parse(client->response, client->response_size, tokens, JSON_MAX_TOKENS);
+    const char* js = client->response;
+    int status = count > 0 && tokens[0].type == JSON_OBJECT ? json_object_get(js, tokens, count, 0, "status") : -1;
+    int data = status >= 0 ? json_object_get(js, tokens, count, 0, "data") : -1;
+    if (data < 0 || !json_token_eq(js, &tokens[status], "ok") || tokens[data].type != JSON_ARRAY) {
+        fprintf(stderr, "Could not fetch the peer list from %s.\n", node);
+        return 0;
+    }
 
-    int len = end_ptr - start_ptr;
-    char* value = malloc(len + 1);
-    strncpy(value, start_ptr, len);
-    value[len] = '\0';
-    return value;
+    int added = 0;
+    for (int i = data + 1; i < count && tokens[i].start < tokens[data].end; i++) {
+        if (tokens[i].parent != data || tokens[i].type != JSON_OBJECT) continue;
+        int hostname = json_object_get(js, tokens, count, i, "hostname");
+        int generator = json_object_get(js, tokens, count, i, "generator");
+        char peer[256];
+        if (hostname < 0 || generator < 0 || !json_token_copy(js, &tokens[hostname], peer, sizeof(peer))) continue;
+        // Only generators accept mining requests; PHP's empty() is false for "", 0, "0", false and null
+        const json_token_t* gen = &tokens[generator];
+        if (gen->end == gen->start || json_token_eq(js, gen, "0") || json_token_eq(js, gen, "false")
+            || json_token_eq(js, gen, "null")) continue;
+        int before = node_pool_count(pool);
+        if (node_pool_add(pool, peer) >= before) added++;
+    }
+    return added;
 }
 
+// Number of rounds a submission is retried while nodes cannot be reached
+#define SUBMIT_ATTEMPTS 5
+// Delay before the first retry, doubled for each further one
+#define SUBMIT_BACKOFF_MS 250
 
-int get_mining_info(const char* node, long* height, mpz_t difficulty, long* date) {
-    CURL *curl;
-    CURLcode res;
-    struct memory chunk = {0};
-    char url[256];
-    snprintf(url, sizeof(url), "%s/mine.php?q=info", node);
-
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L); // 10 second timeout
-
-        res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-            curl_easy_cleanup(curl);
-            free(chunk.response);
-            return 0;
-        }
+static void free_solution(solution_t* solution) {
+    mpz_clears(solution->difficulty, solution->hit, solution->target, NULL);
+    free(solution->argon);
+    free(solution->nonce);
+    free(solution);
+}
 
-        char *height_str = json_extract(chunk.response, "\"height\"");
-        char *difficulty_str = json_extract(chunk.response, "\"difficulty\"");
-        char *date_str = json_extract(chunk.response, "\"date\"");
+// Parses a submission response. Returns 1 for "ok", 0 for any other status, and -1 if
+// there is no status at all (an error page or a cut-off body), which is worth a retry.
+static int parse_submit_response(const net_client_t* client) {
+    json_token_t tokens[JSON_MAX_TOKENS];
+    int count = json_parse(client->response, client->response_size, tokens, JSON_MAX_TOKENS);
+    int status = count > 0 && tokens[0].type == JSON_OBJECT ? json_object_get(client->response, tokens, count, 0, "status") : -1;
+    if (status < 0) return -1;
+    return json_token_eq(client->response, &tokens[status], "ok");
+}
 
-        if (!height_str || !difficulty_str || !date_str) {
-             fprintf(stderr, "Error: Could not parse mining info from node.\n");
-             curl_easy_cleanup(curl);
-             free(chunk.response);
-             return 0;
+// Percent-encodes a form value. The argon hash has '+' in its base64, which nodes would
+// otherwise decode as a space.
+static void form_escape(const char* value, char* out, size_t out_len) {
+    static const char hex[] = "0123456789ABCDEF";
+    size_t n = 0;
+    for (const unsigned char* c = (const unsigned char*)value; *c && n + 4 <= out_len; c++) {
+        if (isalnum(*c) || *c == '-' || *c == '_' || *c == '.' || *c == '~') {
+            out[n++] = *c;
+        } else {
+            out[n++] = '%';
+            out[n++] = hex[*c >> 4];
+            out[n++] = hex[*c & 15];
         }
-
-        *height = atol(height_str) + 1;
-        mpz_set_str(difficulty, difficulty_str, 10);
-        *date = atol(date_str);
-
-        free(height_str);
-        free(difficulty_str);
-        free(date_str);
-        free(chunk.response);
-        curl_easy_cleanup(curl);
-        return 1;
     }
-    return 0;
+    out[n] = '\0';
 }
 
-int submit_block(const char* node, const char* address, const solution_t* solution) {
-    atomic_fetch_add(&total_submits, 1);
-    CURL *curl;
-    CURLcode res;
-    struct memory chunk = {0};
-    char url[256];
+// Broadcasts a solution to all submit nodes at once and retries the ones that could not be
+// reached, with backoff, until a node accepts it, every node has answered or the block is stale.
+// Returns 1 if any node accepted the solution.
+int submit_block(submitter_config_t* config, const solution_t* solution) {
+    counter_add(&total_submits, 1);
+    char urls[SUBMIT_MAX_NODES + 1][320];
     char post_fields[1024];
 
     char* hit_str = mpz_get_str(NULL, 10, solution->hit);
     char* target_str = mpz_get_str(NULL, 10, solution->target);
     char* difficulty_str = mpz_get_str(NULL, 10, solution->difficulty);
+    char argon[384];
+    form_escape(solution->argon, argon, sizeof(argon));
 
-    snprintf(url, sizeof(url), "%s/mine.php?q=submitHash", node);
     snprintf(post_fields, sizeof(post_fields),
         "argon=%s&nonce=%s&height=%ld&difficulty=%s&address=%s&hit=%s&target=%s&date=%ld&elapsed=%d&minerInfo=phpcoin-c-miner&version=1.6.8",
-        solution->argon, solution->nonce, solution->height, difficulty_str, address,
+        argon, solution->nonce, solution->height, difficulty_str, config->address,
         hit_str, target_str, solution->date, solution->elapsed);
 
     free(hit_str);
     free(target_str);
     free(difficulty_str);
 
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url);
-        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, post_fields);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+    node_pool_selected(config->pool, config->selected, sizeof(config->selected));
+    config->nodes[config->node_count] = config->selected;
+    bool listed = false;
+    for (int i = 0; i < config->node_count; i++) {
+        if (strcmp(config->nodes[i], config->selected) == 0) listed = true;
+    }
+    int node_count = listed ? config->node_count : config->node_count + 1;
+
+    for (int i = 0; i < node_count; i++) {
+        snprintf(urls[i], sizeof(urls[i]), "%s/mine.php?q=submitHash", config->nodes[i]);
+    }
 
-        res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            fprintf(stderr, "curl_easy_perform() failed: %s\n", curl_easy_strerror(res));
-            curl_easy_cleanup(curl);
-            free(chunk.response);
-            return 0;
+    int pending[SUBMIT_MAX_NODES + 1]; // Indexes of the nodes still to be asked
+    int pending_count = node_count;
+    for (int i = 0; i < pending_count; i++) pending[i] = i;
+    int accepted = 0;
+    bool acked = false;
+    long backoff_ms = SUBMIT_BACKOFF_MS;
+
+    for (int attempt = 1; attempt <= SUBMIT_ATTEMPTS && pending_count > 0 && !accepted; attempt++) {
+        net_client_t* clients[SUBMIT_MAX_NODES + 1];
+        const char* attempt_urls[SUBMIT_MAX_NODES + 1];
+        int ok[SUBMIT_MAX_NODES + 1];
+        for (int j = 0; j < pending_count; j++) {
+            clients[j] = config->clients[pending[j]];
+            attempt_urls[j] = urls[pending[j]];
+        }
+        net_post_all(clients, attempt_urls, post_fields, pending_count, 10L, ok);
+
+        int retry_count = 0;
+        for (int j = 0; j < pending_count; j++) {
+            int node = pending[j];
+            net_client_t* client = clients[j];
+            int result = ok[j] ? parse_submit_response(client) : -1;
+            if (result >= 0 && !acked) {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                long usec = (now.tv_sec - solution->found_at.tv_sec) * 1000000L + (now.tv_nsec - solution->found_at.tv_nsec) / 1000;
+                net_latency_record(&ack_latency, (uint32_t)usec);
+                acked = true;
+            }
+            if (result > 0) accepted = 1;
+            if (result < 0) pending[retry_count++] = node; // Transient: ask again
+            trace_record(trace_rings, TRACE_SUBMIT, result > 0 ? TRACE_OK : result == 0 ? TRACE_REJECTED : TRACE_FAILED,
+                node, solution->height);
+
+            pthread_mutex_lock(&console_mutex);
+            if (ok[j]) {
+                printf("\nSubmission response from %s: %s\n", config->nodes[node], client->response);
+            } else {
+                fprintf(stderr, "\nRequest to %s failed: %s\n", attempt_urls[j], client->error);
+            }
+            pthread_mutex_unlock(&console_mutex);
         }
+        pending_count = retry_count;
+
+        // Once the node has moved past this height the solution can no longer win
+        if (pending_count > 0 && !accepted && attempt < SUBMIT_ATTEMPTS) {
+            pthread_mutex_lock(&job_mutex);
+            bool stale = current_job.height > solution->height;
+            pthread_mutex_unlock(&job_mutex);
+            if (stale) break;
+            usleep(backoff_ms * 1000L);
+            backoff_ms *= 2;
+        }
+    }
+    atomic_store(&report_interrupted, true);
 
-        pthread_mutex_lock(&console_mutex);
-        printf("\nSubmission response: %s\n", chunk.response);
-        pthread_mutex_unlock(&console_mutex);
+    if (accepted) {
+        counter_add(&total_accepted, 1);
+    } else {
+        counter_add(&total_rejected, 1);
+    }
+    return accepted;
+}
+
+// Submits solutions as soon as a worker queues them. Runs on its own thread so that
+// neither the workers nor the stats output ever wait for the network.
+void* submitter_thread(void* arg) {
+    submitter_config_t* config = (submitter_config_t*)arg;
+    while (1) {
+        while (sem_wait(&solution_ready) != 0); // Retry on EINTR
+        solution_t* solution = mpsc_queue_pop(&solution_queue);
+        if (!solution) continue;
+        submit_block(config, solution);
+        free_solution(solution);
+    }
+    return NULL;
+}
+
+// Prints one line of latency percentiles, e.g. of a client's requests
+void print_latency(const char* label, net_latency_t* latency) {
+    static const double percentiles[3] = { 50, 90, 99 };
+    double ms[3];
+    int samples = latency ? net_latency_percentiles(latency, percentiles, ms, 3) : 0;
+    if (samples == 0) {
+        printf("%s latency: no samples", label);
+    } else {
+        printf("%s latency p50/p90/p99: %.1f/%.1f/%.1f ms (%d samples)", label, ms[0], ms[1], ms[2], samples);
+    }
+}
+
+
+// --- Work Dispatcher ---
+
+// Publishes a job seen on node `source`, unless it is the job being mined. The selected
+// node is `authoritative` and may also move the tip sideways or back (a reorg); any other
+// node only gets a say when it is strictly ahead.
+void publish_job(int source, bool authoritative, long height, long date, const char* block_id, const mpz_t difficulty) {
+    pthread_mutex_lock(&job_mutex);
+    uint64_t previous = atomic_load(&job_epoch);
+    bool changed = previous == 0
+        || height != current_job.height
+        || strcmp(block_id, current_job.block_id) != 0;
+    if (changed && previous != 0 && !authoritative && height <= current_job.height) {
+        changed = false;
+    }
+    if (changed) {
+        // Leaving a job nobody found a solution for drops the work done on it
+        if (previous != 0 && atomic_load(&solution_epoch) != previous) {
+            counter_add(&total_dropped, 1);
+        }
+        current_job.height = height;
+        current_job.block_date = date;
+        snprintf(current_job.block_id, sizeof(current_job.block_id), "%s", block_id);
+        mpz_set(current_job.difficulty, difficulty);
+        current_job.first_elapsed = calculate_first_winnable_elapsed(difficulty, height);
+        current_job.source = source;
+        current_job.epoch = previous + 1;
+        clock_gettime(CLOCK_MONOTONIC, &current_job.published);
+        atomic_store_explicit(&job_epoch, current_job.epoch, memory_order_release);
+        pthread_cond_broadcast(&job_cond);
+    }
+    pthread_mutex_unlock(&job_mutex);
+}
+
+// Re-selects the node to poll and reports a change. Returns the selected index.
+static int reselect_node(node_pool_t* pool) {
+    const char* reason;
+    int selected = node_pool_select(pool, &reason);
+    if (!reason) return selected;
+    char url[320];
+    node_pool_url(pool, selected, url, sizeof(url));
+    pthread_mutex_lock(&console_mutex);
+    fprintf(stderr, "\nSwitching to node %s (previous node %s).\n", url, reason);
+    pthread_mutex_unlock(&console_mutex);
+    atomic_store(&report_interrupted, true);
+    return selected;
+}
 
-        // Basic check for "ok" status in response
-        int success = (strstr(chunk.response, "\"status\":\"ok\"") != NULL);
-        if (success) {
-            atomic_fetch_add(&total_accepted, 1);
+// Polls the selected node and publishes a new job whenever the tip changes. This is the only
+// thread that asks a node for work every poll, so network latency never reaches the hashing loop.
+void* dispatcher_thread(void* arg) {
+    dispatcher_config_t* config = (dispatcher_config_t*)arg;
+    long height, date;
+    char block_id[sizeof(current_job.block_id)];
+    mpz_t difficulty;
+    mpz_init(difficulty);
+    int failovers = 0; // Nodes tried without waiting since the last successful poll
+
+    while (1) {
+        char node[256];
+        int index = node_pool_selected(config->pool, node, sizeof(node));
+        bool ok = get_mining_info(config->client, node, &height, difficulty, &date, block_id, sizeof(block_id));
+        node_pool_report(config->pool, index, ok, height, net_latency_last(&config->client->latency));
+
+        // A node that turns out to be down or behind the others is replaced before its
+        // answer is used; ask the next node right away, but go round the pool only once
+        if (reselect_node(config->pool) != index && failovers < node_pool_count(config->pool)) {
+            failovers++;
+            continue;
+        }
+        if (ok) {
+            publish_job(index, true, height, date, block_id, difficulty);
+            failovers = 0;
         } else {
-            atomic_fetch_add(&total_rejected, 1);
+            fprintf(stderr, "Failed to get mining info from %s. Retrying in %d ms.\n", node, config->poll_interval_ms);
+        }
+        usleep(config->poll_interval_ms * 1000L);
+    }
+    mpz_clear(difficulty);
+    return NULL;
+}
+
+// How often every node in the pool is checked
+#define HEALTH_CHECK_INTERVAL_MS 5000
+// Health-check rounds between two peer discoveries
+#define PEER_REFRESH_ROUNDS 60
+
+// Asks every node for its tip at once, so the dispatcher can move away from a node that is
+// down or lagging, and a node that is ahead can publish its job straight away.
+void* health_thread(void* arg) {
+    health_config_t* config = (health_config_t*)arg;
+    node_pool_t* pool = config->pool;
+    long height, date;
+    char block_id[sizeof(current_job.block_id)];
+    mpz_t difficulty;
+    mpz_init(difficulty);
+
+    for (int round = 1; ; round++) {
+        usleep(HEALTH_CHECK_INTERVAL_MS * 1000L);
+
+        // Nodes are only ever appended, so every node below the count is complete.
+        // Disabled nodes are left alone.
+        int pool_count = node_pool_count(pool);
+        int count = 0;
+        int indices[NODE_POOL_MAX];
+        net_client_t* clients[NODE_POOL_MAX];
+        char urls[NODE_POOL_MAX][320];
+        const char* url_ptrs[NODE_POOL_MAX];
+        int ok[NODE_POOL_MAX];
+        for (int i = 0; i < pool_count; i++) {
+            if (node_pool_disabled(pool, i)) continue;
+            char node[256];
+            node_pool_url(pool, i, node, sizeof(node));
+            snprintf(urls[count], sizeof(urls[count]), "%s/mine.php?q=info", node);
+            url_ptrs[count] = urls[count];
+            clients[count] = pool->nodes[i].client;
+            indices[count++] = i;
         }
+        net_get_all(clients, url_ptrs, count, 10L, ok);
+
+        for (int n = 0; n < count; n++) {
+            int i = indices[n];
+            if (ok[n] && parse_mining_info(clients[n], &height, difficulty, &date, block_id, sizeof(block_id))) {
+                node_pool_report(pool, i, 1, height, net_latency_last(&clients[n]->latency));
+                publish_job(i, false, height, date, block_id, difficulty);
+            } else {
+                node_pool_report(pool, i, 0, 0, 0);
+            }
+        }
+        reselect_node(pool);
 
-        free(chunk.response);
-        curl_easy_cleanup(curl);
-        return success;
+        if (config->discover_peers && round % PEER_REFRESH_ROUNDS == 0) {
+            char node[256];
+            int selected = node_pool_selected(pool, node, sizeof(node));
+            discover_peers(pool->nodes[selected].client, node, pool);
+        }
     }
-    return 0;
+    mpz_clear(difficulty);
+    return NULL;
+}
+
+// Blocks until a job newer than `after_epoch` is published, then copies it into `job`
+// (whose difficulty must be initialized)
+void wait_for_job(uint64_t after_epoch, mining_job_t* job) {
+    pthread_mutex_lock(&job_mutex);
+    while (atomic_load(&job_epoch) <= after_epoch && !atomic_load(&workers_stop)) {
+        pthread_cond_wait(&job_cond, &job_mutex);
+    }
+    job->epoch = current_job.epoch;
+    job->height = current_job.height;
+    job->block_date = current_job.block_date;
+    memcpy(job->block_id, current_job.block_id, sizeof(job->block_id));
+    mpz_set(job->difficulty, current_job.difficulty);
+    job->first_elapsed = current_job.first_elapsed;
+    job->published = current_job.published;
+    job->source = current_job.source;
+    pthread_mutex_unlock(&job_mutex);
+}
+
+// Seconds since the epoch on the clock the condition variables time out on. The worker
+// reads its elapsed time from it too, so a wait that timed out always finds the job winnable
+// (time() reads a coarser clock that may still be a tick short of the deadline).
+static long realtime_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec;
+}
+
+// Sleeps until `job` can be won, a newer job is published or the workers stop
+static void wait_until_winnable(const mining_job_t* job) {
+    struct timespec deadline = { .tv_sec = job->block_date + job->first_elapsed, .tv_nsec = 0 };
+    pthread_mutex_lock(&job_mutex);
+    while (atomic_load(&job_epoch) == job->epoch && !atomic_load(&workers_stop) && realtime_seconds() < deadline.tv_sec) {
+        if (pthread_cond_timedwait(&job_cond, &job_mutex, &deadline) == ETIMEDOUT) break;
+    }
+    pthread_mutex_unlock(&job_mutex);
 }
 
 
 // --- Mining Thread ---
 
+static bool worker_parked(int thread_id) {
+    return thread_id > atomic_load_explicit(&worker_limit, memory_order_relaxed)
+        || thread_id > atomic_load_explicit(&workers_active, memory_order_relaxed);
+}
+
+// Blocks worker `thread_id` while it is parked
+static void park_worker(int thread_id) {
+    pthread_mutex_lock(&park_mutex);
+    while (worker_parked(thread_id) && !atomic_load(&workers_stop)) {
+        pthread_cond_wait(&park_cond, &park_mutex);
+    }
+    pthread_mutex_unlock(&park_mutex);
+}
+
+// Workers that are started and not parked by the control socket
+static int worker_count(void) {
+    int limit = atomic_load(&worker_limit), started = atomic_load(&workers_started);
+    return limit < started ? limit : started;
+}
+
+// Workers that are started and not parked at all
+static int workers_running(void) {
+    int count = worker_count(), active = atomic_load(&workers_active);
+    return active < count ? active : count;
+}
+
+// Lets more workers run after `worker_limit` or `workers_active` went up
+static void unpark_workers(void) {
+    pthread_mutex_lock(&park_mutex);
+    pthread_cond_broadcast(&park_cond);
+    pthread_mutex_unlock(&park_mutex);
+}
+
+// Asked by the Argon2 kernels between segments of a fill (`arg` is the epoch of the job
+// being hashed): a new job, or the miner stopping, abandons the hash in progress
+static int job_cancelled(void* arg) {
+    uint64_t epoch = *(const uint64_t*)arg;
+    return atomic_load_explicit(&job_epoch, memory_order_relaxed) != epoch
+        || atomic_load_explicit(&workers_stop, memory_order_relaxed);
+}
+
+// Gives up on the solution a worker claimed for job `epoch`: hands the claim back, so that
+// a later hit on the job can still be submitted, and counts and reports the loss
+static void lose_solution(int thread_id, uint64_t epoch, uint64_t previous_epoch, const char* reason) {
+    // Unless another worker has claimed a solution for a newer job since
+    atomic_compare_exchange_strong(&solution_epoch, &epoch, previous_epoch);
+    pthread_mutex_lock(&console_mutex);
+    counter_add(&total_lost, 1);
+    fprintf(stderr, "\nThread %d: %s, dropping the solution.\n", thread_id, reason);
+    pthread_mutex_unlock(&console_mutex);
+    atomic_store(&report_interrupted, true);
+}
+
 void* miner_thread(void* arg) {
     thread_data_t* data = (thread_data_t*)arg;
     thread_stats_t* stats = data->stats;
-    stats->pid = syscall(SYS_gettid);
-
-    mpz_t hit, target;
-    mpz_inits(hit, target, NULL);
+    phase_profile_t* profile = data->profile;
+    atomic_store_explicit(&stats->pid, syscall(SYS_gettid), memory_order_relaxed);
+
+    if (data->background) {
+        // Any runnable task of normal priority preempts a SCHED_IDLE one at once; the
+        // lowest nice level is the fallback where the policy is not allowed
+        struct sched_param param = { 0 };
+        if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+            setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+        }
+    }
 
-    long sleep_time = (100 - data->cpu_usage) * 500;
+    // The arena stays bound for the life of the worker, so only the first job pays for faulting it in
+    argon2_arena_bind(data->arena);
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    long start_faults = usage.ru_minflt + usage.ru_majflt;
+
+    mining_job_t job;
+    job.epoch = 0;
+    mpz_init(job.difficulty);
+    argon2_kernel_set_cancel(job_cancelled, &job.epoch);
+    bool need_job = true; // Block until the dispatcher has (another) job for us
+
+    // Everything that stays the same for the attempts at one elapsed value, prepared once
+    // for it, and the buffers of the attempts; neither allocates while hashing
+    attempt_job_t attempt;
+    int attempt_elapsed = -1;
+    attempt_scratch_t scratch;
+    attempt_scratch_init(&scratch, data->arena);
+
+    struct timespec busy_since = { 0, 0 }; // Start of the current batch, for --cpu
     uint64_t thread_nonce = 0;
 
 
-    while (!block_found) {
-        if (data->cpu_usage < 100) {
-            usleep(sleep_time);
+    while (!atomic_load_explicit(&workers_stop, memory_order_relaxed)) {
+        if (worker_parked(data->thread_id)) {
+            trace_record(data->trace, TRACE_PARK, 1, 0, 0);
+            park_worker(data->thread_id);
+            trace_record(data->trace, TRACE_PARK, 0, 0, 0);
+            busy_since.tv_sec = 0;
+            continue;
+        }
+        // The control socket may change the lanes and CPU share between batches
+        int lanes = atomic_load_explicit(&data->lanes, memory_order_relaxed);
+        int cpu_usage = atomic_load_explicit(&data->cpu_usage, memory_order_relaxed);
+        if (data->arena && lanes * ARGON2_ARENA_SIZE > data->arena->size) {
+            argon2_arena_bind(NULL);
+            argon2_arena_destroy(data->arena);
+            if (!argon2_arena_init(data->arena, lanes * ARGON2_ARENA_SIZE)) {
+                fprintf(stderr, "Warning: thread %d will allocate Argon2 memory per hash.\n", data->thread_id);
+                data->arena = NULL;
+            }
+            argon2_arena_bind(data->arena);
+        }
+        uint64_t phase_start = profile_now();
+        // Switch to a new job in place, between two batches
+        if (need_job || atomic_load_explicit(&job_epoch, memory_order_acquire) != job.epoch) {
+            uint64_t previous = job.epoch;
+            wait_for_job(job.epoch, &job);
+            if (atomic_load(&workers_stop)) break;
+            if (previous != 0) {
+                struct timespec now;
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                long usec = (now.tv_sec - job.published.tv_sec) * 1000000L + (now.tv_nsec - job.published.tv_nsec) / 1000;
+                net_latency_record(&switch_latency, usec > 0 ? (uint32_t)usec : 0);
+                stat_add(&stats->job_switches, 1);
+            }
+            attempt_elapsed = -1;
+            thread_nonce = data->nonce_base;
+            need_job = false;
+            trace_record(data->trace, TRACE_JOB_SWITCH, 0, (uint32_t)job.epoch, job.height);
+        }
+        profile_record(profile, PHASE_JOB, phase_start, profile_now());
+
+        if (cpu_usage < 100) {
+            // Idle in proportion to how long the last batch took, so that the worker is
+            // busy cpu_usage% of the time whatever the speed of the host
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (busy_since.tv_sec != 0) {
+                long busy_us = (now.tv_sec - busy_since.tv_sec) * 1000000L + (now.tv_nsec - busy_since.tv_nsec) / 1000;
+                usleep(busy_us * (100 - cpu_usage) / cpu_usage);
+            }
+            clock_gettime(CLOCK_MONOTONIC, &busy_since);
         }
-        long current_time = time(NULL);
-        int elapsed = current_time - data->block_date;
+        long current_time = realtime_seconds();
+        int elapsed = current_time - job.block_date;
         if (elapsed < 0) elapsed = 0;
 
-        stats->height = data->height;
-        stats->elapsed = elapsed;
+        atomic_store_explicit(&stats->height, job.height, memory_order_relaxed);
+        atomic_store_explicit(&stats->elapsed, elapsed, memory_order_relaxed);
 
-        char* argon = calculate_argon_hash(data->address, data->block_date, elapsed, data->height, thread_nonce);
-        if (!argon) continue;
+        // Until the target drops below the largest possible hit no attempt can win
+        if (elapsed < job.first_elapsed) {
+            trace_record(data->trace, TRACE_WAIT, 0, job.first_elapsed - elapsed, 0);
+            wait_until_winnable(&job);
+            busy_since.tv_sec = 0;
+            continue;
+        }
 
-        stats->local_hashes++;
-        thread_nonce++;
+        if (elapsed != attempt_elapsed) {
+            phase_start = profile_now();
+            attempt_elapsed = elapsed;
+            if (!attempt_job_prepare(&attempt, data->address, job.block_date, elapsed, job.height, job.difficulty)) {
+                pthread_mutex_lock(&console_mutex);
+                gmp_fprintf(stderr, "Thread %d: difficulty %Zd is too long, waiting for the next block\n", data->thread_id, job.difficulty);
+                pthread_mutex_unlock(&console_mutex);
+                need_job = true;
+                continue;
+            }
+            stats_set_target(stats, attempt.target);
+            profile_record(profile, PHASE_TARGET, phase_start, profile_now());
+        }
 
-        char* nonce = calculate_nonce(data->address, data->block_date, elapsed, argon);
-        if (!nonce) {
-            free(argon);
+        phase_start = profile_now();
+        attempt_result_t results[ARGON2_MAX_INTERLEAVE];
+        scratch.arena = data->arena; // May have been replaced for more lanes
+        trace_record(data->trace, TRACE_ATTEMPT_START, lanes, elapsed, thread_nonce);
+        int made = attempt_argon_batch(&attempt, &scratch, thread_nonce, lanes, results);
+        if (made != lanes) {
+            trace_record(data->trace, TRACE_ATTEMPT_END, made == ARGON2_KERNEL_CANCELLED ? TRACE_CANCELLED : TRACE_FAILED, 0, 0);
+            // A cancelled batch is picked up by the job switch at the top of the loop
+            if (made == ARGON2_KERNEL_CANCELLED) {
+                stat_add(&stats->aborted, lanes);
+            } else {
+                pthread_mutex_lock(&console_mutex);
+                fprintf(stderr, "Thread %d: error creating Argon2 hash: %s\n", data->thread_id, attempt_error_message(&scratch));
+                pthread_mutex_unlock(&console_mutex);
+            }
             continue;
         }
+        uint64_t phase_end = profile_now();
+        profile_record(profile, PHASE_ARGON, phase_start, phase_end);
+
+        stat_add(&stats->hashes, lanes);
+        thread_nonce += lanes;
+        if (dup_sampler) {
+            for (int k = 0; k < lanes; k++) dup_sampler_add(dup_sampler, results[k].argon);
+        }
+
+        getrusage(RUSAGE_THREAD, &usage);
+        atomic_store_explicit(&stats->page_faults, usage.ru_minflt + usage.ru_majflt - start_faults, memory_order_relaxed);
+
+        // The stats phase is split around the nonces and hits; its first part is carried over
+        phase_start = profile_now();
+        uint64_t stats_ticks = phase_start - phase_end;
+        attempt_finish_batch(&attempt, results, lanes);
+        phase_end = profile_now();
+        profile_record(profile, PHASE_NONCE_HIT, phase_start, phase_end);
+        if (data->trace) {
+            uint64_t batch_best = 0;
+            for (int k = 0; k < lanes; k++) {
+                if (results[k].hit > batch_best) batch_best = results[k].hit;
+            }
+            trace_record(data->trace, TRACE_ATTEMPT_END, TRACE_OK, lanes, batch_best);
+        }
 
-        calculate_hit(hit, data->address, nonce, data->height, data->difficulty);
-        calculate_target(target, elapsed, data->difficulty);
-
-        // --- Update stats ---
-        pthread_mutex_lock(&stats->stat_mutex);
-        mpz_set(stats->hit, hit);
-        mpz_set(stats->target, target);
-        if (mpz_cmp(hit, stats->best_hit) > 0) {
-            mpz_set(stats->best_hit, hit);
-        }
-        pthread_mutex_unlock(&stats->stat_mutex);
-        // --- End of stats update ---
-
-        if (mpz_cmp(hit, target) > 0) {
-            // Use a mutex to ensure only one thread can set the solution
-            pthread_mutex_lock(&solution_mutex);
-            if (!block_found) { // Double check after acquiring the lock
-                block_found = true;
-                found_solution = malloc(sizeof(solution_t));
-                mpz_inits(found_solution->difficulty, found_solution->hit, found_solution->target, NULL);
-                found_solution->argon = argon; // Transfer ownership of the memory
-                found_solution->nonce = nonce; // Transfer ownership of the memory
-                found_solution->height = data->height;
-                mpz_set(found_solution->difficulty, data->difficulty);
-                found_solution->date = data->block_date + elapsed;
-                mpz_set(found_solution->hit, hit);
-                mpz_set(found_solution->target, target);
-                found_solution->elapsed = elapsed;
+        for (int k = 0; k < lanes; k++) {
+            uint64_t hit = results[k].hit;
+            bool is_solution = results[k].is_solution;
+
+            atomic_store_explicit(&stats->hit, hit, memory_order_relaxed);
+            if (hit > stat_get(&stats->best_hit)) {
+                atomic_store_explicit(&stats->best_hit, hit, memory_order_relaxed);
+                trace_record(data->trace, TRACE_BEST_HIT, 0, elapsed, hit);
+            }
+
+            uint64_t last_epoch = atomic_load(&solution_epoch);
+            // Only one thread claims the solution for this job
+            if (is_solution && last_epoch != job.epoch
+                && atomic_compare_exchange_strong(&solution_epoch, &last_epoch, job.epoch)) {
+                solution_t* solution = malloc(sizeof(solution_t));
+                if (solution) {
+                    mpz_inits(solution->difficulty, solution->hit, solution->target, NULL);
+                    solution->argon = strdup(results[k].argon);
+                    solution->nonce = strdup(results[k].nonce);
+                }
+                if (!solution || !solution->argon || !solution->nonce) {
+                    if (solution) free_solution(solution);
+                    lose_solution(data->thread_id, job.epoch, last_epoch, "out of memory");
+                    continue;
+                }
+                clock_gettime(CLOCK_MONOTONIC, &solution->found_at);
+                solution->height = job.height;
+                mpz_set(solution->difficulty, job.difficulty);
+                solution->date = job.block_date + elapsed;
+                mpz_set_ui(solution->hit, hit);
+                calculate_target(solution->target, elapsed, job.difficulty);
+                solution->elapsed = elapsed;
+
+                // Hand the solution to the submitter before anything else; it owns it from here
+                if (!mpsc_queue_push(&solution_queue, solution)) {
+                    free_solution(solution);
+                    lose_solution(data->thread_id, job.epoch, last_epoch, "the solution queue is full");
+                    continue;
+                }
+                sem_post(&solution_ready);
+                trace_record(data->trace, TRACE_CANDIDATE, 0, elapsed, hit);
 
                 pthread_mutex_lock(&console_mutex);
                 printf("\n\n!!! BLOCK FOUND BY THREAD %d !!!\n", data->thread_id);
-                gmp_printf("Height: %ld\nNonce: %s\nHit: %Zd\nTarget: %Zd\n\n",
-                    found_solution->height, found_solution->nonce, found_solution->hit, found_solution->target);
+                printf("Height: %ld\nNonce: %s\nHit: %llu\n", job.height, results[k].nonce, (unsigned long long)hit);
+                char target_str[48];
+                u128_to_str(attempt.target, target_str, sizeof(target_str));
+                printf("Target: %s\n\n", target_str);
                 pthread_mutex_unlock(&console_mutex);
+                atomic_store(&report_interrupted, true);
             }
-             pthread_mutex_unlock(&solution_mutex);
-        }
-
-        if(!block_found) {
-            free(argon);
-            free(nonce);
-        }
-
-        // Check for a new block on the network every 10 attempts
-        if (thread_nonce % 10 == 0) {
-            long current_network_height;
-            mpz_t temp_difficulty;
-            mpz_init(temp_difficulty);
-            long temp_date;
-            if (get_mining_info(data->node, &current_network_height, temp_difficulty, &temp_date)) {
-                if (current_network_height > data->height) {
-                    if(!block_found) { // prevent multiple dropped messages
-                        atomic_fetch_add(&total_dropped, 1);
-                        pthread_mutex_lock(&console_mutex);
-                        printf("\nNew block detected on the network. Restarting miner...\n");
-                        pthread_mutex_unlock(&console_mutex);
-                        block_found = true; // Signal main loop to restart
-                    }
-                }
+        }
+        profile_record(profile, PHASE_STATS, phase_end - stats_ticks, profile_now());
+    }
+
+    argon2_arena_bind(NULL);
+    argon2_kernel_set_cancel(NULL, NULL);
+    mpz_clear(job.difficulty);
+    return NULL;
+}
+
+// Starts worker `index`, pinned to its CPU when placement is on. The affinity is set before
+// the thread runs, so its arena is faulted in on the right core.
+static void start_worker(pthread_t* thread, thread_data_t* data, int index) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (worker_cpu_count > 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker_cpus[index % worker_cpu_count], &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    if (pthread_create(thread, &attr, miner_thread, data) != 0) {
+        fprintf(stderr, "Failed to start worker thread %d.\n", index + 1);
+        exit(EXIT_FAILURE);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+// Everything the workers of the miner need, for --max-threads of them
+typedef struct {
+    int capacity;
+    pthread_t* threads;
+    thread_data_t* data;
+    argon2_arena_t* arenas;
+    phase_profile_t* profiles;
+} worker_pool_t;
+
+static int worker_pool_alloc(worker_pool_t* workers, int capacity) {
+    workers->capacity = capacity;
+    workers->threads = calloc(capacity, sizeof(pthread_t));
+    workers->data = calloc(capacity, sizeof(thread_data_t));
+    workers->arenas = calloc(capacity, sizeof(argon2_arena_t));
+    workers->profiles = calloc(capacity, sizeof(phase_profile_t));
+    mining_stats = thread_stats_alloc(capacity);
+    return workers->threads && workers->data && workers->arenas && workers->profiles && mining_stats;
+}
+
+// Starts workers until `count` are running, each with its own arena. Only one thread may
+// start workers at a time: main at startup, the control socket later.
+static void worker_pool_start(worker_pool_t* workers, int count, char* address, int cpu_usage, bool background, int lanes) {
+    for (int i = atomic_load(&workers_started); i < count && i < workers->capacity; i++) {
+        if (!argon2_arena_init(&workers->arenas[i], lanes * ARGON2_ARENA_SIZE)) {
+            fprintf(stderr, "Warning: thread %d will allocate Argon2 memory per hash.\n", i + 1);
+        }
+        mining_stats[i].id = i + 1;
+
+        thread_data_t* data = &workers->data[i];
+        data->thread_id = i + 1;
+        data->address = address;
+        data->cpu_usage = cpu_usage;
+        data->background = background;
+        data->stats = &mining_stats[i];
+        data->arena = workers->arenas[i].base ? &workers->arenas[i] : NULL;
+        data->lanes = lanes;
+        data->profile = &workers->profiles[i];
+        data->nonce_base = nonce_stream_base(nonce_worker_id, nonce_instance, i);
+        data->trace = trace_rings ? &trace_rings[i + 1] : NULL;
+
+        start_worker(&workers->threads[i], data, i);
+        atomic_store(&workers_started, i + 1);
+    }
+}
+
+// Most NUMA nodes told apart in the arena report
+#define ARENA_REPORT_NODES 64
+// How long the report waits for the workers to fault in their arenas
+#define ARENA_REPORT_WAIT_MS 30000
+
+typedef struct {
+    int arenas;                         // Arenas that were mapped at all
+    size_t bytes;
+    size_t huge_bytes;                  // Bytes actually backed by huge pages
+    int pages[3];                       // Arenas per argon2_pages_t
+    int nodes[ARENA_REPORT_NODES];      // Arenas per NUMA node of their first page
+    int unknown_nodes;
+} arena_report_t;
+
+// Waits until the workers have faulted in `count` arenas and collects what the kernel gave them
+static void arena_report(const argon2_arena_t* arenas, int count, arena_report_t* report) {
+    memset(report, 0, sizeof(*report));
+    for (int waited = 0; waited < ARENA_REPORT_WAIT_MS; waited += 10) {
+        bool ready = true;
+        for (int i = 0; i < count; i++) {
+            if (arenas[i].base && !atomic_load(&arenas[i].prefaulted)) ready = false;
+        }
+        if (ready) break;
+        usleep(10000);
+    }
+    for (int i = 0; i < count; i++) {
+        if (!arenas[i].base) continue;
+        size_t huge_bytes;
+        int node;
+        argon2_arena_backing(&arenas[i], &huge_bytes, &node);
+        report->arenas++;
+        report->bytes += arenas[i].size;
+        report->huge_bytes += huge_bytes;
+        report->pages[arenas[i].pages]++;
+        if (node >= 0 && node < ARENA_REPORT_NODES) report->nodes[node]++;
+        else report->unknown_nodes++;
+    }
+}
+
+static double arena_huge_percent(const arena_report_t* report) {
+    return report->bytes > 0 ? 100.0 * report->huge_bytes / report->bytes : 0;
+}
+
+static void print_arena_report(const arena_report_t* report, const char* mode) {
+    printf("Argon2 Memory: %d x %zu MiB, %.0f%% on huge pages (requested %s: %d hugetlb, %d THP, %d small)\n",
+        report->arenas, report->arenas ? report->bytes / report->arenas / (1024 * 1024) : 0,
+        arena_huge_percent(report), mode, report->pages[ARGON2_PAGES_HUGETLB],
+        report->pages[ARGON2_PAGES_THP], report->pages[ARGON2_PAGES_SMALL]);
+    printf("NUMA:");
+    for (int node = 0; node < ARENA_REPORT_NODES; node++) {
+        if (report->nodes[node]) printf(" node %d: %d", node, report->nodes[node]);
+    }
+    if (report->unknown_nodes) printf(" unknown: %d", report->unknown_nodes);
+    printf(" arena(s)\n");
+}
+
+
+// --- Metrics ---
+
+// The hash rate on the metrics endpoint is averaged over this many seconds
+#define METRICS_RATE_WINDOW 10
+
+// To configure the metrics thread
+typedef struct {
+    metrics_server_t server;
+    int thread_count; // Worker slots, started or not
+    // Hash counters of every worker, sampled once a second; only the metrics thread uses them
+    uint64_t* samples; // [METRICS_RATE_WINDOW + 1][thread_count]
+    double sample_times[METRICS_RATE_WINDOW + 1];
+    int sample_count;
+} metrics_config_t;
+
+static double monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Hash rate of worker `i` over the sampled window, or of all workers for i < 0
+static double metrics_rate(const metrics_config_t* config, int i) {
+    if (config->sample_count < 2) return 0;
+    int newest = (config->sample_count - 1) % (METRICS_RATE_WINDOW + 1);
+    int oldest = config->sample_count > METRICS_RATE_WINDOW ? (newest + 1) % (METRICS_RATE_WINDOW + 1) : 0;
+    const uint64_t* last = config->samples + (size_t)newest * config->thread_count;
+    const uint64_t* first = config->samples + (size_t)oldest * config->thread_count;
+    uint64_t hashes = 0;
+    for (int t = 0; t < config->thread_count; t++) {
+        if (i < 0 || t == i) hashes += last[t] - first[t];
+    }
+    return hashes / (config->sample_times[newest] - config->sample_times[oldest]);
+}
+
+// Exports latency percentiles as a gauge in seconds, one series per quantile
+static void metrics_latency(metrics_buffer_t* out, const char* name, const char* help, net_latency_t* latency) {
+    static const double percentiles[3] = { 50, 90, 99 };
+    double ms[3];
+    if (net_latency_percentiles(latency, percentiles, ms, 3) == 0) return;
+    metrics_describe(out, name, "gauge", help);
+    for (int i = 0; i < 3; i++) {
+        metrics_printf(out, "%s{quantile=\"%g\"} %.6f\n", name, percentiles[i] / 100, ms[i] / 1000);
+    }
+}
+
+static void render_metrics(metrics_buffer_t* out, void* arg) {
+    metrics_config_t* config = arg;
+    int started = atomic_load(&workers_started);
+
+    metrics_describe(out, "phpcoin_miner_hashrate", "gauge", "Hashes per second of all workers, averaged over the last 10 seconds.");
+    metrics_printf(out, "phpcoin_miner_hashrate %.3f\n", metrics_rate(config, -1));
+    metrics_describe(out, "phpcoin_miner_thread_hashrate", "gauge", "Hashes per second of one worker, averaged over the last 10 seconds.");
+    for (int i = 0; i < started; i++) {
+        metrics_printf(out, "phpcoin_miner_thread_hashrate{thread=\"%d\"} %.3f\n", mining_stats[i].id, metrics_rate(config, i));
+    }
+    metrics_describe(out, "phpcoin_miner_hashes_total", "counter", "Hashes computed by one worker.");
+    for (int i = 0; i < started; i++) {
+        metrics_printf(out, "phpcoin_miner_hashes_total{thread=\"%d\"} %llu\n", mining_stats[i].id,
+            (unsigned long long)stat_get(&mining_stats[i].hashes));
+    }
+    metrics_describe(out, "phpcoin_miner_best_hit", "gauge", "Best hit found by one worker.");
+    for (int i = 0; i < started; i++) {
+        metrics_printf(out, "phpcoin_miner_best_hit{thread=\"%d\"} %llu\n", mining_stats[i].id,
+            (unsigned long long)stat_get(&mining_stats[i].best_hit));
+    }
+    metrics_describe(out, "phpcoin_miner_job_switches_total", "counter", "New blocks one worker moved on to.");
+    for (int i = 0; i < started; i++) {
+        metrics_printf(out, "phpcoin_miner_job_switches_total{thread=\"%d\"} %llu\n", mining_stats[i].id,
+            (unsigned long long)stat_get(&mining_stats[i].job_switches));
+    }
+    metrics_describe(out, "phpcoin_miner_aborted_hashes_total", "counter", "Hashes one worker abandoned part-way because a new block arrived.");
+    for (int i = 0; i < started; i++) {
+        metrics_printf(out, "phpcoin_miner_aborted_hashes_total{thread=\"%d\"} %llu\n", mining_stats[i].id,
+            (unsigned long long)stat_get(&mining_stats[i].aborted));
+    }
+    metrics_describe(out, "phpcoin_miner_page_faults_total", "counter", "Page faults taken by one worker.");
+    for (int i = 0; i < started; i++) {
+        metrics_printf(out, "phpcoin_miner_page_faults_total{thread=\"%d\"} %ld\n", mining_stats[i].id,
+            atomic_load_explicit(&mining_stats[i].page_faults, memory_order_relaxed));
+    }
+
+    pthread_mutex_lock(&job_mutex);
+    long height = current_job.height;
+    pthread_mutex_unlock(&job_mutex);
+    metrics_describe(out, "phpcoin_miner_height", "gauge", "Height of the block being mined.");
+    metrics_printf(out, "phpcoin_miner_height %ld\n", height);
+    metrics_describe(out, "phpcoin_miner_threads", "gauge", "Number of worker threads.");
+    metrics_printf(out, "phpcoin_miner_threads %d\n", worker_count());
+    metrics_describe(out, "phpcoin_miner_threads_active", "gauge", "Worker threads not parked by background mode or the autotuner.");
+    metrics_printf(out, "phpcoin_miner_threads_active %d\n", workers_running());
+
+    metrics_describe(out, "phpcoin_miner_submits_total", "counter", "Solutions submitted.");
+    metrics_printf(out, "phpcoin_miner_submits_total %llu\n", (unsigned long long)counter_get(&total_submits));
+    metrics_describe(out, "phpcoin_miner_accepted_total", "counter", "Solutions accepted by a node.");
+    metrics_printf(out, "phpcoin_miner_accepted_total %llu\n", (unsigned long long)counter_get(&total_accepted));
+    metrics_describe(out, "phpcoin_miner_rejected_total", "counter", "Solutions no node accepted.");
+    metrics_printf(out, "phpcoin_miner_rejected_total %llu\n", (unsigned long long)counter_get(&total_rejected));
+    metrics_describe(out, "phpcoin_miner_dropped_total", "counter", "Blocks left without finding a solution.");
+    metrics_printf(out, "phpcoin_miner_dropped_total %llu\n", (unsigned long long)counter_get(&total_dropped));
+    metrics_describe(out, "phpcoin_miner_lost_total", "counter", "Solutions found but never submitted, for lack of memory or room in the queue.");
+    metrics_printf(out, "phpcoin_miner_lost_total %llu\n", (unsigned long long)counter_get(&total_lost));
+
+    if (dup_sampler) {
+        metrics_describe(out, "phpcoin_miner_dup_sampled_total", "counter", "Hashes sampled by --dup-check, one in 64.");
+        metrics_printf(out, "phpcoin_miner_dup_sampled_total %llu\n", (unsigned long long)atomic_load(&dup_sampler->sampled));
+        metrics_describe(out, "phpcoin_miner_dup_found_total", "counter", "Sampled hashes that had been computed before.");
+        metrics_printf(out, "phpcoin_miner_dup_found_total %llu\n", (unsigned long long)atomic_load(&dup_sampler->duplicates));
+    }
+
+    metrics_latency(out, "phpcoin_miner_find_to_ack_seconds",
+        "Time from finding a solution to the first node answering it, over the last 256 solutions.", &ack_latency);
+    metrics_latency(out, "phpcoin_miner_job_switch_seconds",
+        "Time from a new block being published to a worker hashing on it, over the last 256 switches.", &switch_latency);
+}
+
+// Serves the metrics endpoint and samples the hash counters once a second for the rates
+void* metrics_thread(void* arg) {
+    metrics_config_t* config = arg;
+    config->samples = calloc((size_t)(METRICS_RATE_WINDOW + 1) * config->thread_count, sizeof(uint64_t));
+    if (!config->samples) {
+        fprintf(stderr, "Failed to allocate the metrics samples.\n");
+        return NULL;
+    }
+    double next_sample = 0;
+    while (1) {
+        double now = monotonic_seconds();
+        if (now >= next_sample) {
+            int slot = config->sample_count % (METRICS_RATE_WINDOW + 1);
+            for (int i = 0; i < config->thread_count; i++) {
+                config->samples[(size_t)slot * config->thread_count + i] = stat_get(&mining_stats[i].hashes);
+            }
+            config->sample_times[slot] = now;
+            config->sample_count++;
+            next_sample = now + 1;
+        }
+        int wait_ms = (int)((next_sample - now) * 1000);
+        metrics_server_serve(&config->server, wait_ms > 0 ? wait_ms : 0, render_metrics, config);
+    }
+    return NULL;
+}
+
+
+// --- Background Mode ---
+
+// How often the pressure controller looks at the machine
+#define BACKGROUND_SAMPLE_MS 50
+
+// To configure the pressure controller thread
+typedef struct {
+    int thread_count; // Worker slots, started or not
+    bool psi;         // The kernel reports pressure stall information
+} background_config_t;
+
+// Parks and resumes workers so that they only use CPU time nothing else wants. The
+// workers' own runqueue waits tell how much CPU other tasks took from them; the PSI
+// totals, minus the part the workers themselves can account for, tell whether other
+// tasks are stalling on CPU or memory while the workers run.
+void* background_thread(void* arg) {
+    background_config_t* config = arg;
+    int limit = atomic_load(&worker_limit);
+    pressure_controller_t controller = { .workers = limit, .active = limit };
+    uint64_t* last_wait = calloc(config->thread_count, sizeof(uint64_t));
+    if (!last_wait) {
+        fprintf(stderr, "Failed to allocate the pressure controller.\n");
+        return NULL;
+    }
+    uint64_t last_cpu = 0, last_memory = 0;
+    double last_time = monotonic_seconds();
+    bool primed = false;
+
+    while (!atomic_load(&workers_stop)) {
+        usleep(BACKGROUND_SAMPLE_MS * 1000);
+        double now = monotonic_seconds();
+        uint64_t cpu = 0, memory = 0, wait_ns = 0;
+        if (config->psi) {
+            pressure_read("cpu", &cpu);
+            pressure_read("memory", &memory);
+        }
+        for (int i = 0; i < config->thread_count; i++) {
+            uint64_t wait;
+            pid_t pid = atomic_load_explicit(&mining_stats[i].pid, memory_order_relaxed);
+            if (pid == 0 || !pressure_task_wait(pid, &wait)) continue;
+            wait_ns += wait - last_wait[i];
+            last_wait[i] = wait;
+        }
+        double interval_us = (now - last_time) * 1e6;
+        // The control socket may have changed the number of workers
+        limit = atomic_load(&worker_limit);
+        if (limit != controller.workers) {
+            controller.workers = limit;
+            if (controller.active > limit) controller.active = limit;
+        }
+        if (primed && interval_us > 0) {
+            // A worker waiting on a runqueue is a stall too, so at most that much of the
+            // "some" time can be the workers' own doing
+            double wait_us = wait_ns / 1000.0;
+            double cpu_us = cpu - last_cpu;
+            double foreign_cpu = cpu_us > wait_us ? cpu_us - wait_us : 0;
+            double foreign_pct = 100 * fmax(foreign_cpu, memory - last_memory) / interval_us;
+            int previous = controller.active;
+            int active = pressure_controller_update(&controller, foreign_pct, wait_us / interval_us, (int)(interval_us / 1000));
+            if (active != previous) {
+                atomic_store(&workers_active, active);
+                if (active > previous) unpark_workers();
+            }
+        }
+        primed = true;
+        last_cpu = cpu;
+        last_memory = memory;
+        last_time = now;
+    }
+    free(last_wait);
+    return NULL;
+}
+
+
+
+// --- Adaptive Concurrency ---
+
+// To configure the autotuner thread
+typedef struct {
+    int thread_count;       // Worker slots, all started
+    const char* state_path; // Where the best setting is saved
+    autotune_t tuner;
+} autotune_config_t;
+
+// Sleeps for `ms`, or less if the miner stops. Returns false if it did.
+static bool autotune_wait(int ms) {
+    for (int slept = 0; slept < ms && !atomic_load(&workers_stop); slept += 100) {
+        usleep(100 * 1000);
+    }
+    return !atomic_load(&workers_stop);
+}
+
+static void autotune_log(const char* note) {
+    pthread_mutex_lock(&console_mutex);
+    printf("\nAutotune: %s\n", note);
+    pthread_mutex_unlock(&console_mutex);
+    atomic_store(&report_interrupted, true);
+}
+
+// Hill-climbs the number of running workers on the total hash rate, one window at a time
+void* autotune_thread(void* arg) {
+    autotune_config_t* config = arg;
+    autotune_t* tuner = &config->tuner;
+    char note[256];
+
+    while (autotune_wait(AUTOTUNE_SETTLE_MS)) {
+        uint64_t start_hashes = 0;
+        for (int i = 0; i < config->thread_count; i++) start_hashes += stat_get(&mining_stats[i].hashes);
+        double start = monotonic_seconds();
+        if (!autotune_wait(AUTOTUNE_WINDOW_MS)) break;
+        uint64_t hashes = 0;
+        for (int i = 0; i < config->thread_count; i++) hashes += stat_get(&mining_stats[i].hashes);
+        double window_s = monotonic_seconds() - start;
+
+        // The control socket may have changed the number of workers
+        int workers = worker_count();
+        if (workers != tuner->workers) {
+            autotune_set_workers(tuner, workers);
+            snprintf(note, sizeof(note), "up to %d workers now, starting over from %d", workers, tuner->active);
+            autotune_log(note);
+        } else if (hashes == start_hashes) {
+            continue; // No job to mine, so nothing was measured
+        } else {
+            bool was_holding = tuner->phase == AUTOTUNE_HOLDING;
+            autotune_update(tuner, (hashes - start_hashes) / window_s, window_s, note, sizeof(note));
+            if (note[0]) autotune_log(note);
+            if (tuner->phase == AUTOTUNE_HOLDING && !was_holding && config->state_path
+                && !autotune_save(config->state_path, tuner->active, tuner->base_rate)) {
+                snprintf(note, sizeof(note), "cannot save the setting to %s", config->state_path);
+                autotune_log(note);
             }
-            mpz_clear(temp_difficulty);
         }
+
+        int previous = atomic_load(&workers_active);
+        if (tuner->active != previous) {
+            atomic_store(&workers_active, tuner->active);
+            if (tuner->active > previous) unpark_workers();
+        }
+    }
+    return NULL;
+}
+
+
+// --- Event Trace ---
+
+// Moves the recorded events to the trace file until the workers stop; main drains the
+// rest once they have
+void* trace_thread(void* arg) {
+    trace_writer_t* writer = arg;
+    while (!atomic_load(&workers_stop)) {
+        if (trace_writer_drain(writer) < 0) {
+            pthread_mutex_lock(&console_mutex);
+            fprintf(stderr, "\nCannot write the trace to %s, tracing stopped.\n", writer->path);
+            pthread_mutex_unlock(&console_mutex);
+            atomic_store(&report_interrupted, true);
+            break; // The rings fill up and drop events from here on
+        }
+        usleep(TRACE_DRAIN_MS * 1000);
+    }
+    return NULL;
+}
+
+
+
+// --- Control Socket ---
+
+// The settings the control socket changes while the miner runs, and what it needs to
+// apply them
+typedef struct {
+    control_server_t server;
+    worker_pool_t* workers;
+    node_pool_t* pool;
+    health_config_t* health_config;
+    bool health_running; // The health checks start once there is more than one node
+    pthread_t health;
+    char* address;
+    bool background;
+    atomic_int cpu_usage;
+    atomic_int lanes;
+    atomic_int report_interval;
+    time_t started;
+} control_config_t;
+
+// Parses a whole decimal number in [min, max]
+static bool parse_setting(const char* value, int min, int max, int* result) {
+    char* end;
+    long number = value ? strtol(value, &end, 10) : 0;
+    if (!value || *value == '\0' || *end != '\0' || number < min || number > max) return false;
+    *result = (int)number;
+    return true;
+}
+
+static void control_stats(control_config_t* config, control_reply_t* reply) {
+    pthread_mutex_lock(&job_mutex);
+    long height = current_job.height;
+    pthread_mutex_unlock(&job_mutex);
+    int started = atomic_load(&workers_started);
+    uint64_t hashes = 0, aborted = 0;
+    for (int i = 0; i < started; i++) {
+        hashes += stat_get(&mining_stats[i].hashes);
+        aborted += stat_get(&mining_stats[i].aborted);
+    }
+
+    control_printf(reply, "ok\n");
+    control_printf(reply, "uptime %ld\n", (long)(time(NULL) - config->started));
+    control_printf(reply, "threads %d\n", worker_count());
+    control_printf(reply, "active %d\n", workers_running());
+    control_printf(reply, "max-threads %d\n", config->workers->capacity);
+    control_printf(reply, "cpu %d\n", atomic_load(&config->cpu_usage));
+    control_printf(reply, "lanes %d\n", atomic_load(&config->lanes));
+    control_printf(reply, "report-interval %d\n", atomic_load(&config->report_interval));
+    control_printf(reply, "height %ld\n", height);
+    control_printf(reply, "hashes %llu\n", (unsigned long long)hashes);
+    control_printf(reply, "aborted %llu\n", (unsigned long long)aborted);
+    if (dup_sampler) {
+        control_printf(reply, "dup-sampled %llu\n", (unsigned long long)atomic_load(&dup_sampler->sampled));
+        control_printf(reply, "dup-found %llu\n", (unsigned long long)atomic_load(&dup_sampler->duplicates));
+    }
+    control_printf(reply, "submits %llu\n", (unsigned long long)counter_get(&total_submits));
+    control_printf(reply, "accepted %llu\n", (unsigned long long)counter_get(&total_accepted));
+    control_printf(reply, "rejected %llu\n", (unsigned long long)counter_get(&total_rejected));
+    control_printf(reply, "dropped %llu\n", (unsigned long long)counter_get(&total_dropped));
+    control_printf(reply, "lost %llu\n", (unsigned long long)counter_get(&total_lost));
+
+    node_pool_t* pool = config->pool;
+    char selected[256];
+    int selected_index = node_pool_selected(pool, selected, sizeof(selected));
+    pthread_mutex_lock(&pool->mutex);
+    for (int i = 0; i < node_pool_count(pool); i++) {
+        const node_entry_t* node = &pool->nodes[i];
+        control_printf(reply, "node %s %s height %ld latency-ms %.1f\n", node->url,
+            i == selected_index ? "selected" : node->disabled ? "disabled" : node->healthy ? "healthy" : "down",
+            node->height, node->latency_ms);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (int i = 0; i < started; i++) {
+        control_printf(reply, "thread %d hashes %llu best %llu %s\n", mining_stats[i].id,
+            (unsigned long long)stat_get(&mining_stats[i].hashes),
+            (unsigned long long)stat_get(&mining_stats[i].best_hit),
+            worker_parked(mining_stats[i].id) ? "parked" : "running");
+    }
+}
+
+// Mines against the comma-separated `list` of nodes from now on: new ones join the pool,
+// the others are disabled, and the first one is polled right away
+static void control_set_nodes(control_config_t* config, char* list, control_reply_t* reply) {
+    node_pool_t* pool = config->pool;
+    bool listed[NODE_POOL_MAX] = { false };
+    int first = -1;
+    char* save;
+    for (char* next = strtok_r(list, ",", &save); next; next = strtok_r(NULL, ",", &save)) {
+        trim(next);
+        if (*next == '\0') continue;
+        int index = node_pool_add(pool, next);
+        if (index < 0) {
+            control_printf(reply, "error: cannot add node %s, the node list is full\n", next);
+            return;
+        }
+        listed[index] = true;
+        if (first < 0) first = index;
+    }
+    if (first < 0) {
+        control_printf(reply, "error: no nodes given\n");
+        return;
+    }
+    for (int i = 0; i < node_pool_count(pool); i++) {
+        node_pool_set_disabled(pool, i, !listed[i]);
+    }
+    node_pool_prefer(pool, first);
+    if (!config->health_running && node_pool_count(pool) > 1) {
+        pthread_create(&config->health, NULL, health_thread, config->health_config);
+        config->health_running = true;
+    }
+    char url[256];
+    node_pool_url(pool, first, url, sizeof(url));
+    control_printf(reply, "ok\nnode %s\n", url);
+}
+
+// Answers one command from the control socket
+static void handle_control(char* command, control_reply_t* reply, void* arg) {
+    control_config_t* config = arg;
+    char* save;
+    char* verb = strtok_r(command, " \t", &save);
+    char* key = verb ? strtok_r(NULL, " \t", &save) : NULL;
+    char* value = key ? strtok_r(NULL, " \t", &save) : NULL;
+    int number;
+
+    if (!verb) {
+        control_printf(reply, "error: empty command\n");
+    } else if (strcmp(verb, "stats") == 0) {
+        control_stats(config, reply);
+        return;
+    } else if (strcmp(verb, "set") != 0 || !key) {
+        control_printf(reply, "error: unknown command '%s'\n", verb);
+    } else if (strcmp(key, "threads") == 0) {
+        if (!parse_setting(value, 1, config->workers->capacity, &number)) {
+            control_printf(reply, "error: threads must be between 1 and %d (--max-threads)\n", config->workers->capacity);
+            return;
+        }
+        // Extra workers are parked rather than stopped, keeping their arenas warm
+        worker_pool_start(config->workers, number, config->address, atomic_load(&config->cpu_usage),
+            config->background, atomic_load(&config->lanes));
+        atomic_store(&worker_limit, number);
+        unpark_workers();
+        control_printf(reply, "ok\nthreads %d\n", number);
+    } else if (strcmp(key, "cpu") == 0) {
+        if (!parse_setting(value, 1, 100, &number)) {
+            control_printf(reply, "error: cpu must be between 1 and 100\n");
+            return;
+        }
+        atomic_store(&config->cpu_usage, number);
+        for (int i = 0; i < atomic_load(&workers_started); i++) {
+            atomic_store(&config->workers->data[i].cpu_usage, number);
+        }
+        control_printf(reply, "ok\ncpu %d\n", number);
+    } else if (strcmp(key, "lanes") == 0) {
+        if (!parse_setting(value, 1, ARGON2_MAX_INTERLEAVE, &number)) {
+            control_printf(reply, "error: lanes must be between 1 and %d\n", ARGON2_MAX_INTERLEAVE);
+            return;
+        }
+        // Each worker maps a bigger arena itself if it needs one
+        atomic_store(&config->lanes, number);
+        for (int i = 0; i < atomic_load(&workers_started); i++) {
+            atomic_store(&config->workers->data[i].lanes, number);
+        }
+        control_printf(reply, "ok\nlanes %d\n", number);
+    } else if (strcmp(key, "report-interval") == 0) {
+        if (!parse_setting(value, 1, INT_MAX, &number)) {
+            control_printf(reply, "error: report-interval must be at least 1\n");
+            return;
+        }
+        atomic_store(&config->report_interval, number);
+        control_printf(reply, "ok\nreport-interval %d\n", number);
+    } else if (strcmp(key, "nodes") == 0) {
+        if (!value) {
+            control_printf(reply, "error: no nodes given\n");
+            return;
+        }
+        control_set_nodes(config, value, reply);
+    } else {
+        control_printf(reply, "error: unknown setting '%s'\n", key);
+    }
+
+    if (strncmp(reply->data, "ok", 2) == 0) {
+        pthread_mutex_lock(&console_mutex);
+        printf("\nControl: %s changed.\n", key);
+        pthread_mutex_unlock(&console_mutex);
+        atomic_store(&report_interrupted, true);
+    }
+}
+
+// Serves the control socket until the miner exits
+void* control_thread(void* arg) {
+    control_config_t* config = arg;
+    while (!atomic_load(&exit_requested)) {
+        control_server_serve(&config->server, 200, handle_control, config);
     }
-    mpz_clears(hit, target, NULL);
-    free(data); // Free the thread-specific data
     return NULL;
 }
 
+// --- Benchmark ---
+
+// The synthetic job mined by --benchmark. No hit can reach a difficulty this large, so the
+// workers never stop to submit, and the block date is far enough back that the target is
+// never zero. The job is published as winnable from the start, so the workers hash it
+// instead of sleeping until the target comes within reach.
+#define BENCH_HEIGHT 1000000
+#define BENCH_DIFFICULTY "1000000000000000000"
+#define BENCH_BLOCK_AGE 30
+#define BENCH_ADDRESS "Pbenchmark000000000000000000000000"
+// Most thread counts in one sweep
+#define BENCH_MAX_RUNS 32
+// The aggregate hash rate is sampled this often to measure how steady it is
+#define BENCH_SAMPLE_MS 500
+
+typedef struct {
+    int threads;
+    double seconds;
+    uint64_t hashes;
+    double hashrate;      // Aggregate H/s
+    double* per_thread;   // H/s of each worker
+    double thread_min, thread_mean, thread_max;
+    double thread_cv;     // Spread between workers, stddev / mean in percent
+    double time_cv;       // Spread of the aggregate rate between samples, in percent
+    long rss_bytes;       // Resident set size of the process while mining
+    double hashrate_per_gib;
+    double huge_pct;      // Share of the Argon2 memory that got huge pages
+} bench_result_t;
+
+// Resident set size of the process, or 0 if it cannot be read
+static long resident_bytes(void) {
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    long size = 0, resident = 0;
+    if (fscanf(file, "%ld %ld", &size, &resident) != 2) resident = 0;
+    fclose(file);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static double seconds_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Sum of the hashes counted by `count` workers
+static uint64_t sum_hashes(thread_stats_t* stats, int count) {
+    uint64_t sum = 0;
+    for (int i = 0; i < count; i++) sum += stat_get(&stats[i].hashes);
+    return sum;
+}
+
+// Mines the published job with `threads` fresh workers until `duration` seconds have passed
+// or `hash_limit` hashes were done, whichever is set and comes first.
+static int run_benchmark(int threads, char* address, int cpu_usage, int lanes, double duration, uint64_t hash_limit, bench_result_t* result) {
+    argon2_arena_t* arenas = calloc(threads, sizeof(argon2_arena_t));
+    thread_stats_t* stats = thread_stats_alloc(threads);
+    thread_data_t* data = calloc(threads, sizeof(thread_data_t));
+    pthread_t* workers = malloc(sizeof(pthread_t) * threads);
+    uint64_t* start_hashes = malloc(sizeof(uint64_t) * threads);
+    phase_profile_t* profiles = calloc(threads, sizeof(phase_profile_t));
+    result->per_thread = malloc(sizeof(double) * threads);
+    if (!arenas || !stats || !data || !workers || !start_hashes || !profiles || !result->per_thread) {
+        free(arenas); free(stats); free(data); free(workers); free(start_hashes); free(profiles); free(result->per_thread);
+        result->per_thread = NULL;
+        return 0;
+    }
+
+    atomic_store(&workers_stop, false);
+    for (int i = 0; i < threads; i++) {
+        if (!argon2_arena_init(&arenas[i], lanes * ARGON2_ARENA_SIZE)) {
+            fprintf(stderr, "Warning: thread %d will allocate Argon2 memory per hash.\n", i + 1);
+        }
+        stats[i].id = i + 1;
+        data[i].thread_id = i + 1;
+        data[i].address = address;
+        data[i].cpu_usage = cpu_usage;
+        data[i].stats = &stats[i];
+        data[i].arena = arenas[i].base ? &arenas[i] : NULL;
+        data[i].lanes = lanes;
+        data[i].profile = &profiles[i];
+        data[i].nonce_base = nonce_stream_base(nonce_worker_id, nonce_instance, i);
+        start_worker(&workers[i], &data[i], i);
+    }
+
+    // Start the clock once every worker has faulted in its arena and finished a batch
+    bool warm = false;
+    while (!warm) {
+        usleep(10000);
+        warm = true;
+        for (int i = 0; i < threads; i++) {
+            if (stat_get(&stats[i].hashes) == 0) warm = false;
+        }
+    }
+    for (int i = 0; i < threads; i++) start_hashes[i] = stat_get(&stats[i].hashes);
+    arena_report_t report;
+    arena_report(arenas, threads, &report);
+    result->huge_pct = arena_huge_percent(&report);
+    uint64_t start_total = sum_hashes(stats, threads);
+
+    struct timespec start, sample_start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    sample_start = start;
+    uint64_t sample_total = start_total;
+    // Running mean and variance of the sampled aggregate rate (Welford)
+    long samples = 0;
+    double sample_mean = 0, sample_m2 = 0;
+
+    while (1) {
+        usleep(BENCH_SAMPLE_MS * 1000 / 10);
+        uint64_t total = sum_hashes(stats, threads);
+        double sample_seconds = seconds_since(&sample_start);
+        if (sample_seconds * 1000 >= BENCH_SAMPLE_MS) {
+            double rate = (total - sample_total) / sample_seconds;
+            samples++;
+            double delta = rate - sample_mean;
+            sample_mean += delta / samples;
+            sample_m2 += delta * (rate - sample_mean);
+            clock_gettime(CLOCK_MONOTONIC, &sample_start);
+            sample_total = total;
+        }
+        if (duration > 0 && seconds_since(&start) >= duration) break;
+        if (hash_limit > 0 && total - start_total >= hash_limit) break;
+    }
+
+    result->rss_bytes = resident_bytes();
+    result->seconds = seconds_since(&start);
+    for (int i = 0; i < threads; i++) {
+        result->per_thread[i] = (stat_get(&stats[i].hashes) - start_hashes[i]) / result->seconds;
+    }
+    result->hashes = sum_hashes(stats, threads) - start_total;
+
+    atomic_store(&workers_stop, true);
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+        argon2_arena_destroy(&arenas[i]);
+    }
+    if (profile_enabled) {
+        profile_dump(stderr, profiles, threads);
+    }
+
+    result->threads = threads;
+    result->hashrate = result->hashes / result->seconds;
+    result->thread_min = result->thread_max = result->per_thread[0];
+    double sum = 0, sum_sq = 0;
+    for (int i = 0; i < threads; i++) {
+        double rate = result->per_thread[i];
+        if (rate < result->thread_min) result->thread_min = rate;
+        if (rate > result->thread_max) result->thread_max = rate;
+        sum += rate;
+        sum_sq += rate * rate;
+    }
+    result->thread_mean = sum / threads;
+    double thread_var = sum_sq / threads - result->thread_mean * result->thread_mean;
+    result->thread_cv = result->thread_mean > 0 && thread_var > 0 ? 100 * sqrt(thread_var) / result->thread_mean : 0;
+    result->time_cv = samples > 1 && sample_mean > 0 ? 100 * sqrt(sample_m2 / (samples - 1)) / sample_mean : 0;
+    result->hashrate_per_gib = result->rss_bytes > 0 ? result->hashrate / (result->rss_bytes / (1024.0 * 1024 * 1024)) : 0;
+
+    free(arenas);
+    free(stats);
+    free(data);
+    free(workers);
+    free(start_hashes);
+    free(profiles);
+    return 1;
+}
+
+static void print_benchmark_json(FILE* out, bench_result_t* results, int count, int cpu_usage, int lanes, const char* hugepages, double duration, uint64_t hash_limit) {
+    char host[128] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    fprintf(out, "{\"host\":\"%s\",\"cpus\":%ld,\"compiler\":\"%s\",\"kernel\":\"%s\",\"sha256\":\"%s\","
+        "\"lanes\":%d,\"hugepages\":\"%s\",\"cpu\":%d,\"height\":%d,\"difficulty\":\"%s\",\"duration_s\":%.3f,\"hash_limit\":%llu,\"runs\":[",
+        host, sysconf(_SC_NPROCESSORS_ONLN), __VERSION__, argon2_kernel_name(argon2_kernel_active()), sha256_impl_name(),
+        lanes, hugepages, cpu_usage, BENCH_HEIGHT, BENCH_DIFFICULTY, duration, (unsigned long long)hash_limit);
+    for (int r = 0; r < count; r++) {
+        bench_result_t* result = &results[r];
+        fprintf(out, "%s{\"threads\":%d,\"seconds\":%.3f,\"hashes\":%llu,\"hashrate\":%.3f,\"per_thread\":[",
+            r ? "," : "", result->threads, result->seconds, (unsigned long long)result->hashes, result->hashrate);
+        for (int i = 0; i < result->threads; i++) {
+            fprintf(out, "%s%.3f", i ? "," : "", result->per_thread[i]);
+        }
+        fprintf(out, "],\"thread_cv_pct\":%.2f,\"time_cv_pct\":%.2f,\"rss_bytes\":%ld,\"hashrate_per_gib\":%.3f,\"huge_pages_pct\":%.1f}",
+            result->thread_cv, result->time_cv, result->rss_bytes, result->hashrate_per_gib, result->huge_pct);
+    }
+    fprintf(out, "]}\n");
+}
+
+// Runs the miner offline against the synthetic job for each thread count in `thread_list`
+// (comma-separated; by default powers of two up to the number of CPUs), prints a table and
+// writes the results as JSON to `json_path`, or to stdout without one.
+int benchmark_main(char* address, int cpu_usage, int lanes, const char* hugepages, double duration, uint64_t hash_limit, char* thread_list, const char* json_path) {
+    int thread_counts[BENCH_MAX_RUNS];
+    int runs = 0;
+    if (thread_list) {
+        for (char* next = strtok(thread_list, ","); next && runs < BENCH_MAX_RUNS; next = strtok(NULL, ",")) {
+            int threads = atoi(next);
+            if (threads > 0) thread_counts[runs++] = threads;
+        }
+    } else {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        if (cpus < 1) cpus = 1;
+        for (int threads = 1; threads < cpus && runs < BENCH_MAX_RUNS - 1; threads *= 2) thread_counts[runs++] = threads;
+        thread_counts[runs++] = cpus;
+    }
+    if (runs == 0) {
+        fprintf(stderr, "No valid thread counts in '%s'.\n", thread_list);
+        return EXIT_FAILURE;
+    }
+    if (duration <= 0 && hash_limit == 0) duration = 10;
+
+    // One synthetic job for the whole sweep
+    mpz_init(current_job.difficulty);
+    mpz_t difficulty;
+    mpz_init_set_str(difficulty, BENCH_DIFFICULTY, 10);
+    publish_job(-1, true, BENCH_HEIGHT, time(NULL) - BENCH_BLOCK_AGE, "benchmark", difficulty);
+    mpz_clear(difficulty);
+    pthread_mutex_lock(&job_mutex);
+    current_job.first_elapsed = 1; // No worker has copied the job yet
+    pthread_mutex_unlock(&job_mutex);
+
+    printf("Benchmarking address %s\nHeight: %d\nDifficulty: %s\nCPU: %d%%\nKernel: %s\nSHA-256: %s\nLanes: %d (%zu MiB Argon2 memory per thread)\nHuge Pages: %s\n",
+        address, BENCH_HEIGHT, BENCH_DIFFICULTY, cpu_usage, argon2_kernel_name(argon2_kernel_active()), sha256_impl_name(),
+        lanes, lanes * ARGON2_ARENA_SIZE / (1024 * 1024), hugepages);
+    if (hash_limit > 0) {
+        printf("Each run: %llu hashes%s\n", (unsigned long long)hash_limit, duration > 0 ? " or the duration limit" : "");
+    }
+    if (duration > 0) {
+        printf("Each run: %.1f s\n", duration);
+    }
+    printf("---------------------------------------------------\n");
+    printf("%-7s %-10s %-10s %-10s %-10s %-9s %-9s %-8s %-8s %-6s\n",
+        "Threads", "Total H/s", "Min H/s", "Mean H/s", "Max H/s", "Thread CV", "Time CV", "RSS MiB", "H/s/GiB", "Huge");
+    fflush(stdout);
+
+    bench_result_t results[BENCH_MAX_RUNS];
+    int done = 0;
+    for (int r = 0; r < runs; r++) {
+        bench_result_t* result = &results[done];
+        if (!run_benchmark(thread_counts[r], address, cpu_usage, lanes, duration, hash_limit, result)) {
+            fprintf(stderr, "Not enough memory for %d threads.\n", thread_counts[r]);
+            break;
+        }
+        done++;
+        char thread_cv_str[16], time_cv_str[16], huge_str[16];
+        snprintf(thread_cv_str, sizeof(thread_cv_str), "%.1f%%", result->thread_cv);
+        snprintf(time_cv_str, sizeof(time_cv_str), "%.1f%%", result->time_cv);
+        snprintf(huge_str, sizeof(huge_str), "%.0f%%", result->huge_pct);
+        printf("%-7d %-10.2f %-10.2f %-10.2f %-10.2f %-9s %-9s %-8.1f %-8.2f %-6s\n",
+            result->threads, result->hashrate, result->thread_min, result->thread_mean, result->thread_max,
+            thread_cv_str, time_cv_str, result->rss_bytes / (1024.0 * 1024), result->hashrate_per_gib, huge_str);
+        fflush(stdout);
+    }
+
+    FILE* out = stdout;
+    if (json_path) {
+        out = fopen(json_path, "w");
+        if (!out) {
+            perror("Failed to open the benchmark JSON file");
+            out = stdout;
+        }
+    }
+    print_benchmark_json(out, results, done, cpu_usage, lanes, hugepages, duration, hash_limit);
+    if (out != stdout) {
+        fclose(out);
+        printf("Results written to %s\n", json_path);
+    }
+
+    for (int r = 0; r < done; r++) free(results[r].per_thread);
+    mpz_clear(current_job.difficulty);
+    return done == runs ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 // --- Main Function ---
 
+static void request_exit(int sig) {
+    atomic_store(&exit_requested, true);
+    signal(sig, SIG_DFL);
+}
+
+static void request_profile_dump(int sig) {
+    (void)sig;
+    atomic_store(&profile_dump_requested, true);
+}
+
 void print_usage(const char* prog_name) {
-    fprintf(stderr, "Usage: %s --node <node_url> --address <address> [--threads <threads>] [--cpu <cpu>] [--report-interval <interval>] [--flat-log]\n", prog_name);
+    fprintf(stderr, "Usage: %s --node <node_url[,node_url...]> --address <address> [--threads <threads|auto>] [--affinity <none|cores|smt>] [--cpu <cpu>] [--report-interval <interval>] [--kernel <auto|libargon2|portable|sse2|avx2|avx512>] [--lanes <1-4>] [--poll-interval <ms>] [--submit-nodes <url,url,...>] [--discover-peers] [--flat-log] [--metrics-port <port>] [--profile] [--hugepages <hugetlb|thp|off>] [--background] [--control <socket>] [--max-threads <threads>] [--worker-id <0-65535>] [--instance <0-15>] [--dup-check] [--autotune] [--autotune-state <file>] [--trace <file>] [--trace-size <MiB>]\n", prog_name);
+    fprintf(stderr, "       %s --benchmark [--bench-threads <n,n,...>] [--bench-duration <seconds>] [--bench-hashes <count>] [--bench-json <file>] [--profile] [--affinity <none|cores|smt>] [--hugepages <hugetlb|thp|off>] [--address <address>] [--cpu <cpu>] [--kernel <kernel>] [--lanes <1-4>]\n", prog_name);
 }
 
 int main(int argc, char** argv) {
     // --- Configurable parameters ---
     // 1. Set hardcoded defaults
-    char* node = NULL;
-    char* address = NULL;
-    int num_threads = 4;
-    int cpu_usage = 100;
-    int report_interval = 30;
-    bool flat_log = false;
+    miner_options_t options = {
+        .num_threads = 4,
+        .cpu_usage = 100,
+        .report_interval = 30,
+        .lanes = 1,
+        .poll_interval_ms = 1000,
+        .worker_id = NONCE_AUTO,
+        .instance = NONCE_AUTO,
+        .trace_size = 64,
+    };
     int opt;
 
     // 2. Load from miner.conf, overriding defaults
-    parse_config("miner.conf", &node, &address, &num_threads, &cpu_usage, &report_interval);
-    char* conf_node_ptr = node; // Keep track of pointers from config to free them later if needed
-    char* conf_address_ptr = address;
+    parse_config("miner.conf", &options);
+    miner_options_t conf = options; // Keep track of pointers from config to free them later if needed
 
 
     // 3. Parse command-line arguments, overriding both defaults and config file values
@@ -396,32 +1960,108 @@ int main(int argc, char** argv) {
         {"threads", required_argument, 0, 't'},
         {"cpu", required_argument, 0, 'c'},
         {"report-interval", required_argument, 0, 'i'},
+        {"kernel", required_argument, 0, 'k'},
+        {"lanes", required_argument, 0, 'l'},
+        {"poll-interval", required_argument, 0, 'p'},
+        {"submit-nodes", required_argument, 0, 's'},
+        {"discover-peers", no_argument, 0, 0},
         {"flat-log", no_argument, 0, 0},
+        {"metrics-port", required_argument, 0, 0},
+        {"profile", no_argument, 0, 0},
+        {"affinity", required_argument, 0, 0},
+        {"hugepages", required_argument, 0, 0},
+        {"background", no_argument, 0, 0},
+        {"control", required_argument, 0, 0},
+        {"max-threads", required_argument, 0, 0},
+        {"worker-id", required_argument, 0, 0},
+        {"instance", required_argument, 0, 0},
+        {"dup-check", no_argument, 0, 0},
+        {"autotune", no_argument, 0, 0},
+        {"autotune-state", required_argument, 0, 0},
+        {"trace", required_argument, 0, 0},
+        {"trace-size", required_argument, 0, 0},
+        {"benchmark", no_argument, 0, 0},
+        {"bench-threads", required_argument, 0, 0},
+        {"bench-duration", required_argument, 0, 0},
+        {"bench-hashes", required_argument, 0, 0},
+        {"bench-json", required_argument, 0, 0},
         {0, 0, 0, 0}
     };
 
     int option_index = 0;
-    while ((opt = getopt_long(argc, argv, "n:a:t:c:i:", long_options, &option_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "n:a:t:c:i:k:l:p:s:", long_options, &option_index)) != -1) {
         switch (opt) {
             case 0:
                 if (strcmp(long_options[option_index].name, "flat-log") == 0) {
-                    flat_log = true;
+                    options.flat_log = true;
+                } else if (strcmp(long_options[option_index].name, "discover-peers") == 0) {
+                    options.discover = true;
+                } else if (strcmp(long_options[option_index].name, "profile") == 0) {
+                    options.profile = true;
+                } else if (strcmp(long_options[option_index].name, "background") == 0) {
+                    options.background = true;
+                } else if (strcmp(long_options[option_index].name, "control") == 0) {
+                    options.control_path = optarg;
+                } else if (strcmp(long_options[option_index].name, "max-threads") == 0) {
+                    options.max_threads = atoi(optarg);
+                } else if (strcmp(long_options[option_index].name, "worker-id") == 0) {
+                    options.worker_id = atoi(optarg);
+                } else if (strcmp(long_options[option_index].name, "instance") == 0) {
+                    options.instance = atoi(optarg);
+                } else if (strcmp(long_options[option_index].name, "dup-check") == 0) {
+                    options.dup_check = true;
+                } else if (strcmp(long_options[option_index].name, "autotune") == 0) {
+                    options.autotune = true;
+                } else if (strcmp(long_options[option_index].name, "autotune-state") == 0) {
+                    options.autotune_state = optarg;
+                } else if (strcmp(long_options[option_index].name, "trace") == 0) {
+                    options.trace_path = optarg;
+                } else if (strcmp(long_options[option_index].name, "trace-size") == 0) {
+                    options.trace_size = atoi(optarg);
+                } else if (strcmp(long_options[option_index].name, "affinity") == 0) {
+                    options.affinity = optarg;
+                } else if (strcmp(long_options[option_index].name, "hugepages") == 0) {
+                    options.hugepages = optarg;
+                } else if (strcmp(long_options[option_index].name, "metrics-port") == 0) {
+                    options.metrics_port = atoi(optarg);
+                } else if (strcmp(long_options[option_index].name, "benchmark") == 0) {
+                    options.benchmark = true;
+                } else if (strcmp(long_options[option_index].name, "bench-threads") == 0) {
+                    options.bench_threads = optarg;
+                } else if (strcmp(long_options[option_index].name, "bench-duration") == 0) {
+                    options.bench_duration = atof(optarg);
+                } else if (strcmp(long_options[option_index].name, "bench-hashes") == 0) {
+                    options.bench_hashes = strtoull(optarg, NULL, 10);
+                } else if (strcmp(long_options[option_index].name, "bench-json") == 0) {
+                    options.bench_json = optarg;
                 }
                 break;
             case 'n':
-                node = optarg;
+                options.node = optarg;
                 break;
             case 'a':
-                address = optarg;
+                options.address = optarg;
                 break;
             case 't':
-                num_threads = atoi(optarg);
+                options.num_threads = strcmp(optarg, "auto") == 0 ? THREADS_AUTO : atoi(optarg);
                 break;
             case 'c':
-                cpu_usage = atoi(optarg);
+                options.cpu_usage = atoi(optarg);
                 break;
             case 'i':
-                report_interval = atoi(optarg);
+                options.report_interval = atoi(optarg);
+                break;
+            case 'k':
+                options.kernel_name = optarg;
+                break;
+            case 'l':
+                options.lanes = atoi(optarg);
+                break;
+            case 'p':
+                options.poll_interval_ms = atoi(optarg);
+                break;
+            case 's':
+                options.submit_nodes = optarg;
                 break;
             default:
                 print_usage(argv[0]);
@@ -430,154 +2070,497 @@ int main(int argc, char** argv) {
     }
 
     // Free memory from config file if overridden by command line
-    if (node != conf_node_ptr) {
-        free(conf_node_ptr);
+    if (options.node != conf.node) {
+        free(conf.node);
+    }
+    if (options.address != conf.address) {
+        free(conf.address);
+    }
+    if (options.kernel_name != conf.kernel_name) {
+        free(conf.kernel_name);
+    }
+    if (options.submit_nodes != conf.submit_nodes) {
+        free(conf.submit_nodes);
     }
-    if (address != conf_address_ptr) {
-        free(conf_address_ptr);
+    if (options.affinity != conf.affinity) {
+        free(conf.affinity);
+    }
+    if (options.hugepages != conf.hugepages) {
+        free(conf.hugepages);
+    }
+    if (options.control_path != conf.control_path) {
+        free(conf.control_path);
+    }
+    if (options.autotune_state != conf.autotune_state) {
+        free(conf.autotune_state);
+    }
+    if (!options.autotune_state) options.autotune_state = "autotune.state";
+    if (options.trace_path != conf.trace_path) {
+        free(conf.trace_path);
     }
 
-    if (!node || !address) {
+    if (!options.benchmark && (!options.node || !options.address)) {
         print_usage(argv[0]);
         exit(EXIT_FAILURE);
     }
 
-    if (num_threads <= 0) num_threads = 1;
-    if (cpu_usage <=0 || cpu_usage > 100) cpu_usage = 100;
-    if (report_interval <= 0) report_interval = 1;
+    if (options.lanes <= 0) options.lanes = 1;
+    if (options.lanes > ARGON2_MAX_INTERLEAVE) options.lanes = ARGON2_MAX_INTERLEAVE;
 
+    // Worker count and placement from the CPU and cache topology
+    bool pin_smt = options.affinity && strcmp(options.affinity, "smt") == 0;
+    if (options.affinity && strcmp(options.affinity, "none") != 0 && strcmp(options.affinity, "cores") != 0 && !pin_smt) {
+        fprintf(stderr, "Unknown affinity '%s'.\n", options.affinity);
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    bool pin = options.affinity && strcmp(options.affinity, "none") != 0;
+    if (pin || options.num_threads == THREADS_AUTO) {
+        static topology_t topology;
+        if (!topology_read(&topology)) {
+            fprintf(stderr, "Warning: no CPU topology in sysfs, treating every CPU as a core.\n");
+        }
+        printf("Topology: %d package(s), %d cores, %d CPUs, %d L3 cache(s)", topology.package_count,
+            topology.core_count, topology.cpu_count, topology.l3_count);
+        if (topology.l3_size > 0) printf(" of %zu MiB", topology.l3_size / (1024 * 1024));
+        printf("\n");
+        if (options.num_threads == THREADS_AUTO) {
+            options.num_threads = topology_auto_threads(&topology, pin_smt, options.lanes * ARGON2_ARENA_SIZE);
+        }
+        if (pin) {
+            worker_cpus = malloc(sizeof(int) * topology.cpu_count);
+            worker_cpu_count = worker_cpus ? topology_placement(&topology, pin_smt, worker_cpus, topology.cpu_count) : 0;
+            printf("Placement:");
+            for (int i = 0; i < options.num_threads && worker_cpu_count > 0; i++) {
+                printf(" %d->CPU%d", i + 1, worker_cpus[i % worker_cpu_count]);
+            }
+            printf("\n");
+            if (options.num_threads > worker_cpu_count) {
+                fprintf(stderr, "Warning: %d workers share %d %s.\n", options.num_threads, worker_cpu_count, pin_smt ? "CPUs" : "cores");
+            }
+        }
+    }
 
-    long height, block_date;
-    mpz_t difficulty;
-    mpz_init(difficulty);
+    if (options.num_threads <= 0) options.num_threads = 1;
+    // The control socket can raise the worker count up to --max-threads, by default the
+    // number of CPUs
+    if (options.max_threads <= 0) options.max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (options.max_threads < options.num_threads) options.max_threads = options.num_threads;
+    if (options.max_threads > NONCE_THREADS_MAX) {
+        fprintf(stderr, "At most %d worker threads are supported.\n", NONCE_THREADS_MAX);
+        exit(EXIT_FAILURE);
+    }
+    if (options.autotune && options.background) {
+        fprintf(stderr, "--autotune and --background both park workers; use one of them.\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((options.worker_id != NONCE_AUTO && (options.worker_id < 0 || options.worker_id > NONCE_WORKER_ID_MAX))
+        || (options.instance != NONCE_AUTO && (options.instance < 0 || options.instance > NONCE_INSTANCE_MAX))) {
+        fprintf(stderr, "The worker id must be 0 to %d and the instance 0 to %d.\n", NONCE_WORKER_ID_MAX, NONCE_INSTANCE_MAX);
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (options.trace_size <= 0) options.trace_size = 64;
+    if (options.cpu_usage <=0 || options.cpu_usage > 100) options.cpu_usage = 100;
+    if (options.report_interval <= 0) options.report_interval = 1;
+    if (options.poll_interval_ms < 100) options.poll_interval_ms = 100;
+
+    argon2_kernel_t kernel = argon2_kernel_detect();
+    if (options.kernel_name && !argon2_kernel_parse(options.kernel_name, &kernel)) {
+        fprintf(stderr, "Unknown Argon2 kernel '%s'.\n", options.kernel_name);
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if (!argon2_kernel_select(kernel)) {
+        fprintf(stderr, "The %s Argon2 kernel is not supported by this CPU.\n", argon2_kernel_name(kernel));
+        exit(EXIT_FAILURE);
+    }
+    // Resolve the SHA-256 implementation before the workers race to do it
+    sha256_init_dispatch();
+
+    // Huge pages for the arenas: explicit ones first, falling back to THP and then small pages
+    argon2_pages_t pages = ARGON2_PAGES_HUGETLB;
+    if (!options.hugepages) options.hugepages = "hugetlb";
+    if (!argon2_pages_parse(options.hugepages, &pages)) {
+        fprintf(stderr, "Unknown huge page mode '%s'.\n", options.hugepages);
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    argon2_arena_set_pages(pages);
 
-    while(1) {
-        printf("Fetching initial mining info from %s...\n", node);
-        if (!get_mining_info(node, &height, difficulty, &block_date)) {
-            fprintf(stderr, "Failed to get mining info. Retrying in 10 seconds.\n");
-            sleep(10);
-            continue;
-        }
+    if (options.profile) {
+        profile_enable();
+    }
 
-        gmp_printf("Starting miner for address %s\nHeight: %ld\nDifficulty: %Zd\nThreads: %d\nCPU: %d%%\nReport Interval: %ds\n",
-            address, height, difficulty, num_threads, cpu_usage, report_interval);
-        printf("---------------------------------------------------\n");
+    // The benchmark needs no node: it mines a synthetic job offline and exits
+    if (options.benchmark) {
+        return benchmark_main(options.address ? options.address : BENCH_ADDRESS, options.cpu_usage, options.lanes, options.hugepages, options.bench_duration, options.bench_hashes, options.bench_threads, options.bench_json);
+    }
 
 
-        pthread_t* threads = malloc(sizeof(pthread_t) * num_threads);
-        mining_stats = malloc(sizeof(thread_stats_t) * num_threads);
+    // This process's part of the nonce space: the host's worker id and a free instance on it
+    nonce_worker_id = options.worker_id != NONCE_AUTO ? (uint32_t)options.worker_id : nonce_host_worker_id();
+    if (options.instance == NONCE_AUTO) {
+        options.instance = nonce_claim_instance();
+        if (options.instance < 0) {
+            fprintf(stderr, "All %d miner instances on this host are taken; set --instance.\n", NONCE_INSTANCE_MAX + 1);
+            exit(EXIT_FAILURE);
+        }
+    }
+    nonce_instance = options.instance;
 
-        block_found = false;
-        if(found_solution) {
-            mpz_clears(found_solution->difficulty, found_solution->hit, found_solution->target, NULL);
-            free(found_solution->argon);
-            free(found_solution->nonce);
-            free(found_solution);
-            found_solution = NULL;
+    if (options.dup_check) {
+        static dup_sampler_t sampler;
+        if (!dup_sampler_init(&sampler, (size_t)1 << 20)) {
+            fprintf(stderr, "Failed to allocate the duplicate sampler.\n");
+            exit(EXIT_FAILURE);
         }
+        dup_sampler = &sampler;
+    }
 
+    // Each worker gets one Argon2 arena for the whole process, reused across hashes and
+    // blocks. It holds one block matrix per lane.
+    worker_pool_t workers;
+    if (!worker_pool_alloc(&workers, options.max_threads)) {
+        fprintf(stderr, "Failed to allocate the workers.\n");
+        exit(EXIT_FAILURE);
+    }
 
-        for (int i = 0; i < num_threads; i++) {
-            thread_data_t* data = malloc(sizeof(thread_data_t));
-            mining_stats[i].id = i + 1;
-            mining_stats[i].local_hashes = 0;
-            mpz_inits(mining_stats[i].hit, mining_stats[i].best_hit, mining_stats[i].target, NULL);
-            pthread_mutex_init(&mining_stats[i].stat_mutex, NULL);
+    // The rings exist before the submitter and the workers that record into them
+    static trace_writer_t trace_writer;
+    pthread_t tracer;
+    if (options.trace_path) {
+        trace_rings = calloc(options.max_threads + 1, sizeof(trace_ring_t));
+        for (int i = 0; trace_rings && i <= options.max_threads; i++) {
+            if (!trace_ring_init(&trace_rings[i], TRACE_RING_EVENTS, i)) {
+                fprintf(stderr, "Failed to allocate the trace rings.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (!trace_rings || !trace_writer_open(&trace_writer, options.trace_path, (size_t)options.trace_size * 1024 * 1024, trace_rings, options.max_threads + 1)) {
+            fprintf(stderr, "Cannot write the trace to %s.\n", options.trace_path);
+            exit(EXIT_FAILURE);
+        }
+        pthread_create(&tracer, NULL, trace_thread, &trace_writer);
+    }
 
-            data->thread_id = i + 1;
-            data->address = address;
-            data->node = node;
-            data->height = height;
-            data->block_date = block_date;
-            data->cpu_usage = cpu_usage;
-            mpz_init_set(data->difficulty, difficulty);
-            data->stats = &mining_stats[i];
+    // libcurl must be initialized before any thread uses it
+    if (!net_global_init()) {
+        fprintf(stderr, "Failed to initialize libcurl.\n");
+        exit(EXIT_FAILURE);
+    }
+    // --node takes a comma-separated list; the first node is polled until the health checks know better
+    node_pool_t pool;
+    node_pool_init(&pool);
+    for (char* next = strtok(options.node, ","); next; next = strtok(NULL, ",")) {
+        trim(next);
+        if (*next != '\0' && node_pool_add(&pool, next) < 0) {
+            fprintf(stderr, "Warning: ignoring node %s, the node list is full.\n", next);
+        }
+    }
+    if (node_pool_count(&pool) == 0) {
+        print_usage(argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    int configured_nodes = node_pool_count(&pool);
+    if (options.discover) {
+        printf("Fetching peer list from %s...\n", pool.nodes[0].url);
+        int added = discover_peers(pool.nodes[0].client, pool.nodes[0].url, &pool);
+        printf("Found %d more generator nodes.\n", added);
+    }
 
-            pthread_create(&threads[i], NULL, miner_thread, data);
+    // Solutions go to every configured node, then to every extra submit node, and to
+    // whichever node is being mined against
+    submitter_config_t submitter_config = { .address = options.address };
+    for (int i = 0; i < configured_nodes && i < SUBMIT_MAX_NODES; i++) {
+        submitter_config.nodes[submitter_config.node_count++] = pool.nodes[i].url;
+    }
+    for (char* next = options.submit_nodes ? strtok(options.submit_nodes, ",") : NULL; next; next = strtok(NULL, ",")) {
+        trim(next);
+        if (*next == '\0') continue;
+        if (submitter_config.node_count == SUBMIT_MAX_NODES) {
+            fprintf(stderr, "Warning: only the first %d submit nodes are used.\n", SUBMIT_MAX_NODES);
+            break;
         }
+        submitter_config.nodes[submitter_config.node_count++] = next;
+    }
 
-        struct timespec last_report_time;
-        clock_gettime(CLOCK_MONOTONIC, &last_report_time);
-        bool header_printed = false;
+    // One persistent connection for polling, one per submit node and one for the selected node
+    net_client_t* info_client = net_client_create();
+    if (!info_client) {
+        fprintf(stderr, "Failed to create HTTP clients.\n");
+        exit(EXIT_FAILURE);
+    }
+    submitter_config.pool = &pool;
+    for (int i = 0; i <= submitter_config.node_count; i++) {
+        submitter_config.clients[i] = net_client_create();
+        if (!submitter_config.clients[i]) {
+            fprintf(stderr, "Failed to create HTTP clients.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
 
-        while (!block_found) {
-            sleep(1);
-            struct timespec now;
-            clock_gettime(CLOCK_MONOTONIC, &now);
-            double interval = (now.tv_sec - last_report_time.tv_sec) + (now.tv_nsec - last_report_time.tv_nsec) / 1e9;
+    if (!mpsc_queue_init(&solution_queue, 64) || sem_init(&solution_ready, 0, 0) != 0) {
+        fprintf(stderr, "Failed to create the solution queue.\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_t submitter;
+    pthread_create(&submitter, NULL, submitter_thread, &submitter_config);
+
+    dispatcher_config_t dispatcher_config = { &pool, options.poll_interval_ms, info_client };
+    pthread_t dispatcher;
+    mpz_init(current_job.difficulty);
+    pthread_create(&dispatcher, NULL, dispatcher_thread, &dispatcher_config);
+    printf("Fetching initial mining info from %s...\n", pool.nodes[0].url);
+
+    // With more than one node, keep an eye on all of them
+    health_config_t health_config = { &pool, options.discover };
+    pthread_t health;
+    if (node_pool_count(&pool) > 1 || options.discover) {
+        pthread_create(&health, NULL, health_thread, &health_config);
+    }
 
-            if (interval >= report_interval) {
-                if (!flat_log && header_printed) {
-                     // Move cursor up by num_threads lines
-                    printf("\033[%dA", num_threads);
-                }
+    mining_job_t job;
+    mpz_init(job.difficulty);
+    wait_for_job(0, &job);
+
+    gmp_printf("Starting miner for address %s\nHeight: %ld\nDifficulty: %Zd\nThreads: %d\nCPU: %d%%\nReport Interval: %ds\nPoll Interval: %dms\nKernel: %s\nSHA-256: %s\nLanes: %d (%zu MiB Argon2 memory per thread)\nNodes: %d\nSubmit Nodes: %d\n",
+        options.address, job.height, job.difficulty, options.num_threads, options.cpu_usage, options.report_interval, options.poll_interval_ms,
+        argon2_kernel_name(argon2_kernel_active()), sha256_impl_name(), options.lanes, options.lanes * ARGON2_ARENA_SIZE / (1024 * 1024),
+        node_pool_count(&pool), submitter_config.node_count);
+    printf("Nonce Space: worker id %u%s, instance %u%s\n", nonce_worker_id, options.worker_id != NONCE_AUTO ? "" : " (from the host)",
+        nonce_instance, options.dup_check ? ", sampling for duplicates" : "");
+    if (options.trace_path) {
+        printf("Trace: %s, rotated at %d MiB (decode with trace_decode)\n", options.trace_path, options.trace_size);
+    }
 
-                pthread_mutex_lock(&console_mutex);
+    // The autotuner may run any of the --max-threads workers, so all of them are started
+    // and the ones it does not run yet park at once
+    int start_threads = options.num_threads;
+    autotune_config_t autotune_config = { .thread_count = options.max_threads, .state_path = options.autotune_state };
+    bool autotune_restored = false;
+    if (options.autotune) {
+        int saved;
+        double saved_rate;
+        autotune_restored = autotune_load(options.autotune_state, &saved, &saved_rate) && saved <= options.max_threads;
+        autotune_init(&autotune_config.tuner, options.max_threads, autotune_restored ? saved : options.num_threads);
+        atomic_store(&workers_active, autotune_config.tuner.active);
+        start_threads = options.max_threads;
+    }
 
-                if (!header_printed) {
-                    printf("%-6s %-7s %-5s %-8s %-10s %-10s %-10s %-5s %-5s %-5s %-5s\n",
-                           "PID", "Height", "Elapsed", "Speed", "Hit", "Best", "Target", "Submits", "Accepted", "Rejected", "Dropped");
-                    header_printed = true;
-                }
+    // The workers are started once and follow the dispatcher from job to job
+    worker_pool_start(&workers, start_threads, options.address, options.cpu_usage, options.background, options.lanes);
+
+    arena_report_t report;
+    arena_report(workers.arenas, start_threads, &report);
+    print_arena_report(&report, options.hugepages);
+    printf("---------------------------------------------------\n");
+
+    background_config_t background_config = { .thread_count = options.max_threads };
+    pthread_t controller;
+    if (options.background) {
+        uint64_t unused;
+        background_config.psi = pressure_read("cpu", &unused);
+        pthread_create(&controller, NULL, background_thread, &background_config);
+        printf("Background mode: workers yield to other tasks%s.\n",
+            background_config.psi ? " and park under CPU or memory pressure" : " and park when they lose their CPUs (no PSI in this kernel)");
+    }
+    pthread_t tuner;
+    if (options.autotune) {
+        pthread_create(&tuner, NULL, autotune_thread, &autotune_config);
+        printf("Autotune: starting at %d of %d workers%s, measuring %d s windows, best setting saved to %s.\n",
+            autotune_config.tuner.active, options.max_threads, autotune_restored ? " (saved)" : "", AUTOTUNE_WINDOW_MS / 1000,
+            options.autotune_state);
+    }
 
-                if (interval < 1) interval = 1;
-
-                for (int i = 0; i < num_threads; i++) {
-                    // This is an intentional data race. The master prompt prioritizes performance
-                    // by removing all synchronization from the hot path. The worker thread
-                    // increments local_hashes without a lock, and the main thread reads/resets
-                    // it here without a lock. This may result in minor inaccuracies in the
-                    // reported hash rate, which is an accepted trade-off.
-                    long thread_hashes = mining_stats[i].local_hashes;
-                    mining_stats[i].local_hashes = 0;
-                    mining_stats[i].speed = (double)thread_hashes / interval;
-                    char speed_str[16];
-                    snprintf(speed_str, sizeof(speed_str), "%.1f H/s", mining_stats[i].speed);
-
-                    char hit_str[32], best_hit_str[32], target_str[32];
-                    pthread_mutex_lock(&mining_stats[i].stat_mutex);
-                    gmp_sprintf(hit_str, "%Zd", mining_stats[i].hit);
-                    gmp_sprintf(best_hit_str, "%Zd", mining_stats[i].best_hit);
-                    gmp_sprintf(target_str, "%Zd", mining_stats[i].target);
-                    pthread_mutex_unlock(&mining_stats[i].stat_mutex);
-
-
-                    printf("%-6d %-7ld %-5d %-8s %-10s %-10s %-10s %-5d %-5d %-5d %-5d\n",
-                        mining_stats[i].pid,
-                        mining_stats[i].height,
-                        mining_stats[i].elapsed,
-                        speed_str,
-                        hit_str,
-                        best_hit_str,
-                        target_str,
-                        atomic_load(&total_submits),
-                        atomic_load(&total_accepted),
-                        atomic_load(&total_rejected),
-                        atomic_load(&total_dropped)
-                    );
-                }
+    control_config_t control_config = {
+        .workers = &workers, .pool = &pool, .health_config = &health_config, .health_running = node_pool_count(&pool) > 1 || options.discover,
+        .address = options.address, .background = options.background, .started = time(NULL)
+    };
+    atomic_init(&control_config.cpu_usage, options.cpu_usage);
+    atomic_init(&control_config.lanes, options.lanes);
+    atomic_init(&control_config.report_interval, options.report_interval);
+    pthread_t control;
+    if (options.control_path) {
+        if (!control_server_open(&control_config.server, options.control_path)) {
+            exit(EXIT_FAILURE);
+        }
+        pthread_create(&control, NULL, control_thread, &control_config);
+        printf("Listening for commands on %s.\n", options.control_path);
+    }
 
-                pthread_mutex_unlock(&console_mutex);
-                last_report_time = now;
-            }
+    metrics_config_t metrics_config = { .thread_count = options.max_threads };
+    pthread_t metrics;
+    if (options.metrics_port > 0) {
+        if (!metrics_server_open(&metrics_config.server, options.metrics_port)) {
+            exit(EXIT_FAILURE);
         }
+        pthread_create(&metrics, NULL, metrics_thread, &metrics_config);
+        printf("Serving metrics on port %d.\n", options.metrics_port);
+    }
 
-        for (int i = 0; i < num_threads; i++) {
-            pthread_join(threads[i], NULL);
-            mpz_clears(mining_stats[i].hit, mining_stats[i].best_hit, mining_stats[i].target, NULL);
-            pthread_mutex_destroy(&mining_stats[i].stat_mutex);
+    uint64_t* last_hashes = calloc(options.max_threads, sizeof(uint64_t));
+    int shown_threads = 0; // Rows of the stats table last printed
+    struct timespec last_report_time;
+    clock_gettime(CLOCK_MONOTONIC, &last_report_time);
+    bool header_printed = false;
+    uint64_t shown_epoch = job.epoch;
+
+    // SIGUSR1 prints the phase timings; SIGINT and SIGTERM stop the miner cleanly, and
+    // a second one kills it at once
+    signal(SIGUSR1, request_profile_dump);
+    signal(SIGINT, request_exit);
+    signal(SIGTERM, request_exit);
+
+    while (!atomic_load(&exit_requested)) {
+        sleep(1);
+        if (atomic_exchange(&report_interrupted, false)) {
+            header_printed = false; // The table continues below whatever was printed
         }
 
-        if(found_solution) {
-            submit_block(node, address, found_solution);
-            printf("Submission attempted. Waiting 5 seconds before starting next block...\n");
-            sleep(5);
+        if (atomic_exchange(&profile_dump_requested, false)) {
+            pthread_mutex_lock(&console_mutex);
+            profile_dump(stdout, workers.profiles, atomic_load(&workers_started));
+            pthread_mutex_unlock(&console_mutex);
+            header_printed = false;
         }
 
-        free(threads);
-        free(mining_stats);
-        mining_stats = NULL;
+        uint64_t epoch = atomic_load(&job_epoch);
+        if (epoch != shown_epoch) {
+            shown_epoch = epoch;
+            wait_for_job(epoch - 1, &job);
+            pthread_mutex_lock(&console_mutex);
+            printf("\nNew block detected on the network. Mining height %ld", job.height);
+            if (job.first_elapsed > 1) {
+                printf(" from %ld s after the block, when a hit can first beat the target", job.first_elapsed);
+            }
+            printf(".\n");
+            pthread_mutex_unlock(&console_mutex);
+            header_printed = false;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double interval = (now.tv_sec - last_report_time.tv_sec) + (now.tv_nsec - last_report_time.tv_nsec) / 1e9;
+
+        if (interval >= atomic_load(&control_config.report_interval)) {
+            int rows = worker_count();
+            if (rows != shown_threads) {
+                header_printed = false; // The control socket changed the number of workers
+                shown_threads = rows;
+            }
+            if (!options.flat_log && header_printed) {
+                 // Move cursor up by one line per worker plus the latency line
+                printf("\033[%dA", rows + 1);
+            }
+
+            pthread_mutex_lock(&console_mutex);
+
+            if (!header_printed) {
+                printf("%-6s %-7s %-5s %-8s %-10s %-10s %-10s %-6s %-5s %-5s %-5s %-5s\n",
+                       "PID", "Height", "Elapsed", "Speed", "Hit", "Best", "Target", "Faults", "Submits", "Accepted", "Rejected", "Dropped");
+                header_printed = true;
+            }
+
+            if (interval < 1) interval = 1;
+
+            for (int i = 0; i < rows; i++) {
+                thread_stats_t* stats = &mining_stats[i];
+                // The worker's counter only grows, so the speed is the difference since the last report
+                uint64_t thread_hashes = stat_get(&stats->hashes);
+                double speed = (thread_hashes - last_hashes[i]) / interval;
+                last_hashes[i] = thread_hashes;
+                char speed_str[16];
+                snprintf(speed_str, sizeof(speed_str), "%.1f H/s", speed);
+
+                char hit_str[32], best_hit_str[32], target_str[48];
+                snprintf(hit_str, sizeof(hit_str), "%llu", (unsigned long long)stat_get(&stats->hit));
+                snprintf(best_hit_str, sizeof(best_hit_str), "%llu", (unsigned long long)stat_get(&stats->best_hit));
+                u128_to_str(stats_get_target(stats), target_str, sizeof(target_str));
+
+
+                printf("%-6d %-7ld %-5d %-8s %-10s %-10s %-10s %-6ld %-5lu %-5lu %-5lu %-5lu\n",
+                    atomic_load_explicit(&stats->pid, memory_order_relaxed),
+                    atomic_load_explicit(&stats->height, memory_order_relaxed),
+                    atomic_load_explicit(&stats->elapsed, memory_order_relaxed),
+                    speed_str,
+                    hit_str,
+                    best_hit_str,
+                    target_str,
+                    atomic_load_explicit(&stats->page_faults, memory_order_relaxed),
+                    (unsigned long)counter_get(&total_submits),
+                    (unsigned long)counter_get(&total_accepted),
+                    (unsigned long)counter_get(&total_rejected),
+                    (unsigned long)counter_get(&total_dropped)
+                );
+            }
+
+            print_latency("Info", &info_client->latency);
+            printf(" | ");
+            print_latency("Submit", &submitter_config.clients[0]->latency);
+            printf(" | ");
+            print_latency("Find-to-ack", &ack_latency);
+            printf(" | ");
+            print_latency("Job switch", &switch_latency);
+            uint64_t aborted = 0;
+            for (int i = 0; i < atomic_load(&workers_started); i++) aborted += stat_get(&mining_stats[i].aborted);
+            printf(" | Aborted: %llu", (unsigned long long)aborted);
+            if (dup_sampler) {
+                uint64_t sampled = atomic_load(&dup_sampler->sampled);
+                printf(" | Duplicates: %llu of %llu sampled", (unsigned long long)atomic_load(&dup_sampler->duplicates),
+                    (unsigned long long)sampled);
+            }
+            long winnable_in = job.block_date + job.first_elapsed - time(NULL);
+            if (winnable_in > 0 && atomic_load(&job_epoch) == job.epoch) {
+                printf(" | Target out of reach: %ld s", winnable_in);
+            }
+            if (options.background || options.autotune) {
+                printf(" | Active: %d/%d", workers_running(), rows);
+            }
+            printf(options.flat_log ? "\n" : "\033[K\n");
+
+            pthread_mutex_unlock(&console_mutex);
+            last_report_time = now;
+        }
     }
-    mpz_clear(difficulty);
+
+    if (options.control_path) {
+        pthread_join(control, NULL);
+        control_server_close(&control_config.server);
+    }
+
+    printf("\nStopping the workers...\n");
+    pthread_mutex_lock(&job_mutex);
+    atomic_store(&workers_stop, true);
+    pthread_cond_broadcast(&job_cond);
+    pthread_mutex_unlock(&job_mutex);
+    unpark_workers();
+    int started = atomic_load(&workers_started);
+    for (int i = 0; i < started; i++) {
+        pthread_join(workers.threads[i], NULL);
+    }
+    if (options.background) {
+        pthread_join(controller, NULL);
+    }
+    if (options.autotune) {
+        pthread_join(tuner, NULL);
+    }
+    if (options.trace_path) {
+        pthread_join(tracer, NULL);
+        trace_writer_close(&trace_writer);
+    }
+    if (profile_enabled) {
+        profile_dump(stdout, workers.profiles, started);
+    }
+    free(last_hashes);
+    for (int i = 0; i < started; i++) {
+        argon2_arena_destroy(&workers.arenas[i]);
+    }
+    free(workers.threads);
+    free(workers.data);
+    free(workers.arenas);
+    free(workers.profiles);
+    free(mining_stats);
+    mpz_clear(job.difficulty);
     return 0;
 }
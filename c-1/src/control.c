@@ -0,0 +1,96 @@
+#define _GNU_SOURCE // For accept4
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include "control.h"
+
+int control_server_open(control_server_t* server, const char* path) {
+    memset(server, 0, sizeof(*server));
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Control socket path '%s' is too long.\n", path);
+        server->fd = -1;
+        return 0;
+    }
+    strcpy(addr.sun_path, path);
+    snprintf(server->path, sizeof(server->path), "%s", path);
+
+    server->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server->fd < 0) {
+        perror("Failed to create the control socket");
+        return 0;
+    }
+    // A miner that was killed leaves its socket file behind
+    unlink(path);
+    mode_t mask = umask(0177);
+    int bound = bind(server->fd, (struct sockaddr*)&addr, sizeof(addr)) == 0;
+    umask(mask);
+    if (!bound || listen(server->fd, 8) != 0) {
+        perror("Failed to listen on the control socket");
+        close(server->fd);
+        server->fd = -1;
+        return 0;
+    }
+    return 1;
+}
+
+void control_server_serve(control_server_t* server, int timeout_ms, control_handler_fn handler, void* arg) {
+    struct pollfd pfd = { .fd = server->fd, .events = POLLIN };
+    if (poll(&pfd, 1, timeout_ms) <= 0) return;
+    int client = accept4(server->fd, NULL, NULL, SOCK_CLOEXEC);
+    if (client < 0) return;
+
+    struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char command[CONTROL_COMMAND_MAX + 1];
+    size_t len = 0;
+    while (len < CONTROL_COMMAND_MAX) {
+        ssize_t got = recv(client, command + len, CONTROL_COMMAND_MAX - len, 0);
+        if (got <= 0) break;
+        len += got;
+        if (memchr(command + len - got, '\n', got)) break;
+    }
+    command[len] = '\0';
+    command[strcspn(command, "\r\n")] = '\0';
+
+    static control_reply_t reply;
+    reply.len = 0;
+    reply.data[0] = '\0';
+    handler(command, &reply, arg);
+    const char* data = reply.data;
+    size_t left = reply.len;
+    while (left > 0) {
+        ssize_t written = send(client, data, left, MSG_NOSIGNAL);
+        if (written <= 0) break;
+        data += written;
+        left -= written;
+    }
+    close(client);
+}
+
+void control_server_close(control_server_t* server) {
+    if (server->fd < 0) return;
+    close(server->fd);
+    unlink(server->path);
+    server->fd = -1;
+}
+
+void control_printf(control_reply_t* reply, const char* format, ...) {
+    size_t room = sizeof(reply->data) - reply->len;
+    if (room <= 1) return;
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(reply->data + reply->len, room, format, args);
+    va_end(args);
+    if (len > 0) reply->len += (size_t)len < room ? (size_t)len : room - 1;
+}
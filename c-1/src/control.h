@@ -0,0 +1,53 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stddef.h>
+
+// A Unix-domain socket for controlling the miner while it runs. Each connection carries
+// one command line and gets one reply, after which the server closes it. Replies start
+// with "ok" or "error: <reason>".
+
+// Where the miner listens and miner_ctl connects unless told otherwise
+#define CONTROL_DEFAULT_PATH "c_miner.sock"
+// Longest command line
+#define CONTROL_COMMAND_MAX 1024
+// Longest reply
+#define CONTROL_REPLY_MAX 16384
+
+typedef struct {
+    int fd;
+    char path[108]; // sizeof(sockaddr_un.sun_path)
+} control_server_t;
+
+typedef struct {
+    char data[CONTROL_REPLY_MAX];
+    size_t len;
+} control_reply_t;
+
+typedef void (*control_handler_fn)(char* command, control_reply_t* reply, void* arg);
+
+/**
+ * @brief Listens on a Unix-domain socket at `path`, replacing a stale socket file.
+ *
+ * The socket is only accessible to the user running the miner.
+ *
+ * @return 1 on success, 0 if it cannot be bound (the error is printed).
+ */
+int control_server_open(control_server_t* server, const char* path);
+
+/**
+ * @brief Waits up to `timeout_ms` for a command and answers it with `handler`.
+ */
+void control_server_serve(control_server_t* server, int timeout_ms, control_handler_fn handler, void* arg);
+
+/**
+ * @brief Closes the socket and removes its file.
+ */
+void control_server_close(control_server_t* server);
+
+/**
+ * @brief Appends formatted text to a reply; what does not fit is cut off.
+ */
+void control_printf(control_reply_t* reply, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+#endif // CONTROL_H
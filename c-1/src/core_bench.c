@@ -0,0 +1,378 @@
+#define _GNU_SOURCE // For syscall
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <getopt.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <x86intrin.h>
+#include <gmp.h>
+#include "miner_core.h"
+#include "argon2i_kernel.h"
+
+// Microbenchmarks of the miner_core functions, one at a time, for comparing builds and
+// library versions. Every case reports ns/op, cycles/op and heap allocations/op; the
+// results can be saved as a baseline and later runs fail when a case got slower.
+
+// --- Allocation Counting ---
+
+// malloc, calloc and realloc are interposed for the whole process, so allocations made
+// inside GMP, OpenSSL and libargon2 are counted too. Aligned allocations and mmap are not.
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+static atomic_ulong allocations = ATOMIC_VAR_INIT(0);
+
+void* malloc(size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+// --- Cycle Counting ---
+
+// Core cycles from the PMU when the kernel allows it, otherwise TSC ticks
+static int cycles_fd = -1;
+
+static void cycles_open(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    cycles_fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (cycles_fd >= 0) {
+        ioctl(cycles_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static uint64_t cycles_now(void) {
+    if (cycles_fd >= 0) {
+        uint64_t count;
+        if (read(cycles_fd, &count, sizeof(count)) == sizeof(count)) return count;
+    }
+    return __rdtsc();
+}
+
+// --- Cases ---
+
+// The two Argon2 parameter sets are chosen by the block date, like in PHPCoin
+#define LEGACY_BLOCK_DATE 1600000000L // Before UPDATE_3_ARGON_HARD: m=2048
+#define MODERN_BLOCK_DATE 1700000000L // m=32768
+#define BENCH_ADDRESS "PZ8Tyr4Nx8MHsRAGMpZmZ6TWY63dXWSCzm"
+#define BENCH_HEIGHT 1000000L
+#define BENCH_ELAPSED 30
+#define BENCH_DIFFICULTY "84395412954"
+
+// Inputs shared by all cases of one parameter set, prepared outside the timed loop
+typedef struct {
+    long block_date;
+    char* argon;
+    char* nonce;
+    mpz_t difficulty;
+    mpz_t result;
+    uint64_t difficulty64;
+    attempt_midstate_t midstate;
+    attempt_job_t job;
+    attempt_scratch_t scratch;
+    uint64_t counter;
+} bench_input_t;
+
+// Keeps results alive so the compiler cannot drop the work
+static volatile uint64_t sink;
+
+static void bench_argon_hash(bench_input_t* in) {
+    char* argon = calculate_argon_hash(BENCH_ADDRESS, in->block_date, BENCH_ELAPSED, BENCH_HEIGHT, in->counter++);
+    sink += argon[0];
+    free(argon);
+}
+
+static void bench_mine_attempt(bench_input_t* in) {
+    attempt_result_t result;
+    mine_attempt(&in->job, &in->scratch, in->counter++, &result);
+    sink += result.hit;
+}
+
+static void bench_nonce(bench_input_t* in) {
+    char* nonce = calculate_nonce(BENCH_ADDRESS, in->block_date, BENCH_ELAPSED, in->argon);
+    sink += nonce[0];
+    free(nonce);
+}
+
+static void bench_hit(bench_input_t* in) {
+    calculate_hit(in->result, BENCH_ADDRESS, in->nonce, BENCH_HEIGHT, in->difficulty);
+    sink += mpz_get_ui(in->result);
+}
+
+static void bench_hit_u64(bench_input_t* in) {
+    sink += calculate_hit_u64(BENCH_ADDRESS, in->nonce, BENCH_HEIGHT, BENCH_DIFFICULTY);
+}
+
+static void bench_nonce_hit_batch(bench_input_t* in) {
+    char nonce[1][65];
+    uint64_t hit;
+    calculate_nonce_hit_batch(&in->midstate, &in->argon, 1, nonce, &hit);
+    sink += hit;
+}
+
+static void bench_target(bench_input_t* in) {
+    calculate_target(in->result, BENCH_ELAPSED + (int)(in->counter++ & 31), in->difficulty);
+    sink += mpz_get_ui(in->result);
+}
+
+static void bench_target_u128(bench_input_t* in) {
+    sink += (uint64_t)calculate_target_u128(BENCH_ELAPSED + (int)(in->counter++ & 31), in->difficulty64);
+}
+
+typedef struct {
+    const char* name;
+    void (*run)(bench_input_t* in);
+    bool legacy; // Runs with the legacy parameter set
+    bool slow;   // Argon2: far fewer iterations per trial
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    { "argon_hash/legacy", bench_argon_hash, true, true },
+    { "argon_hash/modern", bench_argon_hash, false, true },
+    { "mine_attempt/legacy", bench_mine_attempt, true, true },
+    { "mine_attempt/modern", bench_mine_attempt, false, true },
+    { "nonce/legacy", bench_nonce, true, false },
+    { "nonce/modern", bench_nonce, false, false },
+    { "hit", bench_hit, false, false },
+    { "hit_u64", bench_hit_u64, false, false },
+    { "nonce_hit_batch", bench_nonce_hit_batch, false, false },
+    { "target", bench_target, false, false },
+    { "target_u128", bench_target_u128, false, false },
+};
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+// Each case is timed over this many trials and the median trial is reported
+#define TRIALS 5
+
+typedef struct {
+    double ns;
+    double cycles;
+    double allocs;
+} bench_result_t;
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int compare_results(const void* a, const void* b) {
+    double x = ((const bench_result_t*)a)->ns, y = ((const bench_result_t*)b)->ns;
+    return (x > y) - (x < y);
+}
+
+static void run_case(const bench_case_t* bench, bench_input_t* in, double min_time_ms, bench_result_t* result) {
+    // Warm up caches and arenas, then size the trials to take about min_time_ms together
+    bench->run(in);
+    double start = now_ns();
+    long calibration = 0;
+    do {
+        bench->run(in);
+        calibration++;
+    } while (now_ns() - start < (bench->slow ? 1e6 : 1e5));
+    double per_op = (now_ns() - start) / calibration;
+    long iterations = (long)(min_time_ms * 1e6 / TRIALS / per_op);
+    if (iterations < 1) iterations = 1;
+
+    bench_result_t trials[TRIALS];
+    for (int t = 0; t < TRIALS; t++) {
+        unsigned long allocs_start = atomic_load(&allocations);
+        uint64_t cycles_start = cycles_now();
+        double ns_start = now_ns();
+        for (long i = 0; i < iterations; i++) {
+            bench->run(in);
+        }
+        double ns = now_ns() - ns_start;
+        uint64_t cycles = cycles_now() - cycles_start;
+        unsigned long allocs = atomic_load(&allocations) - allocs_start;
+        trials[t].ns = ns / iterations;
+        trials[t].cycles = (double)cycles / iterations;
+        trials[t].allocs = (double)allocs / iterations;
+    }
+    qsort(trials, TRIALS, sizeof(trials[0]), compare_results);
+    *result = trials[TRIALS / 2];
+}
+
+static void input_init(bench_input_t* in, long block_date) {
+    in->block_date = block_date;
+    in->counter = 0;
+    in->argon = calculate_argon_hash(BENCH_ADDRESS, block_date, BENCH_ELAPSED, BENCH_HEIGHT, 0);
+    in->nonce = in->argon ? calculate_nonce(BENCH_ADDRESS, block_date, BENCH_ELAPSED, in->argon) : NULL;
+    mpz_init_set_str(in->difficulty, BENCH_DIFFICULTY, 10);
+    mpz_init(in->result);
+    difficulty_to_u64(in->difficulty, &in->difficulty64);
+    attempt_midstate_init(&in->midstate, BENCH_ADDRESS, block_date, BENCH_ELAPSED, BENCH_HEIGHT, BENCH_DIFFICULTY);
+    attempt_job_prepare(&in->job, BENCH_ADDRESS, block_date, BENCH_ELAPSED, BENCH_HEIGHT, in->difficulty);
+    attempt_scratch_init(&in->scratch, NULL);
+}
+
+static void input_clear(bench_input_t* in) {
+    free(in->argon);
+    free(in->nonce);
+    mpz_clears(in->difficulty, in->result, NULL);
+}
+
+// --- Baseline ---
+
+// A baseline is a text file with one "<case> <ns/op> <allocs/op>" line per case
+static int baseline_find(const char* path, const char* name, double* ns, double* allocs) {
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    char line[256], key[128];
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), file)) {
+        if (line[0] == '#') continue;
+        found = sscanf(line, "%127s %lf %lf", key, ns, allocs) == 3 && strcmp(key, name) == 0;
+    }
+    fclose(file);
+    return found;
+}
+
+static int baseline_save(const char* path, const bench_result_t* results) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        perror("Failed to write the baseline");
+        return 0;
+    }
+    fprintf(file, "# core_bench baseline: <case> <ns/op> <allocs/op>, kernel %s, sha256 %s\n",
+        argon2_kernel_name(argon2_kernel_active()), sha256_impl_name());
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        fprintf(file, "%s %.3f %.3f\n", cases[i].name, results[i].ns, results[i].allocs);
+    }
+    fclose(file);
+    return 1;
+}
+
+// --- Main Function ---
+
+void print_usage(const char* prog_name) {
+    fprintf(stderr, "Usage: %s [--kernel <auto|libargon2|portable|sse2|avx2|avx512>] [--filter <text>] [--min-time <ms>] [--baseline <file>] [--threshold <percent>] [--save-baseline <file>]\n", prog_name);
+}
+
+int main(int argc, char** argv) {
+    char* kernel_name = NULL;
+    const char* filter = NULL;
+    const char* baseline = NULL;
+    const char* save_path = NULL;
+    double min_time_ms = 1000;
+    double threshold = 10;
+    int opt;
+
+    static struct option long_options[] = {
+        {"kernel", required_argument, 0, 'k'},
+        {"filter", required_argument, 0, 'f'},
+        {"min-time", required_argument, 0, 'm'},
+        {"baseline", required_argument, 0, 'b'},
+        {"threshold", required_argument, 0, 'r'},
+        {"save-baseline", required_argument, 0, 's'},
+        {0, 0, 0, 0}
+    };
+    while ((opt = getopt_long(argc, argv, "k:f:m:b:r:s:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'k': kernel_name = optarg; break;
+            case 'f': filter = optarg; break;
+            case 'm': min_time_ms = atof(optarg); break;
+            case 'b': baseline = optarg; break;
+            case 'r': threshold = atof(optarg); break;
+            case 's': save_path = optarg; break;
+            default:
+                print_usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if (min_time_ms <= 0) min_time_ms = 1000;
+    if (save_path && filter) {
+        fprintf(stderr, "A baseline must cover every case; --save-baseline cannot be combined with --filter.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    argon2_kernel_t kernel = argon2_kernel_detect();
+    if (kernel_name && !argon2_kernel_parse(kernel_name, &kernel)) {
+        fprintf(stderr, "Unknown Argon2 kernel '%s'.\n", kernel_name);
+        exit(EXIT_FAILURE);
+    }
+    if (!argon2_kernel_select(kernel)) {
+        fprintf(stderr, "The %s Argon2 kernel is not supported by this CPU.\n", argon2_kernel_name(kernel));
+        exit(EXIT_FAILURE);
+    }
+    sha256_init_dispatch();
+    cycles_open();
+
+    // The miner hashes out of a bound arena, so the benchmark does too
+    argon2_arena_t arena;
+    if (argon2_arena_init(&arena, ARGON2_ARENA_SIZE)) {
+        argon2_arena_bind(&arena);
+    }
+
+    bench_input_t legacy, modern;
+    input_init(&legacy, LEGACY_BLOCK_DATE);
+    input_init(&modern, MODERN_BLOCK_DATE);
+    if (!legacy.nonce || !modern.nonce) {
+        fprintf(stderr, "Failed to prepare the benchmark inputs.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Kernel: %s\nSHA-256: %s\nCycles: %s\n", argon2_kernel_name(argon2_kernel_active()), sha256_impl_name(),
+        cycles_fd >= 0 ? "core cycles" : "TSC ticks (no access to perf events)");
+    if (baseline) printf("Baseline: %s (threshold %.1f%%)\n", baseline, threshold);
+    printf("---------------------------------------------------\n");
+    printf("%-20s %14s %14s %10s %10s\n", "Case", "ns/op", "cycles/op", "allocs/op", "vs base");
+
+    bench_result_t results[CASE_COUNT];
+    int regressions = 0;
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        const bench_case_t* bench = &cases[i];
+        if (filter && !strstr(bench->name, filter)) continue;
+        run_case(bench, bench->legacy ? &legacy : &modern, min_time_ms, &results[i]);
+
+        char change[32] = "";
+        double base_ns, base_allocs;
+        if (baseline && baseline_find(baseline, bench->name, &base_ns, &base_allocs)) {
+            double percent = 100 * (results[i].ns - base_ns) / base_ns;
+            // Allocation counts are exact, so any increase is a regression
+            bool regressed = percent > threshold || results[i].allocs > base_allocs + 0.01;
+            snprintf(change, sizeof(change), "%+.1f%%%s", percent, regressed ? " !" : "");
+            regressions += regressed;
+        } else if (baseline) {
+            snprintf(change, sizeof(change), "new");
+        }
+        printf("%-20s %14.1f %14.1f %10.2f %10s\n", bench->name, results[i].ns, results[i].cycles, results[i].allocs, change);
+        fflush(stdout);
+    }
+
+    if (save_path && baseline_save(save_path, results)) {
+        printf("Baseline written to %s\n", save_path);
+    }
+    if (regressions > 0) {
+        printf("%d case(s) regressed beyond %.1f%% or allocate more than the baseline.\n", regressions, threshold);
+    }
+
+    input_clear(&legacy);
+    input_clear(&modern);
+    argon2_arena_bind(NULL);
+    argon2_arena_destroy(&arena);
+    return regressions > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <string.h>
+#include "json.h"
+
+static int new_token(json_token_t* tokens, int* count, int max_tokens, json_type_t type, int start, int end, int parent) {
+    if (*count >= max_tokens) return JSON_ERROR_NOMEM;
+    json_token_t* t = &tokens[*count];
+    t->type = type;
+    t->start = start;
+    t->end = end;
+    t->size = 0;
+    t->parent = parent;
+    return (*count)++;
+}
+
+int json_parse(const char* js, size_t len, json_token_t* tokens, int max_tokens) {
+    int count = 0;
+    int open = -1; // Innermost container that is still open
+
+    for (size_t pos = 0; pos < len && js[pos] != '\0'; pos++) {
+        char c = js[pos];
+        switch (c) {
+            case '{':
+            case '[': {
+                int idx = new_token(tokens, &count, max_tokens, c == '{' ? JSON_OBJECT : JSON_ARRAY, (int)pos, -1, open);
+                if (idx < 0) return idx;
+                if (open >= 0 && tokens[open].type == JSON_ARRAY) tokens[open].size++;
+                open = idx;
+                break;
+            }
+            case '}':
+            case ']': {
+                json_type_t type = c == '}' ? JSON_OBJECT : JSON_ARRAY;
+                if (open < 0 || tokens[open].type != type) return JSON_ERROR_INVAL;
+                tokens[open].end = (int)pos + 1;
+                open = tokens[open].parent;
+                break;
+            }
+            case '"': {
+                size_t start = ++pos;
+                while (pos < len && js[pos] != '"') {
+                    if (js[pos] == '\\') pos++; // Skip the escaped character
+                    pos++;
+                }
+                if (pos >= len) return JSON_ERROR_PART;
+                int idx = new_token(tokens, &count, max_tokens, JSON_STRING, (int)start, (int)pos, open);
+                if (idx < 0) return idx;
+                if (open >= 0 && tokens[open].type == JSON_ARRAY) tokens[open].size++;
+                break;
+            }
+            case ':':
+                // Objects count their keys, one per separator
+                if (open < 0 || tokens[open].type != JSON_OBJECT) return JSON_ERROR_INVAL;
+                tokens[open].size++;
+                break;
+            case ' ': case '\t': case '\r': case '\n': case ',':
+                break;
+            default: {
+                size_t start = pos;
+                while (pos < len && js[pos] != '\0' && !strchr(" \t\r\n,:]}", js[pos])) pos++;
+                int idx = new_token(tokens, &count, max_tokens, JSON_PRIMITIVE, (int)start, (int)pos, open);
+                if (idx < 0) return idx;
+                if (open >= 0 && tokens[open].type == JSON_ARRAY) tokens[open].size++;
+                pos--; // Re-examine the delimiter
+                break;
+            }
+        }
+    }
+
+    if (open >= 0) return JSON_ERROR_PART;
+    return count;
+}
+
+// Index of the first token after the value starting at `idx` (skips nested containers)
+static int json_skip(const json_token_t* tokens, int count, int idx) {
+    int end = tokens[idx].end;
+    int i = idx + 1;
+    while (i < count && tokens[i].start < end) i++;
+    return i;
+}
+
+int json_object_get(const char* js, const json_token_t* tokens, int count, int object, const char* key) {
+    if (object < 0 || object >= count || tokens[object].type != JSON_OBJECT) return -1;
+    int i = object + 1;
+    while (i + 1 < count && tokens[i].parent == object) {
+        // tokens[i] is a key, tokens[i + 1] its value
+        if (tokens[i].type == JSON_STRING && json_token_eq(js, &tokens[i], key)) return i + 1;
+        i = json_skip(tokens, count, i + 1);
+    }
+    return -1;
+}
+
+int json_token_eq(const char* js, const json_token_t* token, const char* str) {
+    if (token->type != JSON_STRING && token->type != JSON_PRIMITIVE) return 0;
+    size_t len = token->end - token->start;
+    return strlen(str) == len && strncmp(js + token->start, str, len) == 0;
+}
+
+int json_token_copy(const char* js, const json_token_t* token, char* dst, size_t dst_len) {
+    if (token->type != JSON_STRING && token->type != JSON_PRIMITIVE) return 0;
+    size_t len = token->end - token->start;
+    if (len + 1 > dst_len) return 0;
+    memcpy(dst, js + token->start, len);
+    dst[len] = '\0';
+    return 1;
+}
+
+int json_token_long(const char* js, const json_token_t* token, long* value) {
+    char buf[32];
+    if (!json_token_copy(js, token, buf, sizeof(buf)) || buf[0] == '\0') return 0;
+    char* end;
+    *value = strtol(buf, &end, 10);
+    return *end == '\0';
+}
@@ -0,0 +1,63 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <stddef.h>
+
+// A minimal, allocation-free JSON tokenizer for the small responses of the node API.
+// The input is scanned once into a caller-provided token array; values are never copied
+// until the caller asks for them.
+
+typedef enum {
+    JSON_UNDEFINED = 0,
+    JSON_OBJECT,
+    JSON_ARRAY,
+    JSON_STRING,
+    JSON_PRIMITIVE // number, true, false or null
+} json_type_t;
+
+typedef struct {
+    json_type_t type;
+    int start;  // Offset of the first character (strings: after the opening quote)
+    int end;    // Offset one past the last character (strings: the closing quote)
+    int size;   // Objects: number of keys. Arrays: number of elements.
+    int parent; // Index of the enclosing token, -1 for the root
+} json_token_t;
+
+#define JSON_ERROR_NOMEM -1 // More tokens than `max_tokens`
+#define JSON_ERROR_INVAL -2 // Malformed input
+#define JSON_ERROR_PART -3  // Truncated input
+
+/**
+ * @brief Tokenizes `len` bytes of JSON in a single pass.
+ *
+ * Tokens are stored in document order, so a container is always followed by its contents.
+ *
+ * @return The number of tokens, or a negative JSON_ERROR_* code.
+ */
+int json_parse(const char* js, size_t len, json_token_t* tokens, int max_tokens);
+
+/**
+ * @brief Returns the index of the value stored under `key` in the object at `object`, or -1.
+ */
+int json_object_get(const char* js, const json_token_t* tokens, int count, int object, const char* key);
+
+/**
+ * @brief Returns 1 if the string or primitive token equals `str`.
+ */
+int json_token_eq(const char* js, const json_token_t* token, const char* str);
+
+/**
+ * @brief Copies a string or primitive token into `dst` (NUL-terminated, escapes left as-is).
+ *
+ * @return 1 on success, 0 if the token is a container or does not fit.
+ */
+int json_token_copy(const char* js, const json_token_t* token, char* dst, size_t dst_len);
+
+/**
+ * @brief Parses a string or primitive token as a decimal integer.
+ *
+ * @return 1 on success, 0 if the token is not an integer.
+ */
+int json_token_long(const char* js, const json_token_t* token, long* value);
+
+#endif // JSON_H
@@ -0,0 +1,110 @@
+#define _GNU_SOURCE // For accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include "metrics.h"
+
+// Largest request we read; scrapers send a few hundred bytes of headers
+#define REQUEST_MAX 4096
+
+int metrics_server_open(metrics_server_t* server, int port) {
+    memset(server, 0, sizeof(*server));
+    server->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (server->fd < 0) {
+        perror("Failed to create the metrics socket");
+        return 0;
+    }
+    int one = 1;
+    setsockopt(server->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(server->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(server->fd, 16) != 0) {
+        perror("Failed to listen on the metrics port");
+        close(server->fd);
+        server->fd = -1;
+        return 0;
+    }
+    return 1;
+}
+
+static void write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t written = send(fd, data, len, MSG_NOSIGNAL);
+        if (written <= 0) return;
+        data += written;
+        len -= written;
+    }
+}
+
+void metrics_server_serve(metrics_server_t* server, int timeout_ms, metrics_render_fn render, void* arg) {
+    struct pollfd pfd = { .fd = server->fd, .events = POLLIN };
+    if (poll(&pfd, 1, timeout_ms) <= 0) return;
+    int client = accept4(server->fd, NULL, NULL, SOCK_CLOEXEC);
+    if (client < 0) return;
+
+    // A slow client must not hold up the next scrape for long
+    struct timeval timeout = { .tv_sec = 1, .tv_usec = 0 };
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    char request[REQUEST_MAX + 1];
+    size_t len = 0;
+    while (len < REQUEST_MAX) {
+        ssize_t got = recv(client, request + len, REQUEST_MAX - len, 0);
+        if (got <= 0) break;
+        len += got;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n")) break;
+    }
+    request[len] = '\0';
+
+    if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        server->body.len = 0;
+        render(&server->body, arg);
+        char header[160];
+        int header_len = snprintf(header, sizeof(header),
+            "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+            server->body.len);
+        write_all(client, header, header_len);
+        write_all(client, server->body.data, server->body.len);
+    } else if (len > 0) {
+        static const char not_found[] = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        write_all(client, not_found, sizeof(not_found) - 1);
+    }
+    close(client);
+}
+
+void metrics_printf(metrics_buffer_t* out, const char* format, ...) {
+    for (;;) {
+        size_t room = out->cap - out->len;
+        va_list args;
+        va_start(args, format);
+        int needed = vsnprintf(out->data ? out->data + out->len : NULL, room, format, args);
+        va_end(args);
+        if (needed < 0) return;
+        if ((size_t)needed < room) {
+            out->len += needed;
+            return;
+        }
+        size_t cap = out->cap ? out->cap * 2 : 4096;
+        while (cap - out->len <= (size_t)needed) cap *= 2;
+        char* data = realloc(out->data, cap);
+        if (!data) return;
+        out->data = data;
+        out->cap = cap;
+    }
+}
+
+void metrics_describe(metrics_buffer_t* out, const char* name, const char* type, const char* help) {
+    metrics_printf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
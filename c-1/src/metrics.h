@@ -0,0 +1,50 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+
+// A minimal HTTP endpoint serving metrics in the Prometheus text format. The server is
+// driven by one thread, which renders the metrics afresh for every request.
+
+// Growable text buffer the metrics are rendered into
+typedef struct {
+    char* data;
+    size_t len;
+    size_t cap;
+} metrics_buffer_t;
+
+typedef struct {
+    int fd;
+    metrics_buffer_t body;
+} metrics_server_t;
+
+typedef void (*metrics_render_fn)(metrics_buffer_t* out, void* arg);
+
+/**
+ * @brief Listens for scrapes on `port` on all interfaces.
+ *
+ * @return 1 on success, 0 if the socket cannot be bound (the error is printed).
+ */
+int metrics_server_open(metrics_server_t* server, int port);
+
+/**
+ * @brief Waits up to `timeout_ms` for a scrape and answers it.
+ *
+ * `GET /metrics` (and `GET /`) is answered with whatever `render` writes; any other
+ * request gets a 404. Returns once one request was handled or the timeout expired.
+ */
+void metrics_server_serve(metrics_server_t* server, int timeout_ms, metrics_render_fn render, void* arg);
+
+/**
+ * @brief Appends formatted text to a metrics buffer.
+ */
+void metrics_printf(metrics_buffer_t* out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Appends the HELP and TYPE lines of a metric.
+ *
+ * @param type "counter" or "gauge".
+ */
+void metrics_describe(metrics_buffer_t* out, const char* name, const char* type, const char* help);
+
+#endif // METRICS_H
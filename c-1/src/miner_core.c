@@ -6,150 +6,553 @@
 #include <openssl/rand.h> // For generating the salt
 #include <argon2.h>
 #include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
 #include "miner_core.h"
+#include "argon2i_kernel.h"
 
 // Constants
-#define SALT_LEN 16
+#define SALT_LEN ARGON2_SALT_LEN
 
-// Helper function to convert a raw SHA256 hash to a hex string
-static void sha256_to_hex(const unsigned char* hash, char* hex_string) {
-    for(int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        sprintf(hex_string + (i * 2), "%02x", hash[i]);
+// --- Argon2 Arenas ---
+
+// The arena bound to the calling thread, if any. The argon2 allocation hooks
+// carry no user pointer, so the arena is looked up through thread-local storage.
+static __thread argon2_arena_t* current_arena = NULL;
+
+static argon2_pages_t arena_pages = ARGON2_PAGES_HUGETLB;
+
+// Size of a huge page on x86-64
+#define HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+void argon2_arena_set_pages(argon2_pages_t pages) {
+    arena_pages = pages;
+}
+
+int argon2_pages_parse(const char* name, argon2_pages_t* pages) {
+    static const char* const names[] = { "hugetlb", "thp", "off" };
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *pages = (argon2_pages_t)i;
+            return 1;
+        }
     }
-    hex_string[64] = 0;
+    return 0;
 }
 
-char* calculate_argon_hash(const char* miner_address, long prev_block_date, int elapsed, long height, uint64_t nonce) {
-    char base[256];
-    snprintf(base, sizeof(base), "%ld-%d-%llu", prev_block_date, elapsed, (unsigned long long)nonce);
+int argon2_arena_init(argon2_arena_t* arena, size_t size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->size = size;
+
+    // Explicit huge pages are reserved at mmap time, so a short pool fails here and not later
+    if (arena_pages == ARGON2_PAGES_HUGETLB) {
+        size_t map_size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        void* mem = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mem != MAP_FAILED) {
+            arena->base = arena->map_base = mem;
+            arena->map_size = map_size;
+            arena->pages = ARGON2_PAGES_HUGETLB;
+            return 1;
+        }
+    }
 
-    unsigned char salt[SALT_LEN];
-    uint32_t t_cost, m_cost, parallelism;
+    // Transparent huge pages need the arena to start on a huge page boundary, so map one more
+    size_t map_size = size + (arena_pages != ARGON2_PAGES_SMALL ? HUGE_PAGE_SIZE : 0);
+    void* mem = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("Failed to map Argon2 arena");
+        arena->size = 0;
+        return 0;
+    }
+    arena->map_base = mem;
+    arena->map_size = map_size;
+    if (arena_pages == ARGON2_PAGES_SMALL) {
+        arena->base = (uint8_t*)mem;
+        arena->pages = ARGON2_PAGES_SMALL;
+        madvise(arena->base, size, MADV_NOHUGEPAGE); // Also when THP is "always"
+    } else {
+        arena->base = (uint8_t*)(((uintptr_t)mem + HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+        arena->pages = madvise(arena->base, size, MADV_HUGEPAGE) == 0 ? ARGON2_PAGES_THP : ARGON2_PAGES_SMALL;
+    }
+    return 1;
+}
 
+void argon2_arena_destroy(argon2_arena_t* arena) {
+    if (arena->map_base) {
+        munmap(arena->map_base, arena->map_size);
+    }
+    memset(arena, 0, sizeof(*arena));
+}
+
+// Prefers the NUMA node of the CPU the caller runs on for the pages of `arena`. Nothing
+// is faulted in yet, so the whole arena follows the policy.
+static void arena_bind_local_node(argon2_arena_t* arena) {
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= 1024) return;
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))] = { 0 };
+    mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+    // Fails harmlessly on kernels without NUMA support
+    syscall(SYS_mbind, arena->base, arena->size, MPOL_PREFERRED, mask, sizeof(mask) * 8, 0);
+}
+
+void argon2_arena_bind(argon2_arena_t* arena) {
+    if (arena && arena->base && !atomic_load(&arena->prefaulted)) {
+        arena_bind_local_node(arena);
+        // Touch every page once so the hot loop never takes a page fault.
+        long page_size = sysconf(_SC_PAGESIZE);
+        for (size_t off = 0; off < arena->size; off += page_size) {
+            ((volatile uint8_t*)arena->base)[off] = 0;
+        }
+        atomic_store(&arena->prefaulted, 1);
+    }
+    current_arena = arena;
+}
+
+// AnonHugePages of the mapping that contains `address`, from /proc/self/smaps
+static size_t thp_bytes(const void* address) {
+    FILE* file = fopen("/proc/self/smaps", "r");
+    if (!file) return 0;
+    char line[256];
+    int inside = 0;
+    size_t kib = 0;
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            if (inside) break;
+            inside = (uintptr_t)address >= start && (uintptr_t)address < end;
+        } else if (inside && sscanf(line, "AnonHugePages: %zu kB", &kib) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+    return kib * 1024;
+}
+
+void argon2_arena_backing(const argon2_arena_t* arena, size_t* huge_bytes, int* node) {
+    *huge_bytes = 0;
+    *node = -1;
+    if (!arena->base) return;
+    *huge_bytes = arena->pages == ARGON2_PAGES_HUGETLB ? arena->size : thp_bytes(arena->base);
+    if (*huge_bytes > arena->size) *huge_bytes = arena->size;
+    int page_node;
+    if (syscall(SYS_get_mempolicy, &page_node, NULL, 0, arena->base, MPOL_F_NODE | MPOL_F_ADDR) == 0) {
+        *node = page_node;
+    }
+}
+
+static int arena_allocate(uint8_t** memory, size_t bytes_to_allocate) {
+    if (current_arena && current_arena->base && bytes_to_allocate <= current_arena->size) {
+        *memory = current_arena->base;
+        return ARGON2_OK;
+    }
+    // Block memory must be 64-byte aligned for the vector kernels
+    *memory = aligned_alloc(64, bytes_to_allocate);
+    return *memory ? ARGON2_OK : ARGON2_MEMORY_ALLOCATION_ERROR;
+}
+
+static void arena_free(uint8_t* memory, size_t bytes_to_allocate) {
+    (void)bytes_to_allocate;
+    if (current_arena && memory == current_arena->base) {
+        return; // Arena memory stays mapped for the life of the thread
+    }
+    free(memory);
+}
+
+// Unpadded standard base64, as used by the PHC string format of password_hash.
+static size_t base64_encode_nopad(char* dst, const uint8_t* src, size_t len) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t out = 0;
+    uint32_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < len; i++) {
+        acc = (acc << 8) | src[i];
+        bits += 8;
+        while (bits >= 6) {
+            bits -= 6;
+            dst[out++] = alphabet[(acc >> bits) & 0x3f];
+        }
+    }
+    if (bits > 0) {
+        dst[out++] = alphabet[(acc << (6 - bits)) & 0x3f];
+    }
+    dst[out] = 0;
+    return out;
+}
+
+static void digest_to_hex(const uint8_t* digest, char* hex) {
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < SHA256_DIGEST_SIZE; i++) {
+        hex[2 * i] = digits[digest[i] >> 4];
+        hex[2 * i + 1] = digits[digest[i] & 0x0f];
+    }
+    hex[64] = '\0';
+}
+
+// Writes `value` in decimal without a terminator and returns the number of digits
+static size_t u64_to_dec(char* dst, uint64_t value) {
+    char digits[20];
+    size_t n = 0;
+    do {
+        digits[n++] = '0' + (int)(value % 10);
+        value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = digits[n - 1 - i];
+    }
+    return n;
+}
+
+// --- Attempts: Argon2 ---
+
+// The Argon2 half of a job, following PHPCoin's hashingOptions
+static int attempt_job_prepare_argon(attempt_job_t* job, const char* miner_address, long prev_block_date, int elapsed,
+    long height) {
+    job->prev_block_date = prev_block_date;
+    job->elapsed = elapsed;
     long current_block_date = prev_block_date + elapsed;
     if (current_block_date < 1614556800L) { // Legacy hashing for old blocks (UPDATE_3_ARGON_HARD)
-        t_cost = 2;
-        m_cost = 2048;
-        parallelism = 1;
+        job->legacy = true;
+        job->t_cost = 2;
+        job->m_cost = 2048;
+        job->parallelism = 1;
         // Use the first 16 bytes of the address as the salt
-        strncpy((char*)salt, miner_address, SALT_LEN);
+        strncpy((char*)job->legacy_salt, miner_address, SALT_LEN);
     } else { // Modern hashing
-        t_cost = ARGON2_T_COST;
-        m_cost = ARGON2_M_COST;
-        parallelism = ARGON2_PARALLELISM;
+        job->legacy = false;
+        job->t_cost = ARGON2_T_COST;
+        job->m_cost = ARGON2_M_COST;
+        job->parallelism = ARGON2_PARALLELISM;
 
         // --- New Salt Generation ---
         // We create a deterministic, unique salt for each hash attempt by hashing
         // a combination of the miner's address, the block height, and a per-thread nonce.
         // This ensures that each thread is working on unique data, mirroring the behavior
         // of PHP's password_hash, which generates a random salt for each call.
-        uint64_t salt_nonce = nonce / 1000;
-        char salt_base[512];
-        snprintf(salt_base, sizeof(salt_base), "%s-%ld-%llu", miner_address, height, (unsigned long long)salt_nonce);
-
-        unsigned char salt_hash[SHA256_DIGEST_LENGTH];
-        SHA256((unsigned char*)salt_base, strlen(salt_base), salt_hash);
-
-        // The final salt is the first 16 bytes of the SHA256 hash.
-        memcpy(salt, salt_hash, SALT_LEN);
-    }
-
-    uint32_t hash_len = 32;
-    size_t encoded_len = argon2_encodedlen(
-        t_cost,
-        m_cost,
-        parallelism,
-        sizeof(salt),
-        hash_len,
-        Argon2_i
-    );
-
-    char *encoded_hash = (char*)malloc(encoded_len);
-    if (!encoded_hash) {
-        perror("Failed to allocate memory for Argon2 hash");
-        return NULL;
+        // The attempts only append nonce / 1000 to this prefix.
+        char height_part[32];
+        int len = snprintf(height_part, sizeof(height_part), "-%ld-", height);
+        sha256_init(&job->salt_prefix);
+        sha256_update(&job->salt_prefix, miner_address, strlen(miner_address));
+        sha256_update(&job->salt_prefix, height_part, len);
+    }
+
+    job->pwd_prefix_len = snprintf(job->pwd_prefix, sizeof(job->pwd_prefix), "%ld-%d-", prev_block_date, elapsed);
+    job->encoded_prefix_len = snprintf(job->encoded_prefix, sizeof(job->encoded_prefix), "$argon2i$v=%d$m=%u,t=%u,p=%u$",
+        ARGON2_VERSION_13, job->m_cost, job->t_cost, job->parallelism);
+    return argon2_encodedlen(job->t_cost, job->m_cost, job->parallelism, SALT_LEN, ARGON2_HASH_LEN, Argon2_i)
+        <= ARGON2_ENCODED_MAX;
+}
+
+void attempt_scratch_init(attempt_scratch_t* scratch, argon2_arena_t* arena) {
+    memset(scratch, 0, sizeof(*scratch));
+    scratch->arena = arena;
+    scratch->argon2_error = ARGON2_OK;
+}
+
+const char* attempt_error_message(const attempt_scratch_t* scratch) {
+    if (scratch->argon2_error != ARGON2_OK) {
+        return argon2_error_message(scratch->argon2_error);
+    }
+    return argon2_kernel_active() == ARGON2_KERNEL_LIBARGON2 ? "libargon2 failed" : "the Argon2 kernel failed";
+}
+
+// Fills the raw hashes of the first `count` passwords and salts of the scratch
+static int argon_fill(const attempt_job_t* job, attempt_scratch_t* scratch, int count) {
+    if (argon2_kernel_active() == ARGON2_KERNEL_LIBARGON2) {
+        // The library fills one hash at a time in the first slot of the arena
+        // It cannot be stopped inside a fill, only between two hashes
+        for (int k = 0; k < count; k++) {
+            if (argon2_kernel_cancelled()) return ARGON2_KERNEL_CANCELLED;
+            argon2_context context = {
+                .out = scratch->raw_hashes[k],
+                .outlen = ARGON2_HASH_LEN,
+                .pwd = (uint8_t*)scratch->pwds[k],
+                .pwdlen = scratch->pwd_lens[k],
+                .salt = scratch->salts[k],
+                .saltlen = SALT_LEN,
+                .t_cost = job->t_cost,
+                .m_cost = job->m_cost,
+                .lanes = job->parallelism,
+                .threads = job->parallelism,
+                .version = ARGON2_VERSION_13,
+                .allocate_cbk = arena_allocate,
+                .free_cbk = arena_free,
+                .flags = ARGON2_DEFAULT_FLAGS,
+            };
+            int result = argon2_ctx(&context, Argon2_i);
+            if (result != ARGON2_OK) {
+                scratch->argon2_error = result;
+                return 0;
+            }
+        }
+        return count;
+    }
+
+    // Built-in kernel: every candidate gets its own slot of the arena and they are filled together
+    size_t slot_size = argon2i_kernel_memory_size(job->m_cost);
+    uint8_t* memory;
+    if (arena_allocate(&memory, slot_size * count) != ARGON2_OK) {
+        scratch->argon2_error = ARGON2_MEMORY_ALLOCATION_ERROR;
+        return 0;
+    }
+    argon2i_input_t inputs[ARGON2_MAX_INTERLEAVE];
+    for (int k = 0; k < count; k++) {
+        inputs[k].pwd = scratch->pwds[k];
+        inputs[k].pwdlen = scratch->pwd_lens[k];
+        inputs[k].salt = scratch->salts[k];
+        inputs[k].saltlen = SALT_LEN;
+        inputs[k].out = scratch->raw_hashes[k];
+        inputs[k].memory = memory + slot_size * k;
+    }
+    int ok = argon2i_kernel_hash_interleaved(job->t_cost, job->m_cost, ARGON2_HASH_LEN, inputs, count);
+    arena_free(memory, slot_size * count);
+    if (ok == ARGON2_KERNEL_CANCELLED) return ARGON2_KERNEL_CANCELLED;
+    return ok ? count : 0;
+}
+
+// Encodes the PHC string that argon2i_hash_encoded (and PHP's password_hash) produce
+static void encode_argon_hash(const attempt_job_t* job, const uint8_t* salt, const uint8_t* raw_hash, char* encoded) {
+    memcpy(encoded, job->encoded_prefix, job->encoded_prefix_len);
+    size_t pos = job->encoded_prefix_len;
+    pos += base64_encode_nopad(encoded + pos, salt, SALT_LEN);
+    encoded[pos++] = '$';
+    base64_encode_nopad(encoded + pos, raw_hash, ARGON2_HASH_LEN);
+}
+
+int attempt_argon_batch(const attempt_job_t* job, attempt_scratch_t* scratch, uint64_t first_nonce, int count,
+    attempt_result_t* out) {
+    if (count < 1 || count > ARGON2_MAX_INTERLEAVE) return 0;
+    scratch->argon2_error = ARGON2_OK;
+
+    for (int k = 0; k < count; k++) {
+        // Password "<date>-<elapsed>-<nonce>", salt from nonce / 1000
+        uint64_t nonce = first_nonce + k;
+        memcpy(scratch->pwds[k], job->pwd_prefix, job->pwd_prefix_len);
+        scratch->pwd_lens[k] = job->pwd_prefix_len + u64_to_dec(scratch->pwds[k] + job->pwd_prefix_len, nonce);
+        if (job->legacy) {
+            memcpy(scratch->salts[k], job->legacy_salt, SALT_LEN);
+        } else {
+            char digits[20];
+            sha256_ctx ctx = job->salt_prefix;
+            sha256_update(&ctx, digits, u64_to_dec(digits, nonce / 1000));
+            uint8_t salt_hash[SHA256_DIGEST_SIZE];
+            sha256_final(&ctx, salt_hash);
+            // The final salt is the first 16 bytes of the SHA256 hash.
+            memcpy(scratch->salts[k], salt_hash, SALT_LEN);
+        }
+    }
+
+    // The fill takes its block memory from the scratch, whatever arena the thread has bound
+    argon2_arena_t* bound = current_arena;
+    if (scratch->arena) current_arena = scratch->arena;
+    int made = argon_fill(job, scratch, count);
+    current_arena = bound;
+    if (made != count) return made;
+
+    for (int k = 0; k < count; k++) {
+        encode_argon_hash(job, scratch->salts[k], scratch->raw_hashes[k], out[k].argon);
+    }
+    return count;
+}
+
+int calculate_argon_hash_batch(const char* miner_address, long prev_block_date, int elapsed, long height,
+    uint64_t first_nonce, int count, char** argon_hashes) {
+    if (count < 1 || count > ARGON2_MAX_INTERLEAVE) return 0;
+
+    attempt_job_t job;
+    if (!attempt_job_prepare_argon(&job, miner_address, prev_block_date, elapsed, height)) return 0;
+    attempt_scratch_t scratch;
+    attempt_scratch_init(&scratch, NULL);
+    attempt_result_t results[ARGON2_MAX_INTERLEAVE];
+    int made = attempt_argon_batch(&job, &scratch, first_nonce, count, results);
+    if (made == 0) {
+        fprintf(stderr, "Error creating Argon2 hash: %s\n", attempt_error_message(&scratch));
     }
+    if (made != count) return made;
 
-    int result = argon2i_hash_encoded(
-        t_cost,
-        m_cost,
-        parallelism,
-        base, strlen(base),
-        salt, sizeof(salt),
-        hash_len,
-        encoded_hash,
-        encoded_len
-    );
-
-    if (result != ARGON2_OK) {
-        fprintf(stderr, "Error creating Argon2 hash: %s\n", argon2_error_message(result));
-        free(encoded_hash);
+    for (int k = 0; k < count; k++) {
+        argon_hashes[k] = strdup(results[k].argon);
+        if (!argon_hashes[k]) {
+            perror("Failed to allocate memory for Argon2 hash");
+            for (int j = 0; j < k; j++) {
+                free(argon_hashes[j]);
+                argon_hashes[j] = NULL;
+            }
+            return 0;
+        }
+    }
+    return count;
+}
+
+char* calculate_argon_hash(const char* miner_address, long prev_block_date, int elapsed, long height, uint64_t nonce) {
+    char* argon_hash;
+    if (calculate_argon_hash_batch(miner_address, prev_block_date, elapsed, height, nonce, 1, &argon_hash) != 1) {
         return NULL;
     }
+    return argon_hash;
+}
 
-    return encoded_hash;
+// CHAIN_ID + address + "-<date>-<elapsed>-", the start of every nonce message
+static void nonce_prefix_init(sha256_ctx* ctx, const char* miner_address, long prev_block_date, int elapsed) {
+    char prefix[256];
+    int len = snprintf(prefix, sizeof(prefix), "%s%s-%ld-%d-", CHAIN_ID, miner_address, prev_block_date, elapsed);
+    sha256_init(ctx);
+    sha256_update(ctx, prefix, len);
 }
 
 char* calculate_nonce(const char* miner_address, long prev_block_date, int elapsed, const char* argon_hash) {
-    char nonce_base[512];
-    snprintf(nonce_base, sizeof(nonce_base), "%s%s-%ld-%d-%s",
-        CHAIN_ID, miner_address, prev_block_date, elapsed, argon_hash);
-
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256((unsigned char*)nonce_base, strlen(nonce_base), hash);
+    sha256_ctx ctx;
+    nonce_prefix_init(&ctx, miner_address, prev_block_date, elapsed);
+    sha256_update(&ctx, argon_hash, strlen(argon_hash));
+    uint8_t hash[SHA256_DIGEST_SIZE];
+    sha256_final(&ctx, hash);
 
     char *hex_hash = (char*)malloc(65);
     if (!hex_hash) {
         perror("Failed to allocate memory for nonce");
         return NULL;
     }
-    sha256_to_hex(hash, hex_hash);
+    digest_to_hex(hash, hex_hash);
 
     return hex_hash;
 }
 
-void calculate_hit(mpz_t result, const char* miner_address, const char* nonce, long height, const mpz_t difficulty) {
+// The largest hit calculate_hit can return: ffffffff * BLOCK_TARGET_MUL / 1
+#define HIT_NUMERATOR (0xffffffffULL * BLOCK_TARGET_MUL)
+
+static uint64_t hit_from_digest(const unsigned char* hash) {
+    // The first 4 bytes (32 bits) of the final hash as a big-endian number, like php-4
+    uint32_t value = ((uint32_t)hash[0] << 24) | ((uint32_t)hash[1] << 16) | ((uint32_t)hash[2] << 8) | hash[3];
+    if (value == 0) {
+        value = 1; // Avoid division by zero
+    }
+
+    // ("ffffffff" * BLOCK_TARGET_MUL) / value always fits in 64 bits
+    return HIT_NUMERATOR / value;
+}
+
+uint64_t calculate_hit_u64(const char* miner_address, const char* nonce, long height, const char* difficulty_str) {
     char base[512];
-    char *difficulty_str = mpz_get_str(NULL, 10, difficulty);
-    snprintf(base, sizeof(base), "%s-%s-%ld-%s",
+    int len = snprintf(base, sizeof(base), "%s-%s-%ld-%s",
         miner_address, nonce, height, difficulty_str);
-    free(difficulty_str);
-
 
     // Double SHA256
     unsigned char hash1[SHA256_DIGEST_LENGTH];
-    SHA256((unsigned char*)base, strlen(base), hash1);
+    SHA256((unsigned char*)base, len, hash1);
     unsigned char hash2[SHA256_DIGEST_LENGTH];
     SHA256(hash1, sizeof(hash1), hash2);
 
-    // Take the first 4 bytes (32 bits) of the final hash, like php-4
-    char hash_part_hex[9];
-    for(int i = 0; i < 4; i++) {
-        sprintf(hash_part_hex + i * 2, "%02x", hash2[i]);
-    }
-    hash_part_hex[8] = 0;
+    return hit_from_digest(hash2);
+}
+
+void calculate_hit(mpz_t result, const char* miner_address, const char* nonce, long height, const mpz_t difficulty) {
+    char *difficulty_str = mpz_get_str(NULL, 10, difficulty);
+    uint64_t hit = calculate_hit_u64(miner_address, nonce, height, difficulty_str);
+    free(difficulty_str);
+    mpz_set_ui(result, hit);
+}
+
+static max_hit_fn max_hit_hook = NULL;
+
+void set_max_hit_hook(max_hit_fn hook) {
+    max_hit_hook = hook;
+}
+
+uint64_t calculate_max_hit(long height) {
+    return max_hit_hook ? max_hit_hook(height) : HIT_NUMERATOR;
+}
+
+long calculate_first_winnable_elapsed(const mpz_t difficulty, long height) {
+    uint64_t max_hit = calculate_max_hit(height);
+    if (mpz_sgn(difficulty) <= 0 || max_hit == 0) return 1;
+
+    // target = floor(difficulty * BLOCK_TIME / elapsed) < max_hit as soon as
+    // elapsed > difficulty * BLOCK_TIME / max_hit
+    mpz_t first;
+    mpz_init(first);
+    mpz_mul_ui(first, difficulty, BLOCK_TIME);
+    mpz_fdiv_q_ui(first, first, max_hit);
+    mpz_add_ui(first, first, 1);
+    // Elapsed is an int everywhere else, and a block this hard is out of reach anyway
+    long elapsed = mpz_cmp_ui(first, INT_MAX) > 0 ? INT_MAX : mpz_get_si(first);
+    mpz_clear(first);
+    return elapsed;
+}
+
+// --- Midstates ---
+
+int attempt_midstate_init(attempt_midstate_t* mid, const char* miner_address, long prev_block_date, int elapsed,
+    long height, const char* difficulty_str) {
+    int len = snprintf(mid->hit_suffix, sizeof(mid->hit_suffix), "-%ld-%s", height, difficulty_str);
+    if (len < 0 || (size_t)len >= sizeof(mid->hit_suffix)) return 0;
+    mid->hit_suffix_len = len;
+
+    nonce_prefix_init(&mid->nonce_prefix, miner_address, prev_block_date, elapsed);
+
+    sha256_init(&mid->hit_prefix);
+    sha256_update(&mid->hit_prefix, miner_address, strlen(miner_address));
+    sha256_update(&mid->hit_prefix, "-", 1);
+    return 1;
+}
+
+// Nonces and hits for up to SHA256_MAX_LANES hashes that all have the same length
+static void nonce_hit_lanes(const attempt_midstate_t* mid, char* const* argon_hashes, size_t argon_len, int count,
+    char (*nonces)[65], uint64_t* hits) {
+    uint8_t digests[SHA256_MAX_LANES][SHA256_DIGEST_SIZE];
+    const uint8_t* msgs[SHA256_MAX_LANES];
 
-    mpz_t value;
-    mpz_init_set_str(value, hash_part_hex, 16);
+    // nonce = sha256(prefix + argon)
+    for (int k = 0; k < count; k++) msgs[k] = (const uint8_t*)argon_hashes[k];
+    sha256_finish_multi(&mid->nonce_prefix, msgs, argon_len, count, digests);
 
-    if (mpz_cmp_ui(value, 0) == 0) {
-        mpz_set_ui(value, 1); // Avoid division by zero
+    // hit = f(sha256(sha256(address- + nonce + -height-difficulty)))
+    char tails[SHA256_MAX_LANES][64 + HIT_SUFFIX_MAX];
+    for (int k = 0; k < count; k++) {
+        digest_to_hex(digests[k], nonces[k]);
+        memcpy(tails[k], nonces[k], 64);
+        memcpy(tails[k] + 64, mid->hit_suffix, mid->hit_suffix_len);
+        msgs[k] = (const uint8_t*)tails[k];
     }
+    sha256_finish_multi(&mid->hit_prefix, msgs, 64 + mid->hit_suffix_len, count, digests);
 
-    // result = ("ffffffff" * BLOCK_TARGET_MUL) / value
-    mpz_t ffffffff;
-    mpz_init_set_str(ffffffff, "ffffffff", 16);
+    sha256_ctx empty;
+    sha256_init(&empty);
+    for (int k = 0; k < count; k++) msgs[k] = digests[k];
+    uint8_t final[SHA256_MAX_LANES][SHA256_DIGEST_SIZE];
+    sha256_finish_multi(&empty, msgs, SHA256_DIGEST_SIZE, count, final);
+    for (int k = 0; k < count; k++) hits[k] = hit_from_digest(final[k]);
+}
 
-    mpz_t numerator;
-    mpz_init(numerator);
-    mpz_mul_ui(numerator, ffffffff, BLOCK_TARGET_MUL);
+void calculate_nonce_hit_batch(const attempt_midstate_t* mid, char* const* argon_hashes, int count,
+    char (*nonces)[65], uint64_t* hits) {
+    int k = 0;
+    while (k < count) {
+        // Group consecutive hashes of equal length; encoded hashes of one job normally all match
+        size_t argon_len = strlen(argon_hashes[k]);
+        int n = 1;
+        while (k + n < count && n < SHA256_MAX_LANES && strlen(argon_hashes[k + n]) == argon_len) n++;
+        nonce_hit_lanes(mid, argon_hashes + k, argon_len, n, nonces + k, hits + k);
+        k += n;
+    }
+}
 
-    mpz_fdiv_q(result, numerator, value);
+int difficulty_to_u64(const mpz_t difficulty, uint64_t* result) {
+    if (mpz_sgn(difficulty) < 0 || mpz_sizeinbase(difficulty, 2) > 64) {
+        return 0;
+    }
+    *result = mpz_get_ui(difficulty);
+    return 1;
+}
 
-    // Clean up
-    mpz_clear(value);
-    mpz_clear(ffffffff);
-    mpz_clear(numerator);
+mining_u128_t calculate_target_u128(int elapsed, uint64_t difficulty) {
+    if (elapsed <= 0) {
+        return 0;
+    }
+    // difficulty * BLOCK_TIME cannot overflow 128 bits for a 64-bit difficulty
+    return (mining_u128_t)difficulty * BLOCK_TIME / (unsigned)elapsed;
 }
 
 void calculate_target(mpz_t result, int elapsed, const mpz_t difficulty) {
@@ -167,3 +570,85 @@ void calculate_target(mpz_t result, int elapsed, const mpz_t difficulty) {
 
     mpz_clear(numerator);
 }
+
+void u128_to_str(mining_u128_t value, char* buffer, size_t buffer_len) {
+    char digits[40];
+    int n = 0;
+    do {
+        digits[n++] = '0' + (int)(value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    size_t i = 0;
+    for (; i + 1 < buffer_len && n > 0; i++) {
+        buffer[i] = digits[--n];
+    }
+    if (buffer_len > 0) buffer[i] = '\0';
+}
+
+void u128_to_mpz(mpz_t result, mining_u128_t value) {
+    mpz_set_ui(result, (uint64_t)(value >> 64));
+    mpz_mul_2exp(result, result, 64);
+    mpz_add_ui(result, result, (uint64_t)value);
+}
+
+// --- Attempts: Nonces and Hits ---
+
+// Clamps a GMP value to 128 bits; hits are far below the clamp, so comparisons stay exact
+static mining_u128_t mpz_to_u128_saturated(const mpz_t value) {
+    if (mpz_sgn(value) <= 0) return 0;
+    if (mpz_sizeinbase(value, 2) > 128) return ~(mining_u128_t)0;
+    uint64_t words[2] = { 0, 0 };
+    mpz_export(words, NULL, -1, sizeof(uint64_t), 0, 0, value);
+    return ((mining_u128_t)words[1] << 64) | words[0];
+}
+
+int attempt_job_prepare(attempt_job_t* job, const char* miner_address, long prev_block_date, int elapsed,
+    long height, const mpz_t difficulty) {
+    if (!attempt_job_prepare_argon(job, miner_address, prev_block_date, elapsed, height)) return 0;
+
+    char difficulty_str[HIT_SUFFIX_MAX];
+    if (mpz_sizeinbase(difficulty, 10) + 2 > sizeof(difficulty_str)) return 0;
+    mpz_get_str(difficulty_str, 10, difficulty);
+    if (!attempt_midstate_init(&job->midstate, miner_address, prev_block_date, elapsed, height, difficulty_str)) return 0;
+
+    // The target stays in plain integers unless the difficulty is wider than 64 bits
+    uint64_t difficulty64;
+    if (difficulty_to_u64(difficulty, &difficulty64)) {
+        job->target = calculate_target_u128(elapsed, difficulty64);
+    } else {
+        mpz_t target;
+        mpz_init(target);
+        calculate_target(target, elapsed, difficulty);
+        job->target = mpz_to_u128_saturated(target);
+        mpz_clear(target);
+    }
+    return 1;
+}
+
+void attempt_finish_batch(const attempt_job_t* job, attempt_result_t* out, int count) {
+    char* argon_hashes[ARGON2_MAX_INTERLEAVE];
+    char nonces[ARGON2_MAX_INTERLEAVE][65];
+    uint64_t hits[ARGON2_MAX_INTERLEAVE];
+    for (int k = 0; k < count; k++) argon_hashes[k] = out[k].argon;
+    calculate_nonce_hit_batch(&job->midstate, argon_hashes, count, nonces, hits);
+
+    for (int k = 0; k < count; k++) {
+        memcpy(out[k].nonce, nonces[k], sizeof(out[k].nonce));
+        out[k].hit = hits[k];
+        // The target is 0 at elapsed 0, and nodes only take a hit above a positive target
+        out[k].is_solution = job->elapsed > 0 && hits[k] > job->target;
+    }
+}
+
+int mine_attempt_batch(const attempt_job_t* job, attempt_scratch_t* scratch, uint64_t first_nonce, int count,
+    attempt_result_t* out) {
+    int made = attempt_argon_batch(job, scratch, first_nonce, count, out);
+    if (made != count) return made;
+    attempt_finish_batch(job, out, count);
+    return count;
+}
+
+int mine_attempt(const attempt_job_t* job, attempt_scratch_t* scratch, uint64_t nonce, attempt_result_t* out) {
+    return mine_attempt_batch(job, scratch, nonce, 1, out);
+}
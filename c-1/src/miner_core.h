@@ -3,7 +3,12 @@
 
 #include <gmp.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <time.h>
+#include "argon2i_kernel.h"
+#include "sha256.h"
 
 // To hold a found block solution
 typedef struct {
@@ -15,6 +20,7 @@ typedef struct {
     mpz_t hit;
     mpz_t target;
     int elapsed;
+    struct timespec found_at; // CLOCK_MONOTONIC time the hit was found
 } solution_t;
 
 // Constants from the PHPCoin source
@@ -26,6 +32,77 @@ typedef struct {
 #define ARGON2_T_COST 2
 #define ARGON2_M_COST 32768 // 32 MiB
 #define ARGON2_PARALLELISM 1
+#define ARGON2_HASH_LEN 32
+#define ARGON2_SALT_LEN 16
+
+// Hits always fit in 64 bits; targets for any 64-bit difficulty fit in 128 bits
+typedef unsigned __int128 mining_u128_t;
+
+// Size of the Argon2 block matrix for the modern parameters, in bytes.
+#define ARGON2_ARENA_SIZE ((size_t)ARGON2_M_COST * 1024)
+
+// Page sizes to ask for when mapping arenas. Each choice falls back to the next one.
+typedef enum {
+    ARGON2_PAGES_HUGETLB, // Explicit huge pages from the pool reserved with vm.nr_hugepages
+    ARGON2_PAGES_THP,     // Transparent huge pages, requested with madvise
+    ARGON2_PAGES_SMALL,   // Base pages only; THP is turned off for the arena
+} argon2_pages_t;
+
+// A per-thread, process-lifetime memory region backing the Argon2 block matrix.
+typedef struct {
+    uint8_t* base;
+    size_t size;
+    atomic_int prefaulted;  // Set by the owning thread once every page is in
+    argon2_pages_t pages;   // What the mapping was created with
+    void* map_base;         // The whole mapping, which may start below `base`
+    size_t map_size;
+} argon2_arena_t;
+
+/**
+ * @brief Selects the page size for arenas created afterwards. The default is ARGON2_PAGES_HUGETLB.
+ */
+void argon2_arena_set_pages(argon2_pages_t pages);
+
+/**
+ * @brief Parses "hugetlb", "thp" or "off".
+ *
+ * @return 1 on success, 0 if the name is unknown.
+ */
+int argon2_pages_parse(const char* name, argon2_pages_t* pages);
+
+/**
+ * @brief Reserves an Argon2 arena of the given size.
+ *
+ * The memory is mapped but not touched; the owning thread faults it in with
+ * `argon2_arena_bind`, which first binds it to that thread's NUMA node.
+ *
+ * @param arena The arena to initialize.
+ * @param size The size in bytes (normally ARGON2_ARENA_SIZE).
+ * @return 1 on success, 0 on failure.
+ */
+int argon2_arena_init(argon2_arena_t* arena, size_t size);
+
+/**
+ * @brief Releases the memory of an arena created by `argon2_arena_init`.
+ */
+void argon2_arena_destroy(argon2_arena_t* arena);
+
+/**
+ * @brief Makes `arena` the block memory used by `calculate_argon_hash` on the calling thread.
+ *
+ * On first use the arena is bound to the NUMA node the thread runs on (preferred, so a
+ * full node spills over instead of failing) and pre-faulted. Passing NULL unbinds the
+ * arena, after which the calling thread falls back to a malloc/free per hash.
+ */
+void argon2_arena_bind(argon2_arena_t* arena);
+
+/**
+ * @brief Reports what a pre-faulted arena actually got from the kernel.
+ *
+ * @param huge_bytes Receives how many bytes are backed by huge pages (explicit or THP).
+ * @param node Receives the NUMA node of its first page, or -1 if unknown.
+ */
+void argon2_arena_backing(const argon2_arena_t* arena, size_t* huge_bytes, int* node);
 
 /**
  * @brief Calculates the Argon2 hash for a given time delta.
@@ -36,24 +113,94 @@ typedef struct {
  * @param elapsed The number of seconds elapsed since the previous block.
  * @return A dynamically allocated string with the encoded Argon2 hash. The caller must free this string.
  */
-#include <stdatomic.h>
 #include <sys/types.h>
 
+#define CACHE_LINE_SIZE 64
+
+// Statistics of one worker. Only the worker writes them, so counters are bumped with a
+// relaxed load and store instead of a locked read-modify-write, and any thread may read
+// them without a lock. Counters only ever grow; readers take differences.
+// Each instance starts on its own cache line, so workers next to each other in an array
+// do not slow each other down.
 typedef struct {
-    int id;
-    pid_t pid;
-    long height;
-    int elapsed;
-    double speed;
-    mpz_t hit;
-    mpz_t best_hit;
-    mpz_t target;
-    uint64_t local_hashes;
-    pthread_mutex_t stat_mutex;
+    _Alignas(CACHE_LINE_SIZE) int id;
+    atomic_int pid;
+    atomic_long height;
+    atomic_int elapsed;
+    atomic_uint_fast64_t hashes;
+    atomic_uint_fast64_t hit;
+    atomic_uint_fast64_t best_hit;
+    atomic_uint_fast64_t job_switches;
+    atomic_uint_fast64_t aborted; // Hashes abandoned part-way because their job went stale
+    atomic_long page_faults;
+    // The 128-bit target behind a sequence counter, odd while it is being written
+    atomic_uint target_seq;
+    atomic_uint_fast64_t target_lo;
+    atomic_uint_fast64_t target_hi;
 } thread_stats_t;
 
+// A counter that may be read by any thread but is bumped by one thread at a time
+// (or under a lock), on its own cache line
+typedef struct {
+    _Alignas(CACHE_LINE_SIZE) atomic_uint_fast64_t value;
+} padded_counter_t;
+
+static inline void stat_add(atomic_uint_fast64_t* counter, uint64_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n, memory_order_relaxed);
+}
+
+static inline uint64_t stat_get(atomic_uint_fast64_t* counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+static inline void counter_add(padded_counter_t* counter, uint64_t n) {
+    stat_add(&counter->value, n);
+}
+
+static inline uint64_t counter_get(padded_counter_t* counter) {
+    return stat_get(&counter->value);
+}
+
+static inline void stats_set_target(thread_stats_t* stats, mining_u128_t target) {
+    unsigned seq = atomic_load_explicit(&stats->target_seq, memory_order_relaxed);
+    atomic_store_explicit(&stats->target_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&stats->target_lo, (uint64_t)target, memory_order_relaxed);
+    atomic_store_explicit(&stats->target_hi, (uint64_t)(target >> 64), memory_order_relaxed);
+    atomic_store_explicit(&stats->target_seq, seq + 2, memory_order_release);
+}
+
+static inline mining_u128_t stats_get_target(thread_stats_t* stats) {
+    unsigned before, after;
+    uint64_t lo, hi;
+    do {
+        before = atomic_load_explicit(&stats->target_seq, memory_order_acquire);
+        lo = atomic_load_explicit(&stats->target_lo, memory_order_relaxed);
+        hi = atomic_load_explicit(&stats->target_hi, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&stats->target_seq, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return ((mining_u128_t)hi << 64) | lo;
+}
+
 char* calculate_argon_hash(const char* miner_address, long prev_block_date, int elapsed, long height, uint64_t nonce);
 
+/**
+ * @brief Calculates the Argon2 hashes for `count` consecutive nonces in one interleaved fill.
+ *
+ * Equivalent to calling `calculate_argon_hash` for `first_nonce` .. `first_nonce + count - 1`,
+ * but the built-in kernels advance all candidates in lockstep so memory latency overlaps.
+ * The bound arena must hold `count` block matrices, otherwise memory is allocated per call.
+ *
+ * @param argon_hashes Receives `count` dynamically allocated strings. The caller must free them.
+ * @param count Number of candidates (1..ARGON2_MAX_INTERLEAVE).
+ * @return `count` on success, 0 on failure, ARGON2_KERNEL_CANCELLED if the calling thread's
+ *         cancellation check (see `argon2_kernel_set_cancel`) stopped it. Only a success
+ *         returns strings.
+ */
+int calculate_argon_hash_batch(const char* miner_address, long prev_block_date, int elapsed, long height,
+    uint64_t first_nonce, int count, char** argon_hashes);
+
 /**
  * @brief Calculates the nonce for a block attempt.
  *
@@ -67,6 +214,42 @@ char* calculate_argon_hash(const char* miner_address, long prev_block_date, int
  */
 char* calculate_nonce(const char* miner_address, long prev_block_date, int elapsed, const char* argon_hash);
 
+// Room for "-<height>-<difficulty>" with a difficulty of up to 64 digits
+#define HIT_SUFFIX_MAX 96
+
+// The parts of the nonce and hit messages that stay the same for every attempt at
+// one job and elapsed value, with the constant prefixes already absorbed into SHA-256.
+typedef struct {
+    sha256_ctx nonce_prefix; // CHAIN_ID + address + "-<date>-<elapsed>-"
+    sha256_ctx hit_prefix;   // address + "-"
+    char hit_suffix[HIT_SUFFIX_MAX];
+    size_t hit_suffix_len;
+} attempt_midstate_t;
+
+/**
+ * @brief Precomputes the nonce and hit message prefixes for a job and elapsed value.
+ *
+ * @param difficulty_str The difficulty in decimal, as the node reports it.
+ * @return 1 on success, 0 if the difficulty is too long for the suffix buffer.
+ */
+int attempt_midstate_init(attempt_midstate_t* mid, const char* miner_address, long prev_block_date, int elapsed,
+    long height, const char* difficulty_str);
+
+/**
+ * @brief Calculates the nonces and hits of several Argon2 hashes from a shared midstate.
+ *
+ * Equivalent to `calculate_nonce` followed by `calculate_hit_u64` for each hash, but only
+ * the per-attempt bytes are hashed, and candidates of equal length go through the
+ * multi-buffer SHA-256 path together.
+ *
+ * @param argon_hashes The encoded Argon2 hashes of the attempts.
+ * @param count Number of attempts.
+ * @param nonces Receives the NUL-terminated hex nonce of each attempt.
+ * @param hits Receives the hit of each attempt.
+ */
+void calculate_nonce_hit_batch(const attempt_midstate_t* mid, char* const* argon_hashes, int count,
+    char (*nonces)[65], uint64_t* hits);
+
 /**
  * @brief Calculates the "hit" value for a mining attempt.
  *
@@ -91,5 +274,160 @@ void calculate_hit(mpz_t result, const char* miner_address, const char* nonce, l
  */
 void calculate_target(mpz_t result, int elapsed, const mpz_t difficulty);
 
+// Returns the largest hit the hit function can produce for blocks at `height`
+typedef uint64_t (*max_hit_fn)(long height);
+
+/**
+ * @brief Replaces the bound `calculate_max_hit` reports, for a hit function that differs from
+ * `calculate_hit`. NULL restores the default. Set it before any thread mines.
+ */
+void set_max_hit_hook(max_hit_fn hook);
+
+/**
+ * @brief The largest hit that can be found at `height`: `0xffffffff * BLOCK_TARGET_MUL` unless
+ * a hook says otherwise.
+ */
+uint64_t calculate_max_hit(long height);
+
+/**
+ * @brief The earliest elapsed second at which a hit can beat the target.
+ *
+ * The target falls as elapsed grows, so until then it is above `calculate_max_hit` and every
+ * attempt is wasted. Never less than 1, since nothing wins at elapsed 0, and at most INT_MAX.
+ */
+long calculate_first_winnable_elapsed(const mpz_t difficulty, long height);
+
+/**
+ * @brief Integer fast path of `calculate_hit`.
+ *
+ * The hit is `0xffffffff * BLOCK_TARGET_MUL / value` for a 32-bit value, so it always fits in 64 bits.
+ *
+ * @param difficulty_str The difficulty in decimal, as the node reports it.
+ * @return The hit value, identical to what `calculate_hit` stores.
+ */
+uint64_t calculate_hit_u64(const char* miner_address, const char* nonce, long height, const char* difficulty_str);
+
+/**
+ * @brief Converts a difficulty to 64 bits for the integer fast path.
+ *
+ * @return 1 if it fits, 0 if the caller must stay on the GMP path.
+ */
+int difficulty_to_u64(const mpz_t difficulty, uint64_t* result);
+
+/**
+ * @brief Integer fast path of `calculate_target` for a difficulty that fits in 64 bits.
+ */
+mining_u128_t calculate_target_u128(int elapsed, uint64_t difficulty);
+
+/**
+ * @brief Formats a 128-bit value in decimal.
+ */
+void u128_to_str(mining_u128_t value, char* buffer, size_t buffer_len);
+
+/**
+ * @brief Stores a 128-bit value in an initialized mpz_t.
+ */
+void u128_to_mpz(mpz_t result, mining_u128_t value);
+
+// Room for "<date>-<elapsed>-"; the attempts append a nonce of up to 20 digits
+#define ATTEMPT_PWD_PREFIX_MAX 48
+
+// A job prepared for mining at one elapsed value: the Argon2 parameters, the constant parts
+// of the password, salt and encoded hash, the nonce and hit midstates and the target.
+// Preparing one may allocate and use GMP; attempts only read it, so threads can share it.
+typedef struct {
+    long prev_block_date;
+    int elapsed;
+    uint32_t t_cost;
+    uint32_t m_cost;
+    uint32_t parallelism;
+    bool legacy;                     // Salted with the address, before UPDATE_3_ARGON_HARD
+    uint8_t legacy_salt[ARGON2_SALT_LEN];
+    char pwd_prefix[ATTEMPT_PWD_PREFIX_MAX]; // "<date>-<elapsed>-"
+    size_t pwd_prefix_len;
+    sha256_ctx salt_prefix;          // address + "-<height>-"
+    char encoded_prefix[48];         // "$argon2i$v=19$m=<m>,t=<t>,p=<p>$"
+    size_t encoded_prefix_len;
+    attempt_midstate_t midstate;
+    mining_u128_t target;            // Clamped to 128 bits, which no hit can reach
+} attempt_job_t;
+
+// Per-thread buffers of the attempts, owned by the caller
+typedef struct {
+    argon2_arena_t* arena;           // Block memory for the fills, NULL for the one bound to the thread
+    char pwds[ARGON2_MAX_INTERLEAVE][ATTEMPT_PWD_PREFIX_MAX + 20];
+    size_t pwd_lens[ARGON2_MAX_INTERLEAVE];
+    uint8_t salts[ARGON2_MAX_INTERLEAVE][ARGON2_SALT_LEN];
+    uint8_t raw_hashes[ARGON2_MAX_INTERLEAVE][ARGON2_HASH_LEN];
+    int argon2_error;                // libargon2 code of the last failed fill, ARGON2_OK if none
+} attempt_scratch_t;
+
+// Longest encoded Argon2 hash of either parameter set, with the terminating NUL
+#define ARGON2_ENCODED_MAX 128
+
+// What one attempt produced
+typedef struct {
+    char argon[ARGON2_ENCODED_MAX];  // Encoded like PHP's password_hash
+    char nonce[65];
+    uint64_t hit;
+    bool is_solution;
+} attempt_result_t;
+
+/**
+ * @brief Prepares a job for the attempts at one elapsed value.
+ *
+ * @return 1 on success, 0 if the difficulty is too long for the hit suffix.
+ */
+int attempt_job_prepare(attempt_job_t* job, const char* miner_address, long prev_block_date, int elapsed,
+    long height, const mpz_t difficulty);
+
+/**
+ * @brief Sets up the scratch of a thread.
+ *
+ * @param arena The block memory, faulted in with `argon2_arena_bind` by the same thread, or
+ *              NULL to use whatever arena the thread has bound. It must hold one block matrix
+ *              per candidate of a batch, otherwise memory is allocated per fill.
+ */
+void attempt_scratch_init(attempt_scratch_t* scratch, argon2_arena_t* arena);
+
+/**
+ * @brief Describes why the last fill of `scratch` failed.
+ */
+const char* attempt_error_message(const attempt_scratch_t* scratch);
+
+/**
+ * @brief Makes one attempt: Argon2 hash, nonce, hit and the comparison with the target.
+ *
+ * Does not allocate, print or use GMP as long as the arena of `scratch` is large enough.
+ * The output is identical to `calculate_argon_hash`, `calculate_nonce`, `calculate_hit`
+ * and `calculate_target` for the same inputs.
+ *
+ * @return 1 on success, 0 on failure (see `argon2_error`), ARGON2_KERNEL_CANCELLED if the
+ *         calling thread's cancellation check stopped the fill.
+ */
+int mine_attempt(const attempt_job_t* job, attempt_scratch_t* scratch, uint64_t nonce, attempt_result_t* out);
+
+/**
+ * @brief Makes the attempts for `count` consecutive nonces, their Argon2 hashes in one interleaved fill.
+ *
+ * @param count Number of candidates (1..ARGON2_MAX_INTERLEAVE).
+ * @return `count` on success, otherwise as `mine_attempt`.
+ */
+int mine_attempt_batch(const attempt_job_t* job, attempt_scratch_t* scratch, uint64_t first_nonce, int count,
+    attempt_result_t* out);
+
+/**
+ * @brief The first half of `mine_attempt_batch`: fills in only the `argon` of each result.
+ */
+int attempt_argon_batch(const attempt_job_t* job, attempt_scratch_t* scratch, uint64_t first_nonce, int count,
+    attempt_result_t* out);
+
+/**
+ * @brief The second half of `mine_attempt_batch`: the nonces, hits and verdicts of hashed results.
+ *
+ * @param count Number of results (1..ARGON2_MAX_INTERLEAVE).
+ */
+void attempt_finish_batch(const attempt_job_t* job, attempt_result_t* out, int count);
+
 
 #endif // MINER_CORE_H
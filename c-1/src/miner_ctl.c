@@ -0,0 +1,73 @@
+// miner_ctl: sends one command to a running c_miner over its control socket and prints
+// the reply. Exits with status 1 if the miner cannot be reached or reports an error.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "control.h"
+
+static void print_usage(const char* prog_name) {
+    fprintf(stderr, "Usage: %s [--socket <path>] <command>\n", prog_name);
+    fprintf(stderr, "Commands:\n");
+    fprintf(stderr, "  stats                          Settings, counters and per-thread hashes\n");
+    fprintf(stderr, "  set threads <n>                Run n workers, parking or starting the others\n");
+    fprintf(stderr, "  set cpu <1-100>                CPU share of each worker\n");
+    fprintf(stderr, "  set lanes <1-4>                Candidates each worker hashes at once\n");
+    fprintf(stderr, "  set report-interval <seconds>  Interval of the stats output\n");
+    fprintf(stderr, "  set nodes <url[,url...]>       Mine against these nodes, the first one first\n");
+}
+
+int main(int argc, char** argv) {
+    const char* path = CONTROL_DEFAULT_PATH;
+    int first = 1;
+    if (argc > 2 && (strcmp(argv[1], "--socket") == 0 || strcmp(argv[1], "-s") == 0)) {
+        path = argv[2];
+        first = 3;
+    }
+    if (first >= argc || strcmp(argv[first], "--help") == 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    char command[CONTROL_COMMAND_MAX + 1];
+    size_t len = 0;
+    for (int i = first; i < argc; i++) {
+        int written = snprintf(command + len, sizeof(command) - len, "%s%s", i > first ? " " : "", argv[i]);
+        if (written < 0 || (size_t)written >= sizeof(command) - len - 1) {
+            fprintf(stderr, "The command is too long.\n");
+            return EXIT_FAILURE;
+        }
+        len += written;
+    }
+    command[len++] = '\n';
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "Cannot connect to the miner at %s: ", path);
+        perror(NULL);
+        return EXIT_FAILURE;
+    }
+    if (write(fd, command, len) != (ssize_t)len) {
+        perror("Failed to send the command");
+        return EXIT_FAILURE;
+    }
+    shutdown(fd, SHUT_WR);
+
+    char reply[CONTROL_REPLY_MAX + 1];
+    size_t reply_len = 0;
+    ssize_t got;
+    while (reply_len < CONTROL_REPLY_MAX && (got = read(fd, reply + reply_len, CONTROL_REPLY_MAX - reply_len)) > 0) {
+        reply_len += got;
+    }
+    reply[reply_len] = '\0';
+    close(fd);
+
+    fputs(reply, stdout);
+    return strncmp(reply, "ok", 2) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
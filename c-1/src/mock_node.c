@@ -0,0 +1,786 @@
+// mock_node: a stand-in PHPCoin node for testing the miner end to end on one box. It serves
+// `mine.php?q=info` and `mine.php?q=submitHash` over keep-alive HTTP, produces blocks at a
+// fixed cadence, and checks submissions the way a node does, with miner_core.
+//
+// With a miner command after "--" it becomes a scenario runner: it starts the miner against
+// itself, scrapes the miner's metrics while it runs, and reports the hashes spent on blocks
+// that were already superseded, how long the workers took to move on, and how long solutions
+// took to reach the node.
+#define _GNU_SOURCE // For accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+#include <gmp.h>
+#include <argon2.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include "miner_core.h"
+#include "net.h"
+
+// Connections served at once; the miner keeps one per thread that talks to the node
+#define MOCK_MAX_CLIENTS 64
+// Largest request; a submission is well under 1 KiB
+#define MOCK_REQUEST_MAX 8192
+#define MOCK_RESPONSE_MAX 4096
+// Interval of the metrics scrapes, which bounds the resolution of the scenario numbers
+#define SCRAPE_MS 10
+// Most worker threads the scenario tracks
+#define SCRAPE_MAX_THREADS 256
+// Time the miner gets to exit after the scenario before it is killed
+#define MINER_EXIT_TIMEOUT_S 15
+
+static atomic_bool exit_requested = ATOMIC_VAR_INIT(false);
+
+static double seconds_between(const struct timespec* start, const struct timespec* end) {
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static uint32_t usec_between(const struct timespec* start, const struct timespec* end) {
+    double usec = seconds_between(start, end) * 1e6;
+    return usec > 0 ? (uint32_t)usec : 0;
+}
+
+static void print_latency(const char* label, net_latency_t* latency) {
+    static const double percentiles[3] = { 50, 90, 99 };
+    double ms[3];
+    int samples = net_latency_percentiles(latency, percentiles, ms, 3);
+    if (samples == 0) {
+        printf("%s p50/p90/p99: no samples\n", label);
+    } else {
+        printf("%s p50/p90/p99: %.1f/%.1f/%.1f ms (%d samples)\n", label, ms[0], ms[1], ms[2], samples);
+    }
+}
+
+
+// --- Chain ---
+
+typedef struct {
+    int port;
+    const char* difficulty;
+    double block_interval; // Seconds between blocks nobody submitted; 0 for none
+    int latency_ms;        // Added to every answer
+    int error_rate;        // Percent of requests answered with a 503
+} mock_config_t;
+
+// The node's view of the chain. The server thread owns it; the scenario scraper reads
+// the tip under `mutex`.
+typedef struct {
+    pthread_mutex_t mutex;
+    long height;
+    long date;
+    char block_id[32];
+    mpz_t difficulty;
+    struct timespec published; // CLOCK_MONOTONIC time the tip appeared
+    uint64_t seq;              // Bumped for every new tip
+    bool polled;               // The tip has been handed out by an info request
+
+    uint64_t blocks;
+    uint64_t blocks_found; // Tips that came from an accepted submission
+    uint64_t infos;
+    uint64_t submits;
+    uint64_t accepted;
+    uint64_t stale;
+    uint64_t invalid;
+    uint64_t errors_injected;
+    // Time from a tip appearing to the first info answer that hands it out
+    net_latency_t poll_delay;
+    // Time from a submission arriving to its answer being sent, including --latency
+    net_latency_t submit_answer;
+} mock_chain_t;
+
+static mock_chain_t chain = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .poll_delay = { .mutex = PTHREAD_MUTEX_INITIALIZER },
+    .submit_answer = { .mutex = PTHREAD_MUTEX_INITIALIZER },
+};
+
+static void chain_new_block(bool found) {
+    pthread_mutex_lock(&chain.mutex);
+    chain.height++;
+    chain.date = time(NULL);
+    snprintf(chain.block_id, sizeof(chain.block_id), "mock%ld", chain.height);
+    clock_gettime(CLOCK_MONOTONIC, &chain.published);
+    chain.seq++;
+    chain.polled = false;
+    chain.blocks++;
+    if (found) chain.blocks_found++;
+    pthread_mutex_unlock(&chain.mutex);
+    printf("Block %ld (%s)\n", chain.height, found ? "submitted" : "cadence");
+    fflush(stdout);
+}
+
+static void answer_info(char* body, size_t len) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pthread_mutex_lock(&chain.mutex);
+    chain.infos++;
+    if (!chain.polled) {
+        net_latency_record(&chain.poll_delay, usec_between(&chain.published, &now));
+        chain.polled = true;
+    }
+    pthread_mutex_unlock(&chain.mutex);
+    gmp_snprintf(body, len,
+        "{\"status\":\"ok\",\"data\":{\"height\":%ld,\"difficulty\":\"%Zd\",\"block\":\"%s\",\"date\":%ld,\"time\":%ld},\"coin\":\"phpcoin\"}",
+        chain.height, chain.difficulty, chain.block_id, chain.date, (long)time(NULL));
+}
+
+// Decodes an application/x-www-form-urlencoded value in place, like PHP's $_POST
+static void form_decode(char* value) {
+    char* out = value;
+    for (char* in = value; *in; in++) {
+        if (*in == '+') {
+            *out++ = ' ';
+        } else if (*in == '%' && in[1] && in[2]) {
+            char hex[3] = { in[1], in[2], 0 };
+            *out++ = (char)strtol(hex, NULL, 16);
+            in += 2;
+        } else {
+            *out++ = *in;
+        }
+    }
+    *out = '\0';
+}
+
+#define SUBMIT_FIELDS 9
+static const char* const submit_fields[SUBMIT_FIELDS] = {
+    "argon", "nonce", "height", "difficulty", "address", "hit", "target", "date", "elapsed"
+};
+
+// Splits a form body into the submission fields. Returns the name of the first missing one.
+static const char* parse_submit_form(char* form, char** values) {
+    for (int i = 0; i < SUBMIT_FIELDS; i++) values[i] = NULL;
+    for (char* pair = strtok(form, "&"); pair; pair = strtok(NULL, "&")) {
+        char* eq = strchr(pair, '=');
+        if (!eq) continue;
+        *eq = '\0';
+        for (int i = 0; i < SUBMIT_FIELDS; i++) {
+            if (strcmp(pair, submit_fields[i]) == 0) {
+                form_decode(eq + 1);
+                values[i] = eq + 1;
+            }
+        }
+    }
+    for (int i = 0; i < SUBMIT_FIELDS; i++) {
+        if (!values[i]) return submit_fields[i];
+    }
+    return NULL;
+}
+
+// Checks a submission against the tip the way a node's mine.php does: the block must go on
+// the tip, and the nonce, hit and target must follow from the Argon2 hash. The hash itself
+// is only checked for its parameters; recomputing it needs the attempt's password.
+// Returns NULL if the block is valid, otherwise the reason and whether it was just late.
+static const char* check_submission(char** values, bool* stale) {
+    enum { ARGON, NONCE, HEIGHT, DIFFICULTY, ADDRESS, HIT, TARGET, DATE, ELAPSED };
+    *stale = false;
+    long height = atol(values[HEIGHT]);
+    if (height <= chain.height) {
+        *stale = true;
+        return "The block is stale";
+    }
+    if (height != chain.height + 1) return "Invalid height";
+
+    mpz_t difficulty, hit, target, submitted;
+    mpz_inits(difficulty, hit, target, submitted, NULL);
+    const char* reason = NULL;
+    int elapsed = atoi(values[ELAPSED]);
+    char argon_prefix[64];
+    snprintf(argon_prefix, sizeof(argon_prefix), "$argon2i$v=%d$m=%d,t=%d,p=%d$",
+        ARGON2_VERSION_13, ARGON2_M_COST, ARGON2_T_COST, ARGON2_PARALLELISM);
+
+    if (mpz_set_str(difficulty, values[DIFFICULTY], 10) != 0 || mpz_cmp(difficulty, chain.difficulty) != 0) {
+        reason = "Invalid difficulty";
+    } else if (elapsed <= 0 || atol(values[DATE]) != chain.date + elapsed) {
+        reason = "Invalid date";
+    } else if (strncmp(values[ARGON], argon_prefix, strlen(argon_prefix)) != 0) {
+        reason = "Invalid argon hash";
+    } else {
+        char* nonce = calculate_nonce(values[ADDRESS], chain.date, elapsed, values[ARGON]);
+        if (!nonce || strcmp(nonce, values[NONCE]) != 0) {
+            reason = "Invalid nonce";
+        } else {
+            calculate_hit(hit, values[ADDRESS], nonce, height, difficulty);
+            calculate_target(target, elapsed, difficulty);
+            if (mpz_set_str(submitted, values[HIT], 10) != 0 || mpz_cmp(submitted, hit) != 0) {
+                reason = "Invalid hit";
+            } else if (mpz_set_str(submitted, values[TARGET], 10) != 0 || mpz_cmp(submitted, target) != 0) {
+                reason = "Invalid target";
+            } else if (mpz_sgn(target) <= 0 || mpz_cmp(hit, target) <= 0) {
+                reason = "The hit is not above the target";
+            }
+        }
+        free(nonce);
+    }
+    mpz_clears(difficulty, hit, target, submitted, NULL);
+    return reason;
+}
+
+static void answer_submit(char* form, char* body, size_t len) {
+    char* values[SUBMIT_FIELDS];
+    const char* missing = parse_submit_form(form, values);
+    bool stale = false;
+    const char* reason = missing ? "Missing field" : check_submission(values, &stale);
+
+    pthread_mutex_lock(&chain.mutex);
+    chain.submits++;
+    if (!reason) {
+        chain.accepted++;
+    } else if (stale) {
+        chain.stale++;
+    } else {
+        chain.invalid++;
+    }
+    pthread_mutex_unlock(&chain.mutex);
+
+    if (reason) {
+        printf("Rejected a submission for height %s: %s%s%s\n", values[2] ? values[2] : "?", reason,
+            missing ? " " : "", missing ? missing : "");
+        snprintf(body, len, "{\"status\":\"error\",\"data\":\"%s\",\"coin\":\"phpcoin\"}", reason);
+    } else {
+        printf("Accepted a block at height %s, elapsed %s\n", values[2], values[8]);
+        chain_new_block(true);
+        snprintf(body, len, "{\"status\":\"ok\",\"data\":\"accepted\",\"coin\":\"phpcoin\"}");
+    }
+    fflush(stdout);
+}
+
+
+// --- HTTP Server ---
+
+typedef struct {
+    int fd; // -1 when the slot is free
+    char request[MOCK_REQUEST_MAX + 1];
+    size_t request_len;
+    size_t consumed;          // Bytes of `request` the pending answer is for
+    char response[MOCK_RESPONSE_MAX];
+    size_t response_len;      // 0 while no answer is pending
+    size_t response_sent;
+    bool submit;
+    struct timespec arrived;
+    struct timespec due;      // The answer goes out after the injected latency
+} mock_client_t;
+
+static int server_open(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("Failed to create the node socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0) {
+        perror("Failed to listen on the node port");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void respond(mock_client_t* client, int status, const char* reason, const char* body) {
+    client->response_len = snprintf(client->response, sizeof(client->response),
+        "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: keep-alive\r\n\r\n%s",
+        status, reason, strlen(body), body);
+    if (client->response_len >= sizeof(client->response)) client->response_len = sizeof(client->response) - 1;
+    client->response_sent = 0;
+}
+
+// Answers the request at the start of the client's buffer once it has fully arrived.
+// Returns 0 if the connection must be closed.
+static int handle_request(mock_client_t* client, const mock_config_t* config) {
+    char* header_end = strstr(client->request, "\r\n\r\n");
+    if (!header_end) return client->request_len < MOCK_REQUEST_MAX;
+    size_t header_len = header_end + 4 - client->request;
+    size_t content_length = 0;
+    char* length = strcasestr(client->request, "\r\nContent-Length:");
+    if (length && length < header_end) content_length = strtoul(length + 17, NULL, 10);
+    if (header_len + content_length > MOCK_REQUEST_MAX) return 0;
+    if (client->request_len < header_len + content_length) return 1;
+
+    client->consumed = header_len + content_length;
+    clock_gettime(CLOCK_MONOTONIC, &client->arrived);
+    client->due = client->arrived;
+    client->due.tv_nsec += (long)config->latency_ms * 1000000L;
+    client->due.tv_sec += client->due.tv_nsec / 1000000000L;
+    client->due.tv_nsec %= 1000000000L;
+
+    char path[256] = "";
+    sscanf(client->request, "%*s %255s", path);
+    client->submit = strstr(path, "mine.php?q=submitHash") != NULL;
+    char body[MOCK_RESPONSE_MAX - 256];
+    if (config->error_rate > 0 && rand() % 100 < config->error_rate) {
+        pthread_mutex_lock(&chain.mutex);
+        chain.errors_injected++;
+        pthread_mutex_unlock(&chain.mutex);
+        respond(client, 503, "Service Unavailable", "<html><body>Service Unavailable</body></html>");
+    } else if (strstr(path, "mine.php?q=info")) {
+        answer_info(body, sizeof(body));
+        respond(client, 200, "OK", body);
+    } else if (client->submit) {
+        char saved = client->request[client->consumed];
+        client->request[client->consumed] = '\0';
+        answer_submit(client->request + header_len, body, sizeof(body));
+        client->request[client->consumed] = saved;
+        respond(client, 200, "OK", body);
+    } else if (strstr(path, "api.php?q=getPeers")) {
+        respond(client, 200, "OK", "{\"status\":\"ok\",\"data\":[],\"coin\":\"phpcoin\"}");
+    } else {
+        respond(client, 404, "Not Found", "{\"status\":\"error\",\"data\":\"Not found\"}");
+    }
+    return 1;
+}
+
+// Sends what is due of the pending answer. Returns 0 if the connection must be closed.
+static int flush_response(mock_client_t* client, const struct timespec* now, const mock_config_t* config) {
+    if (seconds_between(&client->due, now) < 0) return 1;
+    while (client->response_sent < client->response_len) {
+        ssize_t written = send(client->fd, client->response + client->response_sent,
+            client->response_len - client->response_sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 1;
+        if (written <= 0) return 0;
+        client->response_sent += written;
+    }
+    if (client->submit) {
+        struct timespec sent;
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        net_latency_record(&chain.submit_answer, usec_between(&client->arrived, &sent));
+    }
+    // Keep-alive: whatever followed the request is the start of the next one
+    memmove(client->request, client->request + client->consumed, client->request_len - client->consumed);
+    client->request_len -= client->consumed;
+    client->request[client->request_len] = '\0';
+    client->response_len = 0;
+    return client->request_len == 0 || handle_request(client, config);
+}
+
+static void client_close(mock_client_t* client) {
+    close(client->fd);
+    client->fd = -1;
+}
+
+// Serves requests and produces cadence blocks for up to `timeout_ms`
+static void server_step(int listen_fd, mock_client_t* clients, const mock_config_t* config, int timeout_ms) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (config->block_interval > 0 && seconds_between(&chain.published, &now) >= config->block_interval) {
+        chain_new_block(false);
+    }
+
+    struct pollfd pfds[MOCK_MAX_CLIENTS + 1];
+    int slots[MOCK_MAX_CLIENTS + 1];
+    int n = 0;
+    pfds[n].fd = listen_fd;
+    pfds[n].events = POLLIN;
+    slots[n++] = -1;
+    for (int i = 0; i < MOCK_MAX_CLIENTS; i++) {
+        mock_client_t* client = &clients[i];
+        if (client->fd < 0) continue;
+        if (client->response_len > 0) {
+            // An answer held back by --latency wakes the loop up when it is due
+            int due_ms = (int)(seconds_between(&now, &client->due) * 1000) + 1;
+            if (due_ms > 0 && due_ms < timeout_ms) timeout_ms = due_ms;
+            if (due_ms > 0) continue;
+        }
+        pfds[n].fd = client->fd;
+        pfds[n].events = client->response_len > 0 ? POLLOUT : POLLIN;
+        slots[n++] = i;
+    }
+    if (poll(pfds, n, timeout_ms) < 0) return;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (pfds[0].revents & POLLIN) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        int slot = -1;
+        for (int i = 0; i < MOCK_MAX_CLIENTS && fd >= 0 && slot < 0; i++) {
+            if (clients[i].fd < 0) slot = i;
+        }
+        if (slot >= 0) {
+            memset(&clients[slot], 0, sizeof(clients[slot]));
+            clients[slot].fd = fd;
+        } else if (fd >= 0) {
+            close(fd);
+        }
+    }
+    for (int k = 1; k < n; k++) {
+        mock_client_t* client = &clients[slots[k]];
+        if (pfds[k].revents & POLLOUT) {
+            if (!flush_response(client, &now, config)) client_close(client);
+        } else if (pfds[k].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t got = recv(client->fd, client->request + client->request_len, MOCK_REQUEST_MAX - client->request_len, MSG_DONTWAIT);
+            if (got <= 0) {
+                if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) client_close(client);
+                continue;
+            }
+            client->request_len += got;
+            client->request[client->request_len] = '\0';
+            if (!handle_request(client, config)) client_close(client);
+        }
+    }
+}
+
+
+// --- Scenario Runner ---
+
+typedef struct {
+    int metrics_port;
+    atomic_bool stop;
+
+    // Results, owned by the scraper thread until it has been joined
+    int scrapes;
+    uint64_t hashes;
+    double stale_hashes;
+    uint64_t aborted;      // Hashes the miner abandoned part-way, as last exported
+    // Time from a tip appearing on the node to each worker hashing on top of it
+    net_latency_t switch_time;
+    // The miner's own latencies in ms, as last exported by its metrics
+    double find_to_ack_ms[3];
+    double job_switch_ms[3];
+} scenario_t;
+
+// What the scraper tracks of one worker
+typedef struct {
+    bool seen;
+    uint64_t hashes;
+    uint64_t switches;
+    bool stale;            // Still hashing on a tip the node has moved past
+    uint64_t stale_since_switches;
+    struct timespec stale_since;
+} scrape_thread_t;
+
+// Reads the per-thread counters and latency quantiles out of a metrics page
+static void parse_miner_metrics(const char* page, scenario_t* scenario, uint64_t* hashes, uint64_t* switches, bool* present) {
+    uint64_t aborted = 0;
+    for (const char* line = page; *line; ) {
+        int thread;
+        uint64_t value;
+        double quantile, seconds;
+        if (sscanf(line, "phpcoin_miner_hashes_total{thread=\"%d\"} %" SCNu64, &thread, &value) == 2
+            && thread >= 0 && thread < SCRAPE_MAX_THREADS) {
+            hashes[thread] = value;
+            present[thread] = true;
+        } else if (sscanf(line, "phpcoin_miner_job_switches_total{thread=\"%d\"} %" SCNu64, &thread, &value) == 2
+            && thread >= 0 && thread < SCRAPE_MAX_THREADS) {
+            switches[thread] = value;
+        } else if (sscanf(line, "phpcoin_miner_aborted_hashes_total{thread=\"%d\"} %" SCNu64, &thread, &value) == 2) {
+            aborted += value;
+        } else if (sscanf(line, "phpcoin_miner_find_to_ack_seconds{quantile=\"%lf\"} %lf", &quantile, &seconds) == 2) {
+            scenario->find_to_ack_ms[quantile < 0.7 ? 0 : quantile < 0.95 ? 1 : 2] = seconds * 1000;
+        } else if (sscanf(line, "phpcoin_miner_job_switch_seconds{quantile=\"%lf\"} %lf", &quantile, &seconds) == 2) {
+            scenario->job_switch_ms[quantile < 0.7 ? 0 : quantile < 0.95 ? 1 : 2] = seconds * 1000;
+        }
+        const char* next = strchr(line, '\n');
+        if (!next) break;
+        line = next + 1;
+    }
+    scenario->aborted = aborted;
+}
+
+// Scrapes the miner every SCRAPE_MS and charges each worker's hashes to the tip it was on.
+// A worker's hashes count as stale from the moment the node has a new tip until the scrape
+// that sees the worker's job switch counter move, so the numbers are upper bounds at the
+// resolution of the scrape interval.
+static void* scraper_thread(void* arg) {
+    scenario_t* scenario = arg;
+    static scrape_thread_t threads[SCRAPE_MAX_THREADS];
+    static uint64_t hashes[SCRAPE_MAX_THREADS], switches[SCRAPE_MAX_THREADS];
+    static bool present[SCRAPE_MAX_THREADS];
+    net_client_t* client = net_client_create();
+    if (!client) return NULL;
+    char url[64];
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/metrics", scenario->metrics_port);
+
+    uint64_t last_seq = 0;
+    struct timespec last_scrape = { 0, 0 };
+    while (!atomic_load(&scenario->stop)) {
+        usleep(SCRAPE_MS * 1000);
+        if (!net_get(client, url, 1L)) continue;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        memset(present, 0, sizeof(present));
+        parse_miner_metrics(client->response, scenario, hashes, switches, present);
+
+        pthread_mutex_lock(&chain.mutex);
+        uint64_t seq = chain.seq;
+        struct timespec published = chain.published;
+        pthread_mutex_unlock(&chain.mutex);
+        bool new_tip = scenario->scrapes > 0 && seq != last_seq;
+        // Share of this scrape's hashes made after the tip appeared
+        double after_tip = 1.0;
+        if (new_tip && seconds_between(&last_scrape, &now) > 0) {
+            after_tip = seconds_between(&published, &now) / seconds_between(&last_scrape, &now);
+            if (after_tip < 0) after_tip = 0;
+            if (after_tip > 1) after_tip = 1;
+        }
+
+        for (int i = 0; i < SCRAPE_MAX_THREADS; i++) {
+            scrape_thread_t* thread = &threads[i];
+            if (!present[i]) continue;
+            if (!thread->seen) {
+                thread->seen = true;
+                thread->hashes = hashes[i];
+                thread->switches = switches[i];
+                continue;
+            }
+            uint64_t delta = hashes[i] - thread->hashes;
+            scenario->hashes += delta;
+            bool newly_stale = false;
+            if (new_tip && !thread->stale) {
+                thread->stale = true;
+                thread->stale_since = published;
+                thread->stale_since_switches = thread->switches;
+                newly_stale = true;
+            }
+            if (thread->stale) {
+                scenario->stale_hashes += delta * (newly_stale ? after_tip : 1.0);
+                if (switches[i] > thread->stale_since_switches) {
+                    net_latency_record(&scenario->switch_time, usec_between(&thread->stale_since, &now));
+                    thread->stale = false;
+                }
+            }
+            thread->hashes = hashes[i];
+            thread->switches = switches[i];
+        }
+        last_seq = seq;
+        last_scrape = now;
+        scenario->scrapes++;
+    }
+    net_client_destroy(client);
+    return NULL;
+}
+
+static pid_t start_miner(char** command, int command_count, int port, int metrics_port, const char* log_path) {
+    char node[64], metrics[16];
+    snprintf(node, sizeof(node), "http://127.0.0.1:%d", port);
+    snprintf(metrics, sizeof(metrics), "%d", metrics_port);
+    char** args = calloc(command_count + 5, sizeof(char*));
+    if (!args) return -1;
+    for (int i = 0; i < command_count; i++) args[i] = command[i];
+    args[command_count] = "--node";
+    args[command_count + 1] = node;
+    args[command_count + 2] = "--metrics-port";
+    args[command_count + 3] = metrics;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int log = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log >= 0) {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+        }
+        execvp(args[0], args);
+        perror("Failed to start the miner");
+        _exit(127);
+    }
+    free(args);
+    if (pid < 0) perror("Failed to start the miner");
+    return pid;
+}
+
+// Prints quantiles scraped from the miner; negative when it exported none
+static void print_quantiles(const char* label, const double* ms) {
+    if (ms[0] < 0) {
+        printf("%s p50/p90/p99: no samples\n", label);
+    } else {
+        printf("%s p50/p90/p99: %.1f/%.1f/%.1f ms\n", label, ms[0], ms[1], ms[2]);
+    }
+}
+
+static void print_report(scenario_t* scenario, double duration) {
+    printf("\n--- Scenario ---\n");
+    gmp_printf("Duration: %.1f s, difficulty %Zd\n", duration, chain.difficulty);
+    printf("Blocks: %" PRIu64 " (%" PRIu64 " submitted by the miner)\n", chain.blocks, chain.blocks_found);
+    printf("Submissions: %" PRIu64 " (%" PRIu64 " accepted, %" PRIu64 " stale, %" PRIu64 " invalid)\n",
+        chain.submits, chain.accepted, chain.stale, chain.invalid);
+    printf("Requests: %" PRIu64 " info, %" PRIu64 " answered with an injected error\n", chain.infos, chain.errors_injected);
+    printf("Hashes: %" PRIu64 " (%.1f H/s), %.0f on stale blocks (%.2f%%)\n", scenario->hashes,
+        duration > 0 ? scenario->hashes / duration : 0, scenario->stale_hashes,
+        scenario->hashes ? 100.0 * scenario->stale_hashes / scenario->hashes : 0);
+    printf("Hashes abandoned part-way by the miner: %" PRIu64 "\n", scenario->aborted);
+    print_latency("Time-to-switch (node tip to worker)", &scenario->switch_time);
+    print_latency("  Poll delay (node tip to info answer)", &chain.poll_delay);
+    print_quantiles("  Job switch in the miner", scenario->job_switch_ms);
+    print_quantiles("Find-to-ack in the miner", scenario->find_to_ack_ms);
+    print_latency("  Node answer time", &chain.submit_answer);
+    // The node's answer time is part of the ack latency; the rest is the miner's own delay
+    static const double median[1] = { 50 };
+    double answer_ms;
+    if (scenario->find_to_ack_ms[0] >= 0 && net_latency_percentiles(&chain.submit_answer, median, &answer_ms, 1) > 0) {
+        double submit_ms = scenario->find_to_ack_ms[0] - answer_ms;
+        printf("Find-to-submit p50: %.1f ms\n", submit_ms > 0 ? submit_ms : 0);
+    }
+    if (scenario->scrapes == 0) {
+        printf("Warning: the miner's metrics could not be read; hashes and switch times are missing.\n");
+    }
+}
+
+
+// --- Main Function ---
+
+static void request_exit(int sig) {
+    (void)sig;
+    atomic_store(&exit_requested, true);
+}
+
+static void print_usage(const char* prog_name) {
+    fprintf(stderr, "Usage: %s [options] [-- <miner command...>]\n", prog_name);
+    fprintf(stderr, "Serves a mock PHPCoin node on 127.0.0.1. With a miner command, runs that miner against it\n");
+    fprintf(stderr, "(adding --node and --metrics-port) and reports stale work and latencies.\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -p, --port <port>            Node port (default: 8001)\n");
+    fprintf(stderr, "  -d, --difficulty <n>         Block difficulty (default: 5000)\n");
+    fprintf(stderr, "  -b, --block-interval <s>     Seconds between blocks from other miners, 0 for none (default: 20)\n");
+    fprintf(stderr, "  -l, --latency <ms>           Delay added to every answer (default: 0)\n");
+    fprintf(stderr, "  -e, --error-rate <percent>   Requests answered with a 503 (default: 0)\n");
+    fprintf(stderr, "      --height <n>             Height of the first tip (default: 1000)\n");
+    fprintf(stderr, "      --duration <s>           Length of a scenario (default: 60)\n");
+    fprintf(stderr, "      --metrics-port <port>    Where the scenario scrapes the miner (default: 9911)\n");
+    fprintf(stderr, "      --miner-log <file>       Output of the miner (default: mock_miner.log)\n");
+}
+
+int main(int argc, char** argv) {
+    mock_config_t config = { .port = 8001, .difficulty = "5000", .block_interval = 20, .latency_ms = 0, .error_rate = 0 };
+    long height = 1000;
+    double duration = 60;
+    int metrics_port = 9911;
+    const char* miner_log = "mock_miner.log";
+
+    static struct option long_options[] = {
+        {"port", required_argument, 0, 'p'},
+        {"difficulty", required_argument, 0, 'd'},
+        {"block-interval", required_argument, 0, 'b'},
+        {"latency", required_argument, 0, 'l'},
+        {"error-rate", required_argument, 0, 'e'},
+        {"height", required_argument, 0, 0},
+        {"duration", required_argument, 0, 0},
+        {"metrics-port", required_argument, 0, 0},
+        {"miner-log", required_argument, 0, 0},
+        {"help", no_argument, 0, 'h'},
+        {0, 0, 0, 0}
+    };
+    int opt;
+    int option_index = 0;
+    while ((opt = getopt_long(argc, argv, "p:d:b:l:e:h", long_options, &option_index)) != -1) {
+        switch (opt) {
+            case 0:
+                if (strcmp(long_options[option_index].name, "height") == 0) {
+                    height = atol(optarg);
+                } else if (strcmp(long_options[option_index].name, "duration") == 0) {
+                    duration = atof(optarg);
+                } else if (strcmp(long_options[option_index].name, "metrics-port") == 0) {
+                    metrics_port = atoi(optarg);
+                } else if (strcmp(long_options[option_index].name, "miner-log") == 0) {
+                    miner_log = optarg;
+                }
+                break;
+            case 'p': config.port = atoi(optarg); break;
+            case 'd': config.difficulty = optarg; break;
+            case 'b': config.block_interval = atof(optarg); break;
+            case 'l': config.latency_ms = atoi(optarg); break;
+            case 'e': config.error_rate = atoi(optarg); break;
+            default:
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (mpz_init_set_str(chain.difficulty, config.difficulty, 10) != 0 || mpz_sgn(chain.difficulty) <= 0) {
+        fprintf(stderr, "Error: the difficulty must be a positive integer.\n");
+        return EXIT_FAILURE;
+    }
+    if (config.latency_ms < 0 || config.error_rate < 0 || config.error_rate > 100 || duration <= 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    char** command = optind < argc ? &argv[optind] : NULL;
+    int command_count = argc - optind;
+
+    int listen_fd = server_open(config.port);
+    if (listen_fd < 0) return EXIT_FAILURE;
+    static mock_client_t clients[MOCK_MAX_CLIENTS];
+    for (int i = 0; i < MOCK_MAX_CLIENTS; i++) clients[i].fd = -1;
+    srand(time(NULL));
+
+    signal(SIGINT, request_exit);
+    signal(SIGTERM, request_exit);
+    signal(SIGPIPE, SIG_IGN);
+    printf("Mock node on http://127.0.0.1:%d, difficulty %s, a block every %.1f s, %d ms latency, %d%% errors\n",
+        config.port, config.difficulty, config.block_interval, config.latency_ms, config.error_rate);
+    // The first tip is where the miner starts, not a block it has to switch to
+    chain.height = height;
+    chain.date = time(NULL);
+    snprintf(chain.block_id, sizeof(chain.block_id), "mock%ld", chain.height);
+    clock_gettime(CLOCK_MONOTONIC, &chain.published);
+    chain.polled = true;
+    fflush(stdout);
+
+    if (!command) {
+        while (!atomic_load(&exit_requested)) server_step(listen_fd, clients, &config, 100);
+        close(listen_fd);
+        return EXIT_SUCCESS;
+    }
+
+    // --- Scenario ---
+    if (!net_global_init()) return EXIT_FAILURE;
+    static scenario_t scenario = {
+        .switch_time = { .mutex = PTHREAD_MUTEX_INITIALIZER },
+        .find_to_ack_ms = { -1, -1, -1 },
+        .job_switch_ms = { -1, -1, -1 },
+    };
+    scenario.metrics_port = metrics_port;
+    pid_t miner = start_miner(command, command_count, config.port, metrics_port, miner_log);
+    if (miner < 0) return EXIT_FAILURE;
+    printf("Started the miner (pid %d), its output goes to %s\n", (int)miner, miner_log);
+    fflush(stdout);
+    pthread_t scraper;
+    pthread_create(&scraper, NULL, scraper_thread, &scenario);
+
+    struct timespec start, now, stopped = { 0, 0 };
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    double measured = 0;
+    bool stopping = false, exited = false;
+    int status = 0;
+    // The node keeps serving while the miner shuts down, so that it is not left waiting on a request
+    while (!exited) {
+        server_step(listen_fd, clients, &config, 50);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        exited = waitpid(miner, &status, WNOHANG) == miner;
+        if (!stopping && (exited || atomic_load(&exit_requested) || seconds_between(&start, &now) >= duration)) {
+            stopping = true;
+            stopped = now;
+            measured = seconds_between(&start, &now);
+            atomic_store(&scenario.stop, true);
+            if (!exited) kill(miner, SIGINT);
+        } else if (stopping && !exited && seconds_between(&stopped, &now) >= MINER_EXIT_TIMEOUT_S) {
+            fprintf(stderr, "The miner did not exit, killing it.\n");
+            kill(miner, SIGKILL);
+            waitpid(miner, &status, 0);
+            exited = true;
+        }
+    }
+    pthread_join(scraper, NULL);
+    close(listen_fd);
+    net_global_cleanup();
+
+    print_report(&scenario, measured);
+    if (measured < duration && !atomic_load(&exit_requested)) {
+        fprintf(stderr, "The miner exited early (status %d), see %s.\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1, miner_log);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "net.h"
+
+// --- Shared Cache ---
+
+static CURLSH* share = NULL;
+static pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+
+static void share_lock(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    (void)handle; (void)access; (void)userptr;
+    pthread_mutex_lock(&share_locks[data]);
+}
+
+static void share_unlock(CURL* handle, curl_lock_data data, void* userptr) {
+    (void)handle; (void)userptr;
+    pthread_mutex_unlock(&share_locks[data]);
+}
+
+int net_global_init(void) {
+    if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) return 0;
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+        pthread_mutex_init(&share_locks[i], NULL);
+    }
+    share = curl_share_init();
+    if (!share) return 0;
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    return 1;
+}
+
+void net_global_cleanup(void) {
+    if (share) {
+        curl_share_cleanup(share);
+        share = NULL;
+    }
+    curl_global_cleanup();
+}
+
+// --- Clients ---
+
+// Copies into the fixed response buffer; an oversized body aborts the transfer
+static size_t write_callback(void* data, size_t size, size_t nmemb, void* userp) {
+    net_client_t* client = (net_client_t*)userp;
+    size_t realsize = size * nmemb;
+    if (client->response_size + realsize >= NET_RESPONSE_MAX) {
+        client->truncated = 1;
+        return 0;
+    }
+    memcpy(client->response + client->response_size, data, realsize);
+    client->response_size += realsize;
+    client->response[client->response_size] = '\0';
+    return realsize;
+}
+
+net_client_t* net_client_create(void) {
+    net_client_t* client = calloc(1, sizeof(net_client_t));
+    if (!client) return NULL;
+    client->curl = curl_easy_init();
+    if (!client->curl) {
+        free(client);
+        return NULL;
+    }
+    pthread_mutex_init(&client->latency.mutex, NULL);
+
+    // Options that stay the same for every request of this client
+    curl_easy_setopt(client->curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(client->curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(client->curl, CURLOPT_WRITEDATA, (void*)client);
+    curl_easy_setopt(client->curl, CURLOPT_ERRORBUFFER, client->error);
+    curl_easy_setopt(client->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(client->curl, CURLOPT_DNS_CACHE_TIMEOUT, 300L);
+    curl_easy_setopt(client->curl, CURLOPT_NOSIGNAL, 1L);
+    return client;
+}
+
+void net_client_destroy(net_client_t* client) {
+    if (!client) return;
+    curl_easy_cleanup(client->curl);
+    pthread_mutex_destroy(&client->latency.mutex);
+    free(client);
+}
+
+// Resets the response state and points the handle at `url`
+static void net_prepare(net_client_t* client, const char* url, long timeout_s) {
+    client->response_size = 0;
+    client->response[0] = '\0';
+    client->truncated = 0;
+    client->error[0] = '\0';
+
+    curl_easy_setopt(client->curl, CURLOPT_URL, url);
+    curl_easy_setopt(client->curl, CURLOPT_TIMEOUT, timeout_s);
+}
+
+// Turns the result of a transfer into the return value of net_get/net_post
+static int net_complete(net_client_t* client, CURLcode res, const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (res != CURLE_OK) {
+        if (client->truncated) {
+            snprintf(client->error, sizeof(client->error), "response larger than %d bytes", NET_RESPONSE_MAX);
+        } else if (client->error[0] == '\0') {
+            snprintf(client->error, sizeof(client->error), "%s", curl_easy_strerror(res));
+        }
+        return 0;
+    }
+
+    long usec = (end.tv_sec - start->tv_sec) * 1000000L + (end.tv_nsec - start->tv_nsec) / 1000;
+    net_latency_record(&client->latency, (uint32_t)usec);
+    return 1;
+}
+
+static int net_perform(net_client_t* client, const char* url, long timeout_s) {
+    struct timespec start;
+    net_prepare(client, url, timeout_s);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    return net_complete(client, curl_easy_perform(client->curl), &start);
+}
+
+int net_get(net_client_t* client, const char* url, long timeout_s) {
+    curl_easy_setopt(client->curl, CURLOPT_HTTPGET, 1L);
+    return net_perform(client, url, timeout_s);
+}
+
+int net_post(net_client_t* client, const char* url, const char* fields, long timeout_s) {
+    curl_easy_setopt(client->curl, CURLOPT_POSTFIELDS, fields);
+    return net_perform(client, url, timeout_s);
+}
+
+// Runs one request per client concurrently: a POST of `fields`, or a GET if it is NULL
+static int net_perform_all(net_client_t** clients, const char* const* urls, const char* fields, int n, long timeout_s, int* ok) {
+    CURLM* multi = curl_multi_init();
+    if (!multi) return 0;
+
+    struct timespec start;
+    for (int i = 0; i < n; i++) {
+        net_prepare(clients[i], urls[i], timeout_s);
+        if (fields) {
+            curl_easy_setopt(clients[i]->curl, CURLOPT_POSTFIELDS, fields);
+        } else {
+            curl_easy_setopt(clients[i]->curl, CURLOPT_HTTPGET, 1L);
+        }
+        curl_multi_add_handle(multi, clients[i]->curl);
+        ok[i] = 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int succeeded = 0;
+    int running = n;
+    while (running > 0) {
+        if (curl_multi_perform(multi, &running) != CURLM_OK) break;
+
+        // Complete each transfer as soon as it finishes, so its latency is its own
+        CURLMsg* msg;
+        int queued;
+        while ((msg = curl_multi_info_read(multi, &queued))) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            for (int i = 0; i < n; i++) {
+                if (clients[i]->curl != msg->easy_handle) continue;
+                ok[i] = net_complete(clients[i], msg->data.result, &start);
+                succeeded += ok[i];
+            }
+        }
+        if (running > 0) curl_multi_poll(multi, NULL, 0, 100, NULL);
+    }
+
+    for (int i = 0; i < n; i++) {
+        curl_multi_remove_handle(multi, clients[i]->curl);
+    }
+    curl_multi_cleanup(multi);
+    return succeeded;
+}
+
+int net_get_all(net_client_t** clients, const char* const* urls, int n, long timeout_s, int* ok) {
+    return net_perform_all(clients, urls, NULL, n, timeout_s, ok);
+}
+
+int net_post_all(net_client_t** clients, const char* const* urls, const char* fields, int n, long timeout_s, int* ok) {
+    return net_perform_all(clients, urls, fields, n, timeout_s, ok);
+}
+
+// --- Latency ---
+
+void net_latency_record(net_latency_t* latency, uint32_t usec) {
+    pthread_mutex_lock(&latency->mutex);
+    latency->samples[latency->count % NET_LATENCY_SAMPLES] = usec;
+    latency->count++;
+    pthread_mutex_unlock(&latency->mutex);
+}
+
+double net_latency_last(net_latency_t* latency) {
+    pthread_mutex_lock(&latency->mutex);
+    double ms = latency->count ? latency->samples[(latency->count - 1) % NET_LATENCY_SAMPLES] / 1000.0 : 0;
+    pthread_mutex_unlock(&latency->mutex);
+    return ms;
+}
+
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+int net_latency_percentiles(net_latency_t* latency, const double* percentiles, double* results, int n) {
+    uint32_t sorted[NET_LATENCY_SAMPLES];
+    pthread_mutex_lock(&latency->mutex);
+    int samples = latency->count < NET_LATENCY_SAMPLES ? (int)latency->count : NET_LATENCY_SAMPLES;
+    memcpy(sorted, latency->samples, samples * sizeof(uint32_t));
+    pthread_mutex_unlock(&latency->mutex);
+
+    if (samples == 0) {
+        for (int i = 0; i < n; i++) results[i] = 0;
+        return 0;
+    }
+
+    qsort(sorted, samples, sizeof(uint32_t), compare_u32);
+    for (int i = 0; i < n; i++) {
+        int rank = (int)(percentiles[i] / 100.0 * (samples - 1) + 0.5);
+        results[i] = sorted[rank] / 1000.0;
+    }
+    return samples;
+}
@@ -0,0 +1,105 @@
+#ifndef NET_H
+#define NET_H
+
+#include <curl/curl.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Largest node response we accept. `mine.php` answers are a few hundred bytes.
+#define NET_RESPONSE_MAX 65536
+// Number of recent request latencies kept for the percentiles
+#define NET_LATENCY_SAMPLES 256
+
+// Rolling window of request latencies, in microseconds
+typedef struct {
+    uint32_t samples[NET_LATENCY_SAMPLES];
+    uint64_t count;
+    pthread_mutex_t mutex;
+} net_latency_t;
+
+// A persistent HTTP client. The curl handle is reused across requests so the
+// connection to the node stays open, and the response lands in a fixed buffer.
+// A client must only be used by one thread at a time.
+typedef struct {
+    CURL* curl;
+    char response[NET_RESPONSE_MAX];
+    size_t response_size;
+    int truncated;
+    char error[CURL_ERROR_SIZE];
+    net_latency_t latency;
+} net_client_t;
+
+/**
+ * @brief Initializes libcurl and the DNS/TLS-session/connection cache shared by all clients.
+ *
+ * Must be called once before any thread is started.
+ *
+ * @return 1 on success, 0 on failure.
+ */
+int net_global_init(void);
+
+/**
+ * @brief Releases the shared cache and libcurl.
+ */
+void net_global_cleanup(void);
+
+/**
+ * @brief Allocates a client bound to the shared cache. Free with `net_client_destroy`.
+ */
+net_client_t* net_client_create(void);
+
+void net_client_destroy(net_client_t* client);
+
+/**
+ * @brief Performs a GET request. On success the NUL-terminated body is in `client->response`.
+ *
+ * @return 1 on success, 0 on transport failure or an oversized response (see `client->error`).
+ */
+int net_get(net_client_t* client, const char* url, long timeout_s);
+
+/**
+ * @brief Performs a form-encoded POST request. The body is read back as for `net_get`.
+ */
+int net_post(net_client_t* client, const char* url, const char* fields, long timeout_s);
+
+/**
+ * @brief Performs GET requests on several clients concurrently and waits for all of them.
+ *
+ * Each client gets its own URL; its response, error and latency are filled in as for `net_get`.
+ *
+ * @param ok Receives, per client, what `net_get` would have returned.
+ * @return The number of clients whose request succeeded.
+ */
+int net_get_all(net_client_t** clients, const char* const* urls, int n, long timeout_s, int* ok);
+
+/**
+ * @brief Performs the same POST on several clients concurrently and waits for all of them.
+ *
+ * Each client gets its own URL; its response, error and latency are filled in as for `net_post`.
+ *
+ * @param ok Receives, per client, what `net_post` would have returned.
+ * @return The number of clients whose request succeeded.
+ */
+int net_post_all(net_client_t** clients, const char* const* urls, const char* fields, int n, long timeout_s, int* ok);
+
+/**
+ * @brief Records a latency sample in microseconds.
+ */
+void net_latency_record(net_latency_t* latency, uint32_t usec);
+
+/**
+ * @brief Returns the most recent sample in milliseconds, or 0 if there is none.
+ */
+double net_latency_last(net_latency_t* latency);
+
+/**
+ * @brief Computes latency percentiles (in milliseconds) over the recent samples.
+ *
+ * @param percentiles The requested percentiles, 0..100.
+ * @param results Receives one value per requested percentile.
+ * @return The number of samples the results are based on (0 if none).
+ */
+int net_latency_percentiles(net_latency_t* latency, const double* percentiles, double* results, int n);
+
+#endif // NET_H
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <string.h>
+#include "nodes.h"
+
+// Weight of a new latency sample in the moving average
+#define LATENCY_ALPHA 0.3
+// Another node must be this much faster before the selection moves to it
+#define SWITCH_SPEEDUP 1.5
+
+void node_pool_init(node_pool_t* pool) {
+    memset(pool->nodes, 0, sizeof(pool->nodes));
+    atomic_init(&pool->count, 0);
+    pool->selected = 0;
+    pthread_mutex_init(&pool->mutex, NULL);
+}
+
+int node_pool_add(node_pool_t* pool, const char* url) {
+    char clean[sizeof(pool->nodes[0].url)];
+    snprintf(clean, sizeof(clean), "%s", url);
+    size_t len = strlen(clean);
+    while (len > 0 && clean[len - 1] == '/') clean[--len] = '\0';
+    if (len == 0) return -1;
+
+    pthread_mutex_lock(&pool->mutex);
+    int count = atomic_load_explicit(&pool->count, memory_order_relaxed);
+    int index = -1;
+    for (int i = 0; i < count; i++) {
+        if (strcmp(pool->nodes[i].url, clean) == 0) index = i;
+    }
+    if (index < 0 && count < NODE_POOL_MAX) {
+        net_client_t* client = net_client_create();
+        if (client) {
+            // The entry is complete before the release store makes the count cover it,
+            // so readers of node_pool_count never see a half-written node
+            node_entry_t* node = &pool->nodes[count];
+            memcpy(node->url, clean, len + 1);
+            node->client = client;
+            node->healthy = 1; // Innocent until a request fails
+            index = count;
+            atomic_store_explicit(&pool->count, count + 1, memory_order_release);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return index;
+}
+
+void node_pool_report(node_pool_t* pool, int index, int ok, long height, double latency_ms) {
+    pthread_mutex_lock(&pool->mutex);
+    node_entry_t* node = &pool->nodes[index];
+    if (ok) {
+        node->failures = 0;
+        node->healthy = 1;
+        node->height = height;
+        node->latency_ms = node->latency_ms == 0 ? latency_ms
+            : LATENCY_ALPHA * latency_ms + (1 - LATENCY_ALPHA) * node->latency_ms;
+    } else {
+        node->failures++;
+        node->healthy = 0;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int node_pool_select(node_pool_t* pool, const char** reason) {
+    *reason = NULL;
+    pthread_mutex_lock(&pool->mutex);
+    int count = atomic_load_explicit(&pool->count, memory_order_relaxed);
+
+    long best_height = 0;
+    for (int i = 0; i < count; i++) {
+        if (pool->nodes[i].healthy && !pool->nodes[i].disabled && pool->nodes[i].height > best_height) best_height = pool->nodes[i].height;
+    }
+
+    // Fastest healthy node on the best tip. Nodes whose height is not known yet only
+    // qualify when no node has reported one.
+    int best = -1;
+    for (int i = 0; i < count; i++) {
+        const node_entry_t* node = &pool->nodes[i];
+        if (!node->healthy || node->disabled || node->height != best_height) continue;
+        if (best < 0 || node->latency_ms < pool->nodes[best].latency_ms) best = i;
+    }
+
+    const node_entry_t* current = &pool->nodes[pool->selected];
+    if (best >= 0 && best != pool->selected) {
+        if (current->disabled) {
+            *reason = "disabled";
+        } else if (!current->healthy) {
+            *reason = "down";
+        } else if (current->height < best_height) {
+            *reason = "lagging";
+        } else if (current->latency_ms > SWITCH_SPEEDUP * pool->nodes[best].latency_ms) {
+            *reason = "slow";
+        }
+        if (*reason) pool->selected = best;
+    } else if (best < 0 && (!current->healthy || current->disabled)) {
+        // Everything is down: try the next node round-robin rather than insisting on one
+        for (int i = 1; i < count; i++) {
+            int next = (pool->selected + i) % count;
+            if (!pool->nodes[next].disabled && (pool->nodes[next].failures <= current->failures || current->disabled)) {
+                pool->selected = next;
+                *reason = "down";
+                break;
+            }
+        }
+    }
+
+    int selected = pool->selected;
+    pthread_mutex_unlock(&pool->mutex);
+    return selected;
+}
+
+int node_pool_selected(node_pool_t* pool, char* url, size_t url_len) {
+    pthread_mutex_lock(&pool->mutex);
+    int selected = pool->selected;
+    snprintf(url, url_len, "%s", pool->nodes[selected].url);
+    pthread_mutex_unlock(&pool->mutex);
+    return selected;
+}
+
+void node_pool_url(node_pool_t* pool, int index, char* url, size_t url_len) {
+    pthread_mutex_lock(&pool->mutex);
+    snprintf(url, url_len, "%s", pool->nodes[index].url);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+int node_pool_disabled(node_pool_t* pool, int index) {
+    pthread_mutex_lock(&pool->mutex);
+    int disabled = pool->nodes[index].disabled;
+    pthread_mutex_unlock(&pool->mutex);
+    return disabled;
+}
+
+void node_pool_set_disabled(node_pool_t* pool, int index, int disabled) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->nodes[index].disabled = disabled;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void node_pool_prefer(node_pool_t* pool, int index) {
+    pthread_mutex_lock(&pool->mutex);
+    pool->selected = index;
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,100 @@
+#ifndef NODES_H
+#define NODES_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include "net.h"
+
+// Most nodes the miner keeps track of, configured and discovered together
+#define NODE_POOL_MAX 16
+
+// What the miner knows about one node
+typedef struct {
+    char url[256];
+    net_client_t* client; // Used by the health checks only
+    int healthy;          // Cleared by any failed request, set again by a successful one
+    int failures;         // Consecutive failed requests
+    long height;          // Height to mine on top of the node's tip, 0 if unknown
+    double latency_ms;    // Moving average of successful requests
+    int disabled;         // Taken out of the rotation at runtime; never selected
+} node_entry_t;
+
+// The set of nodes mined against. All functions lock the pool, so any thread may use them.
+typedef struct {
+    node_entry_t nodes[NODE_POOL_MAX];
+    atomic_int count; // Only grows, under the mutex; read it with node_pool_count
+    int selected; // Node the dispatcher polls for jobs
+    pthread_mutex_t mutex;
+} node_pool_t;
+
+void node_pool_init(node_pool_t* pool);
+
+/**
+ * @brief Returns the number of nodes. Needs no lock: nodes are only ever appended, and
+ * every node below the count is complete, including its client.
+ */
+static inline int node_pool_count(node_pool_t* pool) {
+    return atomic_load_explicit(&pool->count, memory_order_acquire);
+}
+
+/**
+ * @brief Adds a node unless it is already in the pool.
+ *
+ * Trailing slashes are dropped so that the same node is not added twice.
+ *
+ * @return The index of the node, or -1 if the pool is full or the client cannot be created.
+ */
+int node_pool_add(node_pool_t* pool, const char* url);
+
+/**
+ * @brief Records the outcome of a request to a node.
+ *
+ * @param height The height reported by the node (successful requests only).
+ * @param latency_ms The request latency (successful requests only).
+ */
+void node_pool_report(node_pool_t* pool, int index, int ok, long height, double latency_ms);
+
+/**
+ * @brief Re-evaluates which node to poll for jobs.
+ *
+ * Among healthy nodes at the highest known height, the one with the lowest latency wins;
+ * the current node is kept unless it is disabled or down, lags behind, or another node is
+ * clearly faster.
+ *
+ * @param reason Set to why the selection changed ("disabled", "down", "lagging" or "slow"), or NULL if it did not.
+ * @return The selected index.
+ */
+int node_pool_select(node_pool_t* pool, const char** reason);
+
+/**
+ * @brief Copies the URL of the selected node.
+ *
+ * @return The selected index.
+ */
+int node_pool_selected(node_pool_t* pool, char* url, size_t url_len);
+
+/**
+ * @brief Copies the URL of node `index`.
+ */
+void node_pool_url(node_pool_t* pool, int index, char* url, size_t url_len);
+
+/**
+ * @brief Tells whether node `index` is out of the rotation.
+ */
+int node_pool_disabled(node_pool_t* pool, int index);
+
+/**
+ * @brief Takes node `index` out of the rotation, or puts it back.
+ *
+ * Nodes cannot be removed since their indices are held elsewhere; a disabled node stays
+ * in the pool but is never selected.
+ */
+void node_pool_set_disabled(node_pool_t* pool, int index, int disabled);
+
+/**
+ * @brief Makes node `index` the selected node right away, whatever its health.
+ */
+void node_pool_prefer(node_pool_t* pool, int index);
+
+#endif // NODES_H
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "nonces.h"
+
+// 64-bit FNV-1a
+static uint64_t fnv1a(const char* data, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint32_t nonce_host_worker_id(void) {
+    char id[256] = "";
+    FILE* file = fopen("/etc/machine-id", "r");
+    if (file) {
+        if (!fgets(id, sizeof(id), file)) id[0] = '\0';
+        fclose(file);
+        id[strcspn(id, "\r\n")] = '\0';
+    }
+    if (id[0] == '\0' && gethostname(id, sizeof(id) - 1) != 0) return 0;
+    uint64_t hash = fnv1a(id, strlen(id));
+    return (uint32_t)((hash ^ (hash >> 32)) & NONCE_WORKER_ID_MAX);
+}
+
+int nonce_claim_instance(void) {
+    for (int instance = 0; instance <= NONCE_INSTANCE_MAX; instance++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        // Abstract namespace: the name starts with a NUL byte and never touches the filesystem
+        int len = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "phpcoin-miner-instance-%d", instance);
+        if (bind(fd, (struct sockaddr*)&addr, offsetof(struct sockaddr_un, sun_path) + 1 + len) == 0) {
+            return instance; // The socket stays open, and so claimed, until the process exits
+        }
+        close(fd);
+    }
+    return -1;
+}
+
+int dup_sampler_init(dup_sampler_t* sampler, size_t capacity) {
+    memset(sampler, 0, sizeof(*sampler));
+    sampler->slots = calloc(capacity, sizeof(uint64_t));
+    if (!sampler->slots) return 0;
+    sampler->capacity = capacity;
+    return 1;
+}
+
+// Slots looked at before a sample is dropped
+#define DUP_PROBES 8
+
+void dup_sampler_add(dup_sampler_t* sampler, const char* argon_hash) {
+    uint64_t fingerprint = fnv1a(argon_hash, strlen(argon_hash));
+    if (fingerprint % DUP_SAMPLE_RATE != 0) return;
+    fingerprint |= 1; // 0 marks an empty slot
+    atomic_fetch_add_explicit(&sampler->sampled, 1, memory_order_relaxed);
+
+    if (atomic_load_explicit(&sampler->used, memory_order_relaxed) > sampler->capacity / 2) {
+        // Lossy on purpose: a sample inserted while the table is cleared may be lost
+        atomic_store(&sampler->used, 0);
+        for (size_t i = 0; i < sampler->capacity; i++) atomic_store_explicit(&sampler->slots[i], 0, memory_order_relaxed);
+    }
+
+    size_t mask = sampler->capacity - 1;
+    size_t slot = (fingerprint / DUP_SAMPLE_RATE) & mask;
+    for (int probe = 0; probe < DUP_PROBES; probe++, slot = (slot + 1) & mask) {
+        uint64_t expected = 0;
+        if (atomic_compare_exchange_strong_explicit(&sampler->slots[slot], &expected, fingerprint,
+                memory_order_relaxed, memory_order_relaxed)) {
+            atomic_fetch_add_explicit(&sampler->used, 1, memory_order_relaxed);
+            return;
+        }
+        if (expected == fingerprint) {
+            atomic_fetch_add_explicit(&sampler->duplicates, 1, memory_order_relaxed);
+            return;
+        }
+    }
+}
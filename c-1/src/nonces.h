@@ -0,0 +1,82 @@
+#ifndef NONCES_H
+#define NONCES_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Nonce space partitioning. The Argon2 password and salt of an attempt are derived from its
+// 64-bit nonce, so two workers on the same nonce compute the same hash for the same address.
+// Every worker therefore counts in its own stream:
+//
+//   bits 63..48  worker id: the host
+//   bits 47..44  instance:  the miner process on that host
+//   bits 43..32  thread:    the worker in that process
+//   bits 31..0   counter:   restarted for every job
+#define NONCE_WORKER_ID_BITS 16
+#define NONCE_INSTANCE_BITS 4
+#define NONCE_THREAD_BITS 12
+#define NONCE_COUNTER_BITS 32
+
+#define NONCE_WORKER_ID_MAX ((1 << NONCE_WORKER_ID_BITS) - 1)
+#define NONCE_INSTANCE_MAX ((1 << NONCE_INSTANCE_BITS) - 1)
+#define NONCE_THREADS_MAX (1 << NONCE_THREAD_BITS)
+
+/**
+ * @brief Returns the first nonce of a worker's stream.
+ *
+ * @param thread Index of the worker in its process, 0-based.
+ */
+static inline uint64_t nonce_stream_base(uint32_t worker_id, uint32_t instance, uint32_t thread) {
+    return ((uint64_t)worker_id << (NONCE_INSTANCE_BITS + NONCE_THREAD_BITS + NONCE_COUNTER_BITS))
+        | ((uint64_t)instance << (NONCE_THREAD_BITS + NONCE_COUNTER_BITS))
+        | ((uint64_t)thread << NONCE_COUNTER_BITS);
+}
+
+/**
+ * @brief Derives a worker id from /etc/machine-id, or from the host name if there is none.
+ *
+ * Hosts get different ids with high probability but not for certain; rigs sharing an
+ * address should set theirs explicitly.
+ */
+uint32_t nonce_host_worker_id(void);
+
+/**
+ * @brief Claims the lowest instance number no other miner on this host holds.
+ *
+ * The claim is an abstract Unix socket that lives as long as the process, so it is released
+ * even if the miner is killed. Miners in different network namespaces cannot see each other.
+ *
+ * @return The instance, or -1 if all of them are taken.
+ */
+int nonce_claim_instance(void);
+
+// Duplicate-work sampler. Workers feed it every Argon2 hash they make; it keeps the ones
+// whose fingerprint falls in a fixed 1/DUP_SAMPLE_RATE slice, so two copies of the same
+// hash are either both sampled or both skipped, and counts samples it has seen before.
+#define DUP_SAMPLE_RATE 64
+
+typedef struct {
+    _Atomic uint64_t* slots; // Open addressing, 0 for empty
+    size_t capacity;
+    atomic_size_t used;
+    atomic_uint_fast64_t sampled;
+    atomic_uint_fast64_t duplicates;
+} dup_sampler_t;
+
+/**
+ * @brief Allocates a sampler with room for `capacity` fingerprints (a power of two).
+ *
+ * @return 1 on success, 0 if the memory cannot be allocated.
+ */
+int dup_sampler_init(dup_sampler_t* sampler, size_t capacity);
+
+/**
+ * @brief Samples one hash. Safe to call from any number of threads.
+ *
+ * When the table is half full it is cleared, so duplicates further apart than about
+ * `capacity / 2 * DUP_SAMPLE_RATE` hashes go unnoticed.
+ */
+void dup_sampler_add(dup_sampler_t* sampler, const char* argon_hash);
+
+#endif // NONCES_H
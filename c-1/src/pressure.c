@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <inttypes.h>
+#include "pressure.h"
+
+int pressure_read(const char* resource, uint64_t* some_us) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/pressure/%s", resource);
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    // some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+    int ok = fscanf(file, "some avg10=%*f avg60=%*f avg300=%*f total=%" SCNu64, some_us) == 1;
+    fclose(file);
+    return ok;
+}
+
+int pressure_task_wait(pid_t tid, uint64_t* wait_ns) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", (int)tid);
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    // <time on the CPU> <time waiting on a runqueue> <timeslices>, in ns
+    int ok = fscanf(file, "%*u %" SCNu64, wait_ns) == 1;
+    fclose(file);
+    return ok;
+}
+
+int pressure_controller_update(pressure_controller_t* controller, double foreign_pct, double stolen, int interval_ms) {
+    controller->foreign_pct += PRESSURE_SMOOTHING * (foreign_pct - controller->foreign_pct);
+    controller->stolen += PRESSURE_SMOOTHING * (stolen - controller->stolen);
+    foreign_pct = controller->foreign_pct;
+    stolen = controller->stolen;
+
+    int active = controller->active;
+    if (foreign_pct >= PRESSURE_HIGH_PCT) {
+        // Other tasks are stalling while the workers run: halve them, down to none
+        active /= 2;
+    } else if (stolen >= 0.5) {
+        // Workers sit on runqueues behind other work: give up the CPUs it took
+        active -= (int)(stolen + 0.5);
+    }
+    if (active < 0) active = 0;
+
+    if (active < controller->active || foreign_pct >= PRESSURE_LOW_PCT || stolen >= 0.1) {
+        controller->quiet_ms = 0;
+    } else {
+        controller->quiet_ms += interval_ms;
+        if (controller->quiet_ms >= PRESSURE_RESUME_MS && active < controller->workers) {
+            active++;
+            controller->quiet_ms = 0;
+        }
+    }
+    if (active != controller->active) {
+        // The next samples measure the new worker count, not what led to it
+        controller->foreign_pct = 0;
+        controller->stolen = 0;
+        controller->active = active;
+    }
+    return active;
+}
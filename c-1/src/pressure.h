@@ -0,0 +1,53 @@
+#ifndef PRESSURE_H
+#define PRESSURE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+// Background mode: Linux pressure stall information (PSI) and the controller that decides
+// how many workers may run while other work on the machine wants the CPU or memory.
+
+// Above this share of stalled time (percent) other work is suffering and workers are parked
+#define PRESSURE_HIGH_PCT 10.0
+// Below this share the machine counts as quiet
+#define PRESSURE_LOW_PCT 2.0
+// Workers come back one at a time, each after this long without pressure
+#define PRESSURE_RESUME_MS 1000
+// Weight of a new sample in the smoothed pressure, so one short stall does not park anything
+#define PRESSURE_SMOOTHING 0.3
+
+typedef struct {
+    int workers;         // Workers in the pool
+    int active;          // Workers allowed to run; the rest are parked
+    int quiet_ms;        // Time the machine has been quiet
+    double foreign_pct;  // Smoothed inputs
+    double stolen;
+} pressure_controller_t;
+
+/**
+ * @brief Reads the cumulative "some" stall time of a resource in /proc/pressure.
+ *
+ * @param resource "cpu", "memory" or "io".
+ * @return 1 on success, 0 if the kernel has no PSI.
+ */
+int pressure_read(const char* resource, uint64_t* some_us);
+
+/**
+ * @brief Reads the cumulative time thread `tid` of this process has been runnable
+ * without getting a CPU, from its schedstat.
+ *
+ * @return 1 on success, 0 if it cannot be read.
+ */
+int pressure_task_wait(pid_t tid, uint64_t* wait_ns);
+
+/**
+ * @brief Updates the number of workers allowed to run after an interval of `interval_ms`.
+ *
+ * @param foreign_pct Share of the interval other tasks stalled on CPU or memory, in percent.
+ * @param stolen CPU time the active workers waited for during the interval, in workers
+ *        (2.0: two workers' worth of CPU went to other tasks).
+ * @return The new number of active workers.
+ */
+int pressure_controller_update(pressure_controller_t* controller, double foreign_pct, double stolen, int interval_ms);
+
+#endif // PRESSURE_H
@@ -0,0 +1,111 @@
+#include <string.h>
+#include <time.h>
+#include "profile.h"
+
+bool profile_enabled = false;
+
+// Nanoseconds per TSC tick, measured by profile_enable
+static double ns_per_tick = 0;
+
+static const char* phase_names[PHASE_COUNT] = { "job", "target", "argon", "nonce+hit", "stats" };
+
+static double monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+void profile_enable(void) {
+    double start_ns = monotonic_ns();
+    uint64_t start_ticks = __rdtsc();
+    struct timespec pause = { 0, 50 * 1000 * 1000 };
+    nanosleep(&pause, NULL);
+    ns_per_tick = (monotonic_ns() - start_ns) / (double)(__rdtsc() - start_ticks);
+    profile_enabled = true;
+}
+
+// Midpoint of a bucket, in ticks
+static double bucket_value(int bucket) {
+    if (bucket < PROFILE_SUB_BUCKETS) return bucket;
+    int msb = bucket / PROFILE_SUB_BUCKETS + 2;
+    int sub = bucket % PROFILE_SUB_BUCKETS;
+    double low = (double)(PROFILE_SUB_BUCKETS + sub) * (double)(1ULL << (msb - 3));
+    return low + (double)(1ULL << (msb - 3)) / 2;
+}
+
+// The p-th percentile of a histogram, in ticks
+static double percentile(const uint64_t* buckets, uint64_t count, double p) {
+    if (count == 0) return 0;
+    uint64_t rank = (uint64_t)(p / 100 * count);
+    if (rank >= count) rank = count - 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < PROFILE_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen > rank) return bucket_value(b);
+    }
+    return bucket_value(PROFILE_BUCKETS - 1);
+}
+
+static void format_duration(double ns, char* buffer, size_t len) {
+    if (ns < 1e3) {
+        snprintf(buffer, len, "%.0f ns", ns);
+    } else if (ns < 1e6) {
+        snprintf(buffer, len, "%.1f us", ns / 1e3);
+    } else if (ns < 1e9) {
+        snprintf(buffer, len, "%.2f ms", ns / 1e6);
+    } else {
+        snprintf(buffer, len, "%.2f s", ns / 1e9);
+    }
+}
+
+void profile_dump(FILE* out, phase_profile_t* profiles, int count) {
+    if (!profile_enabled) {
+        fprintf(out, "Phase timing is off; start the miner with --profile.\n");
+        return;
+    }
+    uint64_t merged[PROFILE_BUCKETS];
+    uint64_t single[PROFILE_BUCKETS];
+
+    double all_time = 0;
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        for (int t = 0; t < count; t++) all_time += atomic_load(&profiles[t].total[phase]);
+    }
+
+    fprintf(out, "\nPhase timings since start (%d threads):\n", count);
+    fprintf(out, "%-10s %-12s %-10s %-10s %-10s %-10s %-6s %s\n", "Phase", "Count", "Mean", "p50", "p99", "Max", "Time", "Worst p99");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        memset(merged, 0, sizeof(merged));
+        uint64_t calls = 0, total = 0, max = 0;
+        double worst_p99 = 0;
+        int worst_thread = 0;
+        for (int t = 0; t < count; t++) {
+            phase_profile_t* profile = &profiles[t];
+            uint64_t thread_calls = 0;
+            for (int b = 0; b < PROFILE_BUCKETS; b++) {
+                single[b] = atomic_load_explicit(&profile->buckets[phase][b], memory_order_relaxed);
+                merged[b] += single[b];
+                thread_calls += single[b];
+            }
+            calls += thread_calls;
+            total += atomic_load_explicit(&profile->total[phase], memory_order_relaxed);
+            uint64_t thread_max = atomic_load_explicit(&profile->max[phase], memory_order_relaxed);
+            if (thread_max > max) max = thread_max;
+            double p99 = percentile(single, thread_calls, 99);
+            if (thread_calls > 0 && p99 >= worst_p99) {
+                worst_p99 = p99;
+                worst_thread = t + 1;
+            }
+        }
+
+        char mean_str[16], p50_str[16], p99_str[16], max_str[16], worst_str[32];
+        format_duration(calls ? total * ns_per_tick / calls : 0, mean_str, sizeof(mean_str));
+        format_duration(percentile(merged, calls, 50) * ns_per_tick, p50_str, sizeof(p50_str));
+        format_duration(percentile(merged, calls, 99) * ns_per_tick, p99_str, sizeof(p99_str));
+        format_duration(max * ns_per_tick, max_str, sizeof(max_str));
+        format_duration(worst_p99 * ns_per_tick, worst_str, sizeof(worst_str));
+        char share_str[16];
+        snprintf(share_str, sizeof(share_str), "%.1f%%", all_time > 0 ? 100 * total / all_time : 0);
+        fprintf(out, "%-10s %-12llu %-10s %-10s %-10s %-10s %-6s %s (thread %d)\n", phase_names[phase],
+            (unsigned long long)calls, mean_str, p50_str, p99_str, max_str, share_str, worst_str, worst_thread);
+    }
+}
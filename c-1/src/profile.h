@@ -0,0 +1,85 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <x86intrin.h>
+
+// Latency histograms of the phases of a mining iteration, one set per worker. Durations
+// are measured in TSC ticks and converted to time when printed. Timing is off unless
+// `profile_enable` is called, and compiled out entirely with -DMINER_NO_PROFILE.
+
+typedef enum {
+    PHASE_JOB,       // Checking for (and switching to) a new job
+    PHASE_TARGET,    // Midstate and target, once per elapsed second
+    PHASE_ARGON,     // Argon2 fill of one batch
+    PHASE_NONCE_HIT, // Nonces and hits of one batch
+    PHASE_STATS,     // Counters, page faults and the solution check
+    PHASE_COUNT
+} profile_phase_t;
+
+// Log-linear buckets: 8 per power of two, so a percentile is within 12.5% of the true value
+#define PROFILE_SUB_BUCKETS 8
+#define PROFILE_BUCKETS (62 * PROFILE_SUB_BUCKETS)
+
+// One worker's histograms. Only the worker writes them; any thread may read them.
+typedef struct {
+    atomic_uint_fast64_t buckets[PHASE_COUNT][PROFILE_BUCKETS];
+    atomic_uint_fast64_t total[PHASE_COUNT]; // Sum of all durations, in ticks
+    atomic_uint_fast64_t max[PHASE_COUNT];
+} phase_profile_t;
+
+extern bool profile_enabled;
+
+/**
+ * @brief Turns timing on and calibrates the TSC against the monotonic clock.
+ *
+ * Call once before the workers start; it takes about 50 ms.
+ */
+void profile_enable(void);
+
+/**
+ * @brief Returns the current TSC value, or 0 while timing is off.
+ */
+static inline uint64_t profile_now(void) {
+#ifdef MINER_NO_PROFILE
+    return 0;
+#else
+    return profile_enabled ? __rdtsc() : 0;
+#endif
+}
+
+static inline int profile_bucket(uint64_t ticks) {
+    if (ticks < PROFILE_SUB_BUCKETS) return (int)ticks;
+    int msb = 63 - __builtin_clzll(ticks);
+    int sub = (int)(ticks >> (msb - 3)) & (PROFILE_SUB_BUCKETS - 1);
+    return (msb - 2) * PROFILE_SUB_BUCKETS + sub;
+}
+
+/**
+ * @brief Records a phase that ran from `start` to `end` (values of `profile_now`).
+ */
+static inline void profile_record(phase_profile_t* profile, profile_phase_t phase, uint64_t start, uint64_t end) {
+#ifndef MINER_NO_PROFILE
+    if (!profile_enabled || !profile) return;
+    uint64_t ticks = end - start;
+    atomic_uint_fast64_t* bucket = &profile->buckets[phase][profile_bucket(ticks)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&profile->total[phase], atomic_load_explicit(&profile->total[phase], memory_order_relaxed) + ticks, memory_order_relaxed);
+    if (ticks > atomic_load_explicit(&profile->max[phase], memory_order_relaxed)) {
+        atomic_store_explicit(&profile->max[phase], ticks, memory_order_relaxed);
+    }
+#endif
+}
+
+/**
+ * @brief Prints count, mean, p50, p99 and max of every phase over all workers, and the
+ * worker with the worst p99.
+ *
+ * @param profiles The histograms of `count` workers; worker i is printed as thread i + 1.
+ */
+void profile_dump(FILE* out, phase_profile_t* profiles, int count);
+
+#endif // PROFILE_H
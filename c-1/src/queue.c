@@ -0,0 +1,57 @@
+#include <stdlib.h>
+#include "queue.h"
+
+int mpsc_queue_init(mpsc_queue_t* queue, size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) size <<= 1;
+    queue->cells = malloc(size * sizeof(queue_cell_t));
+    if (!queue->cells) return 0;
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+        queue->cells[i].value = NULL;
+    }
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return 1;
+}
+
+void mpsc_queue_destroy(mpsc_queue_t* queue) {
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+int mpsc_queue_push(mpsc_queue_t* queue, void* value) {
+    size_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    for (;;) {
+        queue_cell_t* cell = &queue->cells[pos & queue->mask];
+        size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)(seq - pos);
+        if (diff == 0) {
+            // The slot is free for this lap; claim it by advancing the head
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed)) {
+                cell->value = value;
+                atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+                return 1;
+            }
+            // `pos` was reloaded by the failed exchange
+        } else if (diff < 0) {
+            return 0; // The consumer has not freed this slot yet: full
+        } else {
+            pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+}
+
+void* mpsc_queue_pop(mpsc_queue_t* queue) {
+    size_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    queue_cell_t* cell = &queue->cells[pos & queue->mask];
+    size_t seq = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    if (seq != pos + 1) return NULL; // Empty, or a producer is still writing it
+    void* value = cell->value;
+    atomic_store_explicit(&queue->tail, pos + 1, memory_order_relaxed);
+    // Hand the slot back to producers for the next lap
+    atomic_store_explicit(&cell->sequence, pos + queue->mask + 1, memory_order_release);
+    return value;
+}
@@ -0,0 +1,47 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// A bounded, lock-free queue of pointers for many producers and one consumer.
+// Each slot carries a sequence number that tells producers and the consumer whose
+// turn it is, so neither side ever takes a lock or blocks in push/pop.
+
+typedef struct {
+    atomic_size_t sequence;
+    void* value;
+} queue_cell_t;
+
+typedef struct {
+    queue_cell_t* cells;
+    size_t mask; // Capacity - 1; the capacity is a power of two
+    _Alignas(64) atomic_size_t head; // Next slot to write
+    _Alignas(64) atomic_size_t tail; // Next slot to read
+} mpsc_queue_t;
+
+/**
+ * @brief Allocates the slots of a queue.
+ *
+ * @param capacity The number of slots, rounded up to a power of two.
+ * @return 1 on success, 0 on allocation failure.
+ */
+int mpsc_queue_init(mpsc_queue_t* queue, size_t capacity);
+
+void mpsc_queue_destroy(mpsc_queue_t* queue);
+
+/**
+ * @brief Appends a pointer. Safe to call from any number of threads at once.
+ *
+ * @return 1 on success, 0 if the queue is full.
+ */
+int mpsc_queue_push(mpsc_queue_t* queue, void* value);
+
+/**
+ * @brief Removes the oldest pointer. Must only be called from the consumer thread.
+ *
+ * @return The pointer, or NULL if the queue is empty.
+ */
+void* mpsc_queue_pop(mpsc_queue_t* queue);
+
+#endif // QUEUE_H
@@ -0,0 +1,288 @@
+#include <pthread.h>
+#include <string.h>
+#include <immintrin.h>
+#include "sha256.h"
+
+// Portable SHA-256 with two accelerated paths: the x86 SHA extensions for single
+// messages, and an AVX2 kernel that hashes eight same-length messages at once.
+
+static const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+static inline uint32_t load32_be(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void store32_be(uint8_t* p, uint32_t w) {
+    p[0] = (uint8_t)(w >> 24);
+    p[1] = (uint8_t)(w >> 16);
+    p[2] = (uint8_t)(w >> 8);
+    p[3] = (uint8_t)w;
+}
+
+// --- Scalar ---
+
+static inline uint32_t rotr32(uint32_t w, unsigned c) {
+    return (w >> c) | (w << (32 - c));
+}
+
+static void compress_scalar(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    uint32_t w[64];
+    while (blocks--) {
+        for (int t = 0; t < 16; t++) w[t] = load32_be(data + 4 * t);
+        for (int t = 16; t < 64; t++) {
+            uint32_t s0 = rotr32(w[t - 15], 7) ^ rotr32(w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = rotr32(w[t - 2], 17) ^ rotr32(w[t - 2], 19) ^ (w[t - 2] >> 10);
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int t = 0; t < 64; t++) {
+            uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + K[t] + w[t];
+            uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        data += SHA256_BLOCK_SIZE;
+    }
+}
+
+// --- SHA Extensions ---
+
+__attribute__((target("sha,sse4.1")))
+static void compress_shani(uint32_t state[8], const uint8_t* data, size_t blocks) {
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The rounds instruction wants the state as ABEF / CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1); // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0); // CDGH
+
+    while (blocks--) {
+        __m128i abef = state0, cdgh = state1;
+        __m128i w[16];
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), bswap);
+            } else {
+                __m128i x = _mm_add_epi32(_mm_sha256msg1_epu32(w[i - 4], w[i - 3]), _mm_alignr_epi8(w[i - 1], w[i - 2], 4));
+                w[i] = _mm_sha256msg2_epu32(x, w[i - 1]);
+            }
+            __m128i msg = _mm_add_epi32(w[i], _mm_loadu_si128((const __m128i*)&K[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+        data += SHA256_BLOCK_SIZE;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B); // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1); // DCHG
+    _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, state1, 0xF0)); // DCBA
+    _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(state1, tmp, 8)); // HGFE
+}
+
+// --- AVX2 Multi-Buffer ---
+
+__attribute__((target("avx2")))
+static inline __m256i rotr_avx2(__m256i x, int c) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, c), _mm256_slli_epi32(x, 32 - c));
+}
+
+// Compresses `blocks` consecutive blocks of eight independent messages. Lane k of
+// every vector belongs to message k; `data[k]` points at that message's blocks.
+__attribute__((target("avx2")))
+static void compress_avx2_x8(uint32_t states[SHA256_MAX_LANES][8], const uint8_t* const* data, size_t blocks) {
+    __m256i s[8];
+    for (int j = 0; j < 8; j++) {
+        s[j] = _mm256_setr_epi32(states[0][j], states[1][j], states[2][j], states[3][j],
+            states[4][j], states[5][j], states[6][j], states[7][j]);
+    }
+
+    for (size_t blk = 0; blk < blocks; blk++) {
+        size_t off = blk * SHA256_BLOCK_SIZE;
+        __m256i w[64];
+        for (int t = 0; t < 16; t++) {
+            size_t o = off + 4 * t;
+            w[t] = _mm256_setr_epi32(load32_be(data[0] + o), load32_be(data[1] + o), load32_be(data[2] + o),
+                load32_be(data[3] + o), load32_be(data[4] + o), load32_be(data[5] + o),
+                load32_be(data[6] + o), load32_be(data[7] + o));
+        }
+        for (int t = 16; t < 64; t++) {
+            __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr_avx2(w[t - 15], 7), rotr_avx2(w[t - 15], 18)),
+                _mm256_srli_epi32(w[t - 15], 3));
+            __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr_avx2(w[t - 2], 17), rotr_avx2(w[t - 2], 19)),
+                _mm256_srli_epi32(w[t - 2], 10));
+            w[t] = _mm256_add_epi32(_mm256_add_epi32(w[t - 16], s0), _mm256_add_epi32(w[t - 7], s1));
+        }
+
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], h = s[7];
+        for (int t = 0; t < 64; t++) {
+            __m256i sig1 = _mm256_xor_si256(_mm256_xor_si256(rotr_avx2(e, 6), rotr_avx2(e, 11)), rotr_avx2(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sig1),
+                _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32((int)K[t])), w[t]));
+            __m256i sig0 = _mm256_xor_si256(_mm256_xor_si256(rotr_avx2(a, 2), rotr_avx2(a, 13)), rotr_avx2(a, 22));
+            __m256i maj = _mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_xor_si256(a, b)));
+            __m256i t2 = _mm256_add_epi32(sig0, maj);
+            h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+            d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+        }
+        s[0] = _mm256_add_epi32(s[0], a); s[1] = _mm256_add_epi32(s[1], b);
+        s[2] = _mm256_add_epi32(s[2], c); s[3] = _mm256_add_epi32(s[3], d);
+        s[4] = _mm256_add_epi32(s[4], e); s[5] = _mm256_add_epi32(s[5], f);
+        s[6] = _mm256_add_epi32(s[6], g); s[7] = _mm256_add_epi32(s[7], h);
+    }
+
+    for (int j = 0; j < 8; j++) {
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, s[j]);
+        for (int k = 0; k < SHA256_MAX_LANES; k++) states[k][j] = lanes[k];
+    }
+}
+
+// --- Dispatch ---
+
+typedef void (*compress_fn)(uint32_t state[8], const uint8_t* data, size_t blocks);
+
+static compress_fn compress = compress_scalar;
+static int use_avx2_x8 = 0;
+static pthread_once_t dispatch_once = PTHREAD_ONCE_INIT;
+
+static void select_compress(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1")) {
+        // One message through the SHA unit is faster than eight through AVX2
+        compress = compress_shani;
+        use_avx2_x8 = 0;
+    } else {
+        compress = compress_scalar;
+        use_avx2_x8 = __builtin_cpu_supports("avx2");
+    }
+}
+
+void sha256_init_dispatch(void) {
+    // Worker threads can get here at the same time; pthread_once runs the selection
+    // exactly once and makes its writes visible to every caller that returns
+    pthread_once(&dispatch_once, select_compress);
+}
+
+const char* sha256_impl_name(void) {
+    sha256_init_dispatch();
+    if (compress == compress_shani) return "sha-ni";
+    return use_avx2_x8 ? "scalar+avx2x8" : "scalar";
+}
+
+// --- Hashing ---
+
+void sha256_init(sha256_ctx* ctx) {
+    sha256_init_dispatch();
+    memcpy(ctx->state, IV, sizeof(IV));
+    ctx->count = 0;
+    ctx->buflen = 0;
+}
+
+void sha256_update(sha256_ctx* ctx, const void* data, size_t len) {
+    const uint8_t* in = (const uint8_t*)data;
+    ctx->count += len;
+    if (ctx->buflen > 0) {
+        size_t take = SHA256_BLOCK_SIZE - ctx->buflen;
+        if (take > len) take = len;
+        memcpy(ctx->buf + ctx->buflen, in, take);
+        ctx->buflen += take;
+        in += take;
+        len -= take;
+        if (ctx->buflen < SHA256_BLOCK_SIZE) return;
+        compress(ctx->state, ctx->buf, 1);
+        ctx->buflen = 0;
+    }
+    if (len >= SHA256_BLOCK_SIZE) {
+        size_t blocks = len / SHA256_BLOCK_SIZE;
+        compress(ctx->state, in, blocks);
+        in += blocks * SHA256_BLOCK_SIZE;
+        len -= blocks * SHA256_BLOCK_SIZE;
+    }
+    memcpy(ctx->buf, in, len);
+    ctx->buflen = len;
+}
+
+// Appends the padding after the `tail_len` bytes already in `out` and returns the block count
+static size_t pad_tail(uint8_t* out, size_t tail_len, uint64_t total_len) {
+    size_t blocks = (tail_len + 9 + SHA256_BLOCK_SIZE - 1) / SHA256_BLOCK_SIZE;
+    size_t size = blocks * SHA256_BLOCK_SIZE;
+    out[tail_len] = 0x80;
+    memset(out + tail_len + 1, 0, size - tail_len - 1 - 8);
+    uint64_t bits = total_len * 8;
+    for (int i = 0; i < 8; i++) out[size - 1 - i] = (uint8_t)(bits >> (8 * i));
+    return blocks;
+}
+
+void sha256_final(sha256_ctx* ctx, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    uint8_t last[2 * SHA256_BLOCK_SIZE];
+    memcpy(last, ctx->buf, ctx->buflen);
+    size_t blocks = pad_tail(last, ctx->buflen, ctx->count);
+    compress(ctx->state, last, blocks);
+    for (int i = 0; i < 8; i++) store32_be(digest + 4 * i, ctx->state[i]);
+}
+
+void sha256(const void* data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]) {
+    sha256_ctx ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, data, len);
+    sha256_final(&ctx, digest);
+}
+
+// Longest padded tail the multi-buffer path handles; longer messages fall back to one at a time
+#define MULTI_TAIL_MAX (4 * SHA256_BLOCK_SIZE)
+
+void sha256_finish_multi(const sha256_ctx* mid, const uint8_t* const* msgs, size_t len, int count,
+    uint8_t (*digests)[SHA256_DIGEST_SIZE]) {
+    sha256_init_dispatch();
+    size_t tail_len = mid->buflen + len;
+    if (!use_avx2_x8 || count < 2 || tail_len + 9 > MULTI_TAIL_MAX) {
+        for (int k = 0; k < count; k++) {
+            sha256_ctx ctx = *mid;
+            sha256_update(&ctx, msgs[k], len);
+            sha256_final(&ctx, digests[k]);
+        }
+        return;
+    }
+
+    // Every message has the same length, so every lane has the same number of blocks
+    size_t blocks = 0;
+    uint8_t tails[SHA256_MAX_LANES][MULTI_TAIL_MAX];
+    uint32_t states[SHA256_MAX_LANES][8];
+    const uint8_t* lanes[SHA256_MAX_LANES];
+    for (int k = 0; k < SHA256_MAX_LANES; k++) {
+        // Unused lanes repeat the last message; their results are discarded
+        const uint8_t* msg = msgs[k < count ? k : count - 1];
+        uint8_t* t = tails[k];
+        memcpy(t, mid->buf, mid->buflen);
+        memcpy(t + mid->buflen, msg, len);
+        blocks = pad_tail(t, tail_len, mid->count + len);
+        memcpy(states[k], mid->state, sizeof(states[k]));
+        lanes[k] = t;
+    }
+
+    compress_avx2_x8(states, lanes, blocks);
+    for (int k = 0; k < count; k++) {
+        for (int i = 0; i < 8; i++) store32_be(digests[k] + 4 * i, states[k][i]);
+    }
+}
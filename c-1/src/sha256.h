@@ -0,0 +1,56 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_DIGEST_SIZE 32
+// Most messages a multi-buffer call hashes at once
+#define SHA256_MAX_LANES 8
+
+// Incremental SHA-256 state. Copying a context after absorbing a constant prefix
+// gives a midstate that later messages can continue from.
+typedef struct {
+    uint32_t state[8];
+    uint64_t count; // Bytes absorbed so far
+    uint8_t buf[SHA256_BLOCK_SIZE];
+    size_t buflen;
+} sha256_ctx;
+
+/**
+ * @brief Picks the fastest compression function for this CPU (SHA-NI, AVX2 multi-buffer
+ * or scalar). Thread-safe and idempotent; called lazily by the other functions.
+ */
+void sha256_init_dispatch(void);
+
+/**
+ * @brief Describes the active implementation, e.g. "sha-ni" or "scalar+avx2x8".
+ */
+const char* sha256_impl_name(void);
+
+void sha256_init(sha256_ctx* ctx);
+void sha256_update(sha256_ctx* ctx, const void* data, size_t len);
+void sha256_final(sha256_ctx* ctx, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/**
+ * @brief One-shot SHA-256.
+ */
+void sha256(const void* data, size_t len, uint8_t digest[SHA256_DIGEST_SIZE]);
+
+/**
+ * @brief Finishes `count` messages that all continue from the same midstate.
+ *
+ * Each digest equals copying `mid`, absorbing `msgs[k]` (`len` bytes) and finalizing.
+ * When the CPU has AVX2 and no SHA extensions, up to eight messages are hashed in
+ * parallel, one per 32-bit vector lane.
+ *
+ * @param mid The shared midstate (not modified).
+ * @param msgs The message tails, all `len` bytes long.
+ * @param count Number of messages (1..SHA256_MAX_LANES).
+ * @param digests Receives `count` digests.
+ */
+void sha256_finish_multi(const sha256_ctx* mid, const uint8_t* const* msgs, size_t len, int count,
+    uint8_t (*digests)[SHA256_DIGEST_SIZE]);
+
+#endif // SHA256_H
@@ -0,0 +1,170 @@
+#define _GNU_SOURCE // For sched_getaffinity
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "topology.h"
+
+// Reads the first line of a sysfs file; returns 0 if it does not exist
+static int read_line(const char* path, char* buffer, size_t len) {
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+    int ok = fgets(buffer, len, file) != NULL;
+    fclose(file);
+    if (ok) buffer[strcspn(buffer, "\n")] = '\0';
+    return ok;
+}
+
+static int read_int(const char* path, int fallback) {
+    char line[64];
+    return read_line(path, line, sizeof(line)) ? atoi(line) : fallback;
+}
+
+// Finds `key` among the first `count` strings of `keys`, adding it if it is new
+static int intern(char (*keys)[64], int* count, const char* key) {
+    for (int i = 0; i < *count; i++) {
+        if (strcmp(keys[i], key) == 0) return i;
+    }
+    snprintf(keys[*count], 64, "%s", key);
+    return (*count)++;
+}
+
+// The sysfs path of the L3 cache of `cpu`, if it has one
+static int find_l3(int cpu, char* path, size_t len) {
+    for (int index = 0; index < 8; index++) {
+        snprintf(path, len, "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, index);
+        int level = read_int(path, -1);
+        if (level < 0) return 0;
+        if (level == 3) {
+            snprintf(path, len, "/sys/devices/system/cpu/cpu%d/cache/index%d", cpu, index);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Parses a cache size such as "32768K"
+static size_t parse_size(const char* text) {
+    char* end;
+    size_t size = strtoull(text, &end, 10);
+    if (*end == 'K') size <<= 10;
+    else if (*end == 'M') size <<= 20;
+    else if (*end == 'G') size <<= 30;
+    return size;
+}
+
+int topology_read(topology_t* topology) {
+    memset(topology, 0, sizeof(*topology));
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_ZERO(&allowed);
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) CPU_SET(cpu, &allowed);
+    }
+
+    // Cores are told apart by package and core id, caches by the CPUs that share them
+    static char core_keys[TOPOLOGY_MAX_CPUS][64];
+    static char l3_keys[TOPOLOGY_MAX_CPUS][64];
+    static char package_keys[TOPOLOGY_MAX_CPUS][64];
+    int sysfs_ok = 1;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE && topology->cpu_count < TOPOLOGY_MAX_CPUS; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        char path[160], key[64], line[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+        int package = read_int(path, -1);
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/core_id", cpu);
+        int core_id = read_int(path, -1);
+        if (package < 0 || core_id < 0) {
+            // No topology for this CPU (or none at all): treat it as a core of its own
+            sysfs_ok = 0;
+            package = 0;
+            core_id = cpu;
+        }
+
+        topology_cpu_t* entry = &topology->cpus[topology->cpu_count++];
+        entry->cpu = cpu;
+        snprintf(key, sizeof(key), "%d", package);
+        intern(package_keys, &topology->package_count, key);
+        snprintf(key, sizeof(key), "%d:%d", package, core_id);
+        int cores_before = topology->core_count;
+        entry->core = intern(core_keys, &topology->core_count, key);
+
+        // The n-th CPU seen on a core is its n-th hardware thread
+        entry->thread = 0;
+        if (entry->core < cores_before) {
+            for (int i = 0; i < topology->cpu_count - 1; i++) {
+                if (topology->cpus[i].core == entry->core) entry->thread++;
+            }
+        }
+
+        if (find_l3(cpu, path, sizeof(path))) {
+            char file[192];
+            snprintf(file, sizeof(file), "%s/shared_cpu_list", path);
+            if (!read_line(file, key, sizeof(key))) snprintf(key, sizeof(key), "package %d", package);
+            if (topology->l3_size == 0) {
+                snprintf(file, sizeof(file), "%s/size", path);
+                if (read_line(file, line, sizeof(line))) topology->l3_size = parse_size(line);
+            }
+        } else {
+            snprintf(key, sizeof(key), "package %d", package);
+        }
+        entry->l3 = intern(l3_keys, &topology->l3_count, key);
+    }
+    return sysfs_ok && topology->cpu_count > 0;
+}
+
+int topology_placement(const topology_t* topology, bool smt, int* cpus, int max_cpus) {
+    int count = 0;
+    int max_thread = 0;
+    for (int i = 0; i < topology->cpu_count; i++) {
+        if (topology->cpus[i].thread > max_thread) max_thread = topology->cpus[i].thread;
+    }
+    int* taken = calloc(topology->core_count > 0 ? topology->core_count : 1, sizeof(int));
+    if (!taken) return 0;
+
+    // One pass per hardware thread of a core: each pass deals the cores out between the
+    // L3 caches in turn, so the n-th worker of every cache is placed before any (n+1)-th
+    for (int thread = 0; thread <= (smt ? max_thread : 0); thread++) {
+        memset(taken, 0, sizeof(int) * topology->core_count);
+        bool placed = true;
+        while (placed && count < max_cpus) {
+            placed = false;
+            for (int l3 = 0; l3 < topology->l3_count && count < max_cpus; l3++) {
+                for (int i = 0; i < topology->cpu_count; i++) {
+                    const topology_cpu_t* cpu = &topology->cpus[i];
+                    if (cpu->l3 != l3 || cpu->thread != thread || taken[cpu->core]) continue;
+                    taken[cpu->core] = 1;
+                    cpus[count++] = cpu->cpu;
+                    placed = true;
+                    break;
+                }
+            }
+        }
+    }
+    free(taken);
+    return count;
+}
+
+// MemAvailable from /proc/meminfo in bytes, 0 if unknown
+static size_t available_memory(void) {
+    FILE* file = fopen("/proc/meminfo", "r");
+    if (!file) return 0;
+    char line[128];
+    size_t kib = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "MemAvailable: %zu kB", &kib) == 1) break;
+    }
+    fclose(file);
+    return kib * 1024;
+}
+
+int topology_auto_threads(const topology_t* topology, bool smt, size_t worker_memory) {
+    int threads = smt ? topology->cpu_count : topology->core_count;
+    // Leave a tenth of the free memory to the rest of the system
+    size_t memory = available_memory();
+    if (memory > 0 && worker_memory > 0) {
+        size_t fit = memory / 10 * 9 / worker_memory;
+        if ((size_t)threads > fit) threads = (int)fit;
+    }
+    return threads > 0 ? threads : 1;
+}
@@ -0,0 +1,53 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// CPU and cache topology of the machine, read from Linux sysfs and limited to the CPUs
+// the process is allowed to run on.
+
+#define TOPOLOGY_MAX_CPUS 1024
+
+// One logical CPU
+typedef struct {
+    int cpu;     // Linux CPU number
+    int core;    // Dense index of its physical core
+    int l3;      // Dense index of the L3 cache it shares (its package if there is no L3)
+    int thread;  // 0 for the first hardware thread of its core, 1 for the next SMT sibling...
+} topology_cpu_t;
+
+typedef struct {
+    topology_cpu_t cpus[TOPOLOGY_MAX_CPUS];
+    int cpu_count;
+    int core_count;
+    int l3_count;
+    int package_count;
+    size_t l3_size; // Bytes of one L3 cache, 0 if unknown
+} topology_t;
+
+/**
+ * @brief Reads the topology of the CPUs in the affinity mask of the calling thread.
+ *
+ * @return 1 on success, 0 if sysfs cannot be read (the topology is then one core per CPU).
+ */
+int topology_read(topology_t* topology);
+
+/**
+ * @brief Lists the CPUs to pin workers to, in order.
+ *
+ * Physical cores come first, taking turns between L3 caches so that each cache is shared
+ * by as few workers as possible. With `smt`, the SMT siblings follow in the same order;
+ * without it they are left out.
+ *
+ * @return The number of CPUs written to `cpus`.
+ */
+int topology_placement(const topology_t* topology, bool smt, int* cpus, int max_cpus);
+
+/**
+ * @brief Chooses a worker count: one per physical core (per logical CPU with `smt`), but
+ * no more than the available memory can give `worker_memory` bytes each.
+ */
+int topology_auto_threads(const topology_t* topology, bool smt, size_t worker_memory);
+
+#endif // TOPOLOGY_H
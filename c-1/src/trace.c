@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+
+int trace_ring_init(trace_ring_t* ring, size_t capacity, uint16_t thread) {
+    memset(ring, 0, sizeof(*ring));
+    ring->events = calloc(capacity, sizeof(trace_event_t));
+    if (!ring->events) return 0;
+    ring->mask = capacity - 1;
+    ring->thread = thread;
+    return 1;
+}
+
+static int write_header(trace_writer_t* writer) {
+    trace_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.event_size = sizeof(trace_event_t);
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    header.monotonic_ns = trace_now();
+    header.realtime_ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    if (fwrite(&header, sizeof(header), 1, writer->file) != 1) return 0;
+    writer->written = sizeof(header);
+    return 1;
+}
+
+int trace_writer_open(trace_writer_t* writer, const char* path, size_t max_bytes, trace_ring_t* rings, int ring_count) {
+    memset(writer, 0, sizeof(*writer));
+    writer->rings = rings;
+    writer->ring_count = ring_count;
+    writer->path = path;
+    writer->max_bytes = max_bytes;
+    writer->file = fopen(path, "wb");
+    if (!writer->file) return 0;
+    return write_header(writer);
+}
+
+// Shifts <path> to <path>.1, <path>.1 to <path>.2 and so on, and starts a new file
+static int rotate(trace_writer_t* writer) {
+    fclose(writer->file);
+    char from[4096], to[4096];
+    for (int i = TRACE_KEEP_FILES - 1; i >= 0; i--) {
+        if (i == 0) {
+            snprintf(from, sizeof(from), "%s", writer->path);
+        } else {
+            snprintf(from, sizeof(from), "%s.%d", writer->path, i);
+        }
+        snprintf(to, sizeof(to), "%s.%d", writer->path, i + 1);
+        rename(from, to); // Missing files are fine
+    }
+    writer->file = fopen(writer->path, "wb");
+    return writer->file && write_header(writer);
+}
+
+// Writes `count` events, rotating the file first if they do not fit
+static int write_events(trace_writer_t* writer, const trace_event_t* events, size_t count) {
+    if (count == 0) return 1;
+    if (writer->written + count * sizeof(trace_event_t) > writer->max_bytes
+        && writer->written > sizeof(trace_header_t) && !rotate(writer)) {
+        return 0;
+    }
+    if (fwrite(events, sizeof(trace_event_t), count, writer->file) != count) return 0;
+    writer->written += count * sizeof(trace_event_t);
+    return 1;
+}
+
+long trace_writer_drain(trace_writer_t* writer) {
+    if (!writer->file) return -1;
+    long total = 0;
+    for (int r = 0; r < writer->ring_count; r++) {
+        trace_ring_t* ring = &writer->rings[r];
+        uint64_t dropped = atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+        if (dropped != ring->dropped_reported) {
+            trace_event_t event = {
+                .time_ns = trace_now(), .type = TRACE_DROPPED, .thread = ring->thread,
+                .arg = dropped - ring->dropped_reported
+            };
+            if (!write_events(writer, &event, 1)) return -1;
+            ring->dropped_reported = dropped;
+            total++;
+        }
+
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        while (tail != head) {
+            // Up to the end of the buffer, then again from its start
+            size_t start = tail & ring->mask;
+            size_t count = head - tail;
+            if (count > ring->mask + 1 - start) count = ring->mask + 1 - start;
+            if (!write_events(writer, &ring->events[start], count)) return -1;
+            tail += count;
+            total += count;
+            // Hand the slots back before the next batch, so a busy producer is not held up
+            atomic_store_explicit(&ring->tail, tail, memory_order_release);
+        }
+    }
+    fflush(writer->file);
+    return total;
+}
+
+void trace_writer_close(trace_writer_t* writer) {
+    if (!writer->file) return;
+    trace_writer_drain(writer);
+    fclose(writer->file);
+    writer->file = NULL;
+}
+
+const char* trace_event_name(int type) {
+    static const char* const names[TRACE_EVENT_TYPES] = {
+        [TRACE_ATTEMPT_START] = "attempt_start",
+        [TRACE_ATTEMPT_END] = "attempt_end",
+        [TRACE_JOB_SWITCH] = "job_switch",
+        [TRACE_BEST_HIT] = "best_hit",
+        [TRACE_CANDIDATE] = "candidate",
+        [TRACE_SUBMIT] = "submit",
+        [TRACE_WAIT] = "wait",
+        [TRACE_PARK] = "park",
+        [TRACE_DROPPED] = "dropped",
+    };
+    return type > 0 && type < TRACE_EVENT_TYPES ? names[type] : NULL;
+}
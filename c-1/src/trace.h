@@ -0,0 +1,144 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+// Event tracing. Every worker (and the submitter) records compact binary events into its
+// own single-producer ring; a writer thread drains the rings into a trace file that is
+// rotated by size. Recording only writes memory: when a ring is full the event is dropped
+// and counted, so the hashing loop never waits for the writer or the disk.
+// trace_decode turns trace files into timelines and per-thread stats.
+
+#define TRACE_MAGIC "PHPCTRC1"
+#define TRACE_VERSION 1
+// Events each ring holds between two drains
+#define TRACE_RING_EVENTS 8192
+// How often the writer drains the rings
+#define TRACE_DRAIN_MS 100
+// Rotated files kept next to the current one: <path>.1 (newest) to <path>.<TRACE_KEEP_FILES>
+#define TRACE_KEEP_FILES 4
+
+typedef enum {
+    TRACE_ATTEMPT_START = 1, // arg: first nonce, arg32: elapsed, detail: lanes
+    TRACE_ATTEMPT_END,       // arg: best hit of the batch, arg32: hashes made, detail: trace_outcome_t
+    TRACE_JOB_SWITCH,        // arg: height, arg32: job epoch
+    TRACE_BEST_HIT,          // arg: hit, arg32: elapsed
+    TRACE_CANDIDATE,         // arg: hit, arg32: elapsed; a solution handed to the submitter
+    TRACE_SUBMIT,            // arg: height, arg32: node index, detail: trace_outcome_t
+    TRACE_WAIT,              // arg32: seconds until a hit can beat the target
+    TRACE_PARK,              // detail: 1 when the worker parks, 0 when it resumes
+    TRACE_DROPPED,           // arg: events the ring had no room for; written by the writer
+    TRACE_EVENT_TYPES
+} trace_event_type_t;
+
+typedef enum {
+    TRACE_OK,        // Hashed, or accepted by the node
+    TRACE_CANCELLED, // Abandoned for a newer job (attempts only)
+    TRACE_FAILED,    // An error, or no answer from the node
+    TRACE_REJECTED,  // Refused by the node (submissions only)
+    TRACE_OUTCOMES
+} trace_outcome_t;
+
+// One event, 24 bytes on disk in host byte order
+typedef struct {
+    uint64_t time_ns;   // CLOCK_MONOTONIC
+    uint8_t type;
+    uint8_t detail;
+    uint16_t thread;    // Worker id, 0 for the submitter
+    uint32_t arg32;
+    uint64_t arg;
+} trace_event_t;
+
+// Start of every trace file, so each rotated file decodes on its own
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t event_size;
+    uint64_t monotonic_ns; // One moment on the event clock...
+    uint64_t realtime_ns;  // ...and on the wall clock
+} trace_header_t;
+
+typedef struct {
+    trace_event_t* events;
+    size_t mask;                      // Capacity - 1; the capacity is a power of two
+    uint16_t thread;
+    _Alignas(64) atomic_size_t head;  // Next slot to write, only moved by the producer
+    atomic_uint_fast64_t dropped;     // Only grows; the writer reports the difference
+    _Alignas(64) atomic_size_t tail;  // Next slot to read, only moved by the writer
+    uint64_t dropped_reported;
+} trace_ring_t;
+
+static inline uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Records an event. Only the ring's own thread may call it; does nothing for a NULL ring.
+ */
+static inline void trace_record(trace_ring_t* ring, trace_event_type_t type, uint8_t detail, uint32_t arg32, uint64_t arg) {
+    if (!ring) return;
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) > ring->mask) {
+        atomic_store_explicit(&ring->dropped, atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1,
+            memory_order_relaxed);
+        return;
+    }
+    trace_event_t* event = &ring->events[head & ring->mask];
+    event->time_ns = trace_now();
+    event->type = type;
+    event->detail = detail;
+    event->thread = ring->thread;
+    event->arg32 = arg32;
+    event->arg = arg;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief Allocates a ring of `capacity` events (a power of two) for thread `thread`.
+ *
+ * @return 1 on success, 0 on allocation failure.
+ */
+int trace_ring_init(trace_ring_t* ring, size_t capacity, uint16_t thread);
+
+typedef struct {
+    trace_ring_t* rings;
+    int ring_count;
+    const char* path;
+    size_t max_bytes;   // Size at which the file is rotated
+    FILE* file;
+    size_t written;     // Bytes in the current file
+} trace_writer_t;
+
+/**
+ * @brief Creates (or truncates) the trace file at `path` for the events of `rings`.
+ *
+ * @return 1 on success, 0 if the file cannot be written.
+ */
+int trace_writer_open(trace_writer_t* writer, const char* path, size_t max_bytes, trace_ring_t* rings, int ring_count);
+
+/**
+ * @brief Moves every event recorded so far from the rings to the file, rotating it when it is full.
+ * Must only be called from one thread.
+ *
+ * @return The number of events written, or -1 on a write error.
+ */
+long trace_writer_drain(trace_writer_t* writer);
+
+/**
+ * @brief Drains the rings one last time and closes the file.
+ */
+void trace_writer_close(trace_writer_t* writer);
+
+/**
+ * @brief Names an event type, e.g. "attempt_end", or returns NULL for an unknown one.
+ */
+const char* trace_event_name(int type);
+
+#endif // TRACE_H
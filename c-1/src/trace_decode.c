@@ -0,0 +1,321 @@
+// trace_decode: reads the event trace written by c_miner --trace (including its rotated
+// files) and prints a timeline of the events, or per-thread stats with --stats.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "trace.h"
+
+typedef struct {
+    trace_event_t event;
+    size_t order; // Position in the input, so events at the same time keep their order
+} decoded_event_t;
+
+typedef struct {
+    decoded_event_t* events;
+    size_t count;
+    size_t capacity;
+    uint64_t start_monotonic_ns; // The earliest file header
+    uint64_t start_realtime_ns;
+} trace_t;
+
+// What one thread did over the trace
+typedef struct {
+    bool seen;
+    uint64_t attempts, hashes, cancelled, failed;
+    uint64_t* durations; // Of the attempts that completed, in ns
+    size_t duration_count, duration_capacity;
+    uint64_t job_switches, candidates, best_hit, dropped;
+    uint64_t waited_ns, parked_ns;
+    uint64_t submits[TRACE_OUTCOMES]; // By trace_outcome_t
+    // The attempt in progress, and a wait or park the thread is in
+    uint64_t attempt_start_ns;
+    int idle_type;
+    uint64_t idle_since_ns;
+} thread_summary_t;
+
+static void print_usage(const char* prog_name) {
+    fprintf(stderr, "Usage: %s [--stats] [--thread <id>] <trace file>...\n", prog_name);
+    fprintf(stderr, "Files may be given in any order; pass the rotated ones (<file>.1, <file>.2...) too for the whole trace.\n");
+    fprintf(stderr, "  --stats        Per-thread stats instead of the timeline\n");
+    fprintf(stderr, "  --thread <id>  Only the events of this thread (0 is the submitter)\n");
+}
+
+// Appends the events of one file. Returns 0 if it is not a trace.
+static int read_trace(const char* path, trace_t* trace) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        perror(path);
+        return 0;
+    }
+    trace_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != TRACE_VERSION || header.event_size != sizeof(trace_event_t)) {
+        fprintf(stderr, "%s is not a version %d trace.\n", path, TRACE_VERSION);
+        fclose(file);
+        return 0;
+    }
+    if (trace->start_monotonic_ns == 0 || header.monotonic_ns < trace->start_monotonic_ns) {
+        trace->start_monotonic_ns = header.monotonic_ns;
+        trace->start_realtime_ns = header.realtime_ns;
+    }
+
+    trace_event_t event;
+    // A partial event at the end is one the miner was still writing
+    while (fread(&event, sizeof(event), 1, file) == 1) {
+        if (trace->count == trace->capacity) {
+            size_t capacity = trace->capacity ? trace->capacity * 2 : 65536;
+            decoded_event_t* events = realloc(trace->events, capacity * sizeof(decoded_event_t));
+            if (!events) {
+                fprintf(stderr, "Out of memory reading %s.\n", path);
+                fclose(file);
+                return 0;
+            }
+            trace->events = events;
+            trace->capacity = capacity;
+        }
+        trace->events[trace->count].event = event;
+        trace->events[trace->count].order = trace->count;
+        trace->count++;
+    }
+    fclose(file);
+    return 1;
+}
+
+static int compare_events(const void* a, const void* b) {
+    const decoded_event_t* x = a;
+    const decoded_event_t* y = b;
+    if (x->event.time_ns != y->event.time_ns) return x->event.time_ns < y->event.time_ns ? -1 : 1;
+    return x->order < y->order ? -1 : x->order > y->order;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static const char* outcome_name(int type, int outcome) {
+    switch (outcome) {
+        case TRACE_OK: return type == TRACE_SUBMIT ? "accepted" : "done";
+        case TRACE_CANCELLED: return "cancelled";
+        case TRACE_FAILED: return "failed";
+        case TRACE_REJECTED: return "rejected";
+        default: return "unknown";
+    }
+}
+
+static void print_event(const trace_event_t* event, uint64_t start_ns, const thread_summary_t* summary) {
+    double at = event->time_ns >= start_ns ? (event->time_ns - start_ns) / 1e9 : -((start_ns - event->time_ns) / 1e9);
+    char who[16];
+    if (event->thread == 0) {
+        snprintf(who, sizeof(who), "submitter");
+    } else {
+        snprintf(who, sizeof(who), "worker %u", event->thread);
+    }
+    const char* name = trace_event_name(event->type);
+    char unknown[16];
+    if (!name) {
+        snprintf(unknown, sizeof(unknown), "unknown(%u)", event->type);
+        name = unknown;
+    }
+    printf("%+14.6f  %-10s  %-13s  ", at, who, name);
+    switch (event->type) {
+        case TRACE_ATTEMPT_START:
+            printf("nonce %016llx, %u lane(s), elapsed %u s", (unsigned long long)event->arg, event->detail, event->arg32);
+            break;
+        case TRACE_ATTEMPT_END:
+            if (summary->attempt_start_ns > 0) {
+                printf("%.3f ms, ", (event->time_ns - summary->attempt_start_ns) / 1e6);
+            }
+            if (event->detail == TRACE_OK) {
+                printf("%u hash(es), best hit %llu", event->arg32, (unsigned long long)event->arg);
+            } else {
+                printf("%s", outcome_name(event->type, event->detail));
+            }
+            break;
+        case TRACE_JOB_SWITCH:
+            printf("height %llu (job %u)", (unsigned long long)event->arg, event->arg32);
+            break;
+        case TRACE_BEST_HIT:
+        case TRACE_CANDIDATE:
+            printf("hit %llu at elapsed %u s", (unsigned long long)event->arg, event->arg32);
+            break;
+        case TRACE_SUBMIT:
+            printf("height %llu to node %u: %s", (unsigned long long)event->arg, event->arg32, outcome_name(event->type, event->detail));
+            break;
+        case TRACE_WAIT:
+            printf("%u s until a hit can beat the target", event->arg32);
+            break;
+        case TRACE_PARK:
+            printf("%s", event->detail ? "parked" : "resumed");
+            break;
+        case TRACE_DROPPED:
+            printf("%llu event(s) lost, the ring was full", (unsigned long long)event->arg);
+            break;
+    }
+    printf("\n");
+}
+
+// Updates the summary of the event's thread. Runs after the event is printed, which
+// reads the start of the attempt it ends from the summary.
+static void summarize(thread_summary_t* summary, const trace_event_t* event) {
+    summary->seen = true;
+    // Waiting and parking last until the thread does anything else (dropped events are
+    // reported by the writer, not the thread)
+    if (summary->idle_type != 0 && event->type != TRACE_DROPPED) {
+        uint64_t idle = event->time_ns - summary->idle_since_ns;
+        if (summary->idle_type == TRACE_WAIT) {
+            summary->waited_ns += idle;
+        } else {
+            summary->parked_ns += idle;
+        }
+        summary->idle_type = 0;
+    }
+
+    switch (event->type) {
+        case TRACE_ATTEMPT_START:
+            summary->attempt_start_ns = event->time_ns;
+            break;
+        case TRACE_ATTEMPT_END:
+            summary->attempts++;
+            if (event->detail == TRACE_CANCELLED) {
+                summary->cancelled++;
+            } else if (event->detail == TRACE_FAILED) {
+                summary->failed++;
+            } else if (event->detail == TRACE_OK) {
+                summary->hashes += event->arg32;
+                if (summary->attempt_start_ns > 0) {
+                    if (summary->duration_count == summary->duration_capacity) {
+                        size_t capacity = summary->duration_capacity ? summary->duration_capacity * 2 : 1024;
+                        uint64_t* durations = realloc(summary->durations, capacity * sizeof(uint64_t));
+                        if (!durations) break;
+                        summary->durations = durations;
+                        summary->duration_capacity = capacity;
+                    }
+                    summary->durations[summary->duration_count++] = event->time_ns - summary->attempt_start_ns;
+                }
+            }
+            break;
+        case TRACE_JOB_SWITCH:
+            summary->job_switches++;
+            break;
+        case TRACE_BEST_HIT:
+            if (event->arg > summary->best_hit) summary->best_hit = event->arg;
+            break;
+        case TRACE_CANDIDATE:
+            summary->candidates++;
+            break;
+        case TRACE_SUBMIT:
+            if (event->detail < TRACE_OUTCOMES) summary->submits[event->detail]++;
+            break;
+        case TRACE_WAIT:
+        case TRACE_PARK:
+            if (event->type == TRACE_WAIT || event->detail) {
+                summary->idle_type = event->type;
+                summary->idle_since_ns = event->time_ns;
+            }
+            break;
+        case TRACE_DROPPED:
+            summary->dropped += event->arg;
+            break;
+    }
+}
+
+static double percentile_ms(const thread_summary_t* summary, int percent) {
+    if (summary->duration_count == 0) return 0;
+    size_t index = summary->duration_count * percent / 100;
+    if (index >= summary->duration_count) index = summary->duration_count - 1;
+    return summary->durations[index] / 1e6;
+}
+
+static void print_stats(thread_summary_t* summaries, int count, double span_s) {
+    printf("%-9s %9s %10s %8s %9s %8s %8s %8s %8s %9s %9s %20s %5s %8s\n", "Thread", "Attempts", "Hashes", "H/s",
+        "Cancelled", "p50 ms", "p99 ms", "Max ms", "Switches", "Waited s", "Parked s", "Best Hit", "Cand.", "Dropped");
+    for (int i = 1; i < count; i++) {
+        thread_summary_t* summary = &summaries[i];
+        if (!summary->seen) continue;
+        qsort(summary->durations, summary->duration_count, sizeof(uint64_t), compare_u64);
+        printf("%-9d %9llu %10llu %8.2f %9llu %8.3f %8.3f %8.3f %8llu %9.1f %9.1f %20llu %5llu %8llu\n", i,
+            (unsigned long long)summary->attempts, (unsigned long long)summary->hashes,
+            span_s > 0 ? summary->hashes / span_s : 0, (unsigned long long)summary->cancelled,
+            percentile_ms(summary, 50), percentile_ms(summary, 99), percentile_ms(summary, 100),
+            (unsigned long long)summary->job_switches, summary->waited_ns / 1e9, summary->parked_ns / 1e9,
+            (unsigned long long)summary->best_hit, (unsigned long long)summary->candidates,
+            (unsigned long long)summary->dropped);
+        if (summary->failed > 0) {
+            printf("          %llu attempt(s) failed\n", (unsigned long long)summary->failed);
+        }
+    }
+    const thread_summary_t* submitter = &summaries[0];
+    if (submitter->seen) {
+        printf("Submitter: %llu accepted, %llu rejected, %llu failed node responses",
+            (unsigned long long)submitter->submits[TRACE_OK], (unsigned long long)submitter->submits[TRACE_REJECTED],
+            (unsigned long long)submitter->submits[TRACE_FAILED]);
+        if (submitter->dropped > 0) printf(", %llu event(s) dropped", (unsigned long long)submitter->dropped);
+        printf("\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    bool stats = false;
+    long only_thread = -1;
+    trace_t trace = { 0 };
+    int files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (strcmp(argv[i], "--thread") == 0 && i + 1 < argc) {
+            only_thread = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--help") == 0 || argv[i][0] == '-') {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        } else {
+            if (!read_trace(argv[i], &trace)) return EXIT_FAILURE;
+            files++;
+        }
+    }
+    if (files == 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    qsort(trace.events, trace.count, sizeof(decoded_event_t), compare_events);
+    int thread_count = 1;
+    for (size_t i = 0; i < trace.count; i++) {
+        if (trace.events[i].event.thread >= thread_count) thread_count = trace.events[i].event.thread + 1;
+    }
+    thread_summary_t* summaries = calloc(thread_count, sizeof(thread_summary_t));
+    if (!summaries) {
+        fprintf(stderr, "Out of memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    time_t start_s = trace.start_realtime_ns / 1000000000ULL;
+    char start_str[32];
+    strftime(start_str, sizeof(start_str), "%Y-%m-%d %H:%M:%S", localtime(&start_s));
+    printf("Trace from %s.%03llu, %zu events in %d file(s)\n", start_str,
+        (unsigned long long)(trace.start_realtime_ns / 1000000ULL % 1000), trace.count, files);
+
+    uint64_t first_ns = 0, last_ns = 0;
+    for (size_t i = 0; i < trace.count; i++) {
+        const trace_event_t* event = &trace.events[i].event;
+        if (only_thread >= 0 && event->thread != only_thread) continue;
+        if (!trace_event_name(event->type)) {
+            // From a newer miner: show it, but keep it out of the summaries
+            if (!stats) print_event(event, trace.start_monotonic_ns, &summaries[event->thread]);
+            continue;
+        }
+        thread_summary_t* summary = &summaries[event->thread];
+        if (first_ns == 0) first_ns = event->time_ns;
+        last_ns = event->time_ns;
+        if (!stats) print_event(event, trace.start_monotonic_ns, summary);
+        summarize(summary, event);
+    }
+
+    if (stats) print_stats(summaries, thread_count, (last_ns - first_ns) / 1e9);
+    for (int i = 0; i < thread_count; i++) free(summaries[i].durations);
+    free(summaries);
+    free(trace.events);
+    return EXIT_SUCCESS;
+}